@@ -0,0 +1,160 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Stand-in for libFuzzer where the compiler has none (GCC): runs the files and directories given on the
+// command line, then -runs=N mutations of them (default 100000) through LLVMFuzzerTestOneInput()
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define FUZZ_MAX_INPUT 64
+#define FUZZ_MAX_SEEDS 256
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+typedef struct
+{
+    uint8_t data[FUZZ_MAX_INPUT];
+    size_t size;
+} fuzz_input_t;
+
+static fuzz_input_t seeds[FUZZ_MAX_SEEDS];
+static size_t seed_count;
+
+static void fuzz_load_file(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL || seed_count == FUZZ_MAX_SEEDS)
+    {
+        if (file != NULL)
+            fclose(file);
+        return;
+    }
+
+    fuzz_input_t *seed = &seeds[seed_count++];
+    seed->size = fread(seed->data, 1, sizeof(seed->data), file);
+    fclose(file);
+    LLVMFuzzerTestOneInput(seed->data, seed->size);
+}
+
+static void fuzz_load(const char *path)
+{
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return;
+    if (!S_ISDIR(info.st_mode))
+    {
+        fuzz_load_file(path);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+    while (dir != NULL && (entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        char file[4096];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        fuzz_load_file(file);
+    }
+    if (dir != NULL)
+        closedir(dir);
+}
+
+// A few byte level mutations of a seed: flip, replace with a digit or separator, insert, delete, truncate
+static void fuzz_mutate(fuzz_input_t *input)
+{
+    static const char interesting[] = "0123456789-:T Z,";
+    int count = 1 + rand() % 4;
+
+    for (int i = 0; i < count; i++)
+    {
+        size_t at = input->size > 0 ? (size_t)rand() % input->size : 0;
+        switch (rand() % 5)
+        {
+        case 0:
+            if (input->size > 0)
+                input->data[at] ^= 1 << (rand() % 8);
+            break;
+        case 1:
+            if (input->size > 0)
+                input->data[at] = interesting[rand() % (sizeof(interesting) - 1)];
+            break;
+        case 2:
+            if (input->size < FUZZ_MAX_INPUT)
+            {
+                memmove(input->data + at + 1, input->data + at, input->size - at);
+                input->data[at] = interesting[rand() % (sizeof(interesting) - 1)];
+                input->size++;
+            }
+            break;
+        case 3:
+            if (input->size > 0)
+            {
+                memmove(input->data + at, input->data + at + 1, input->size - at - 1);
+                input->size--;
+            }
+            break;
+        default:
+            input->size = at;
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long runs = 100000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-runs=", 6) == 0)
+            runs = strtoul(argv[i] + 6, NULL, 10);
+        else
+            fuzz_load(argv[i]);
+    }
+
+    if (seed_count == 0)
+        seeds[seed_count++].size = 0;
+
+    srand(1);
+    for (unsigned long run = 0; run < runs; run++)
+    {
+        fuzz_input_t input = seeds[rand() % seed_count];
+        fuzz_mutate(&input);
+        LLVMFuzzerTestOneInput(input.data, input.size);
+    }
+
+    printf("%zu seeds, %lu mutations\n", seed_count, runs);
+    return 0;
+}
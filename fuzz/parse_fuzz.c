@@ -0,0 +1,69 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// libFuzzer harness of ds3231_parse_date_time(): whatever the string, an accepted one gives registers in range
+// which survive the conversion to the epoch and back
+
+#include "ds3231_parse.h"
+#include "ds3231_epoch.h"
+
+#include <assert.h>
+
+static bool bcd_in_range(uint8_t value, uint8_t min, uint8_t max)
+{
+    return (value & 0x0F) <= 9 && bcd2dec(value) >= min && bcd2dec(value) <= max;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    uint8_t regs[7];
+    uint8_t back[7];
+
+    if (ds3231_parse_date_time((const char *)data, size, regs) != ESP_OK)
+        return 0;
+
+    static const uint8_t month_days[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    uint8_t month = regs[5] & DS3231_MONTH_MASK;
+
+    assert(bcd_in_range(regs[0], 0, 59));
+    assert(bcd_in_range(regs[1], 0, 59));
+    assert(bcd_in_range(regs[2], 0, 23)); // 24 hour mode, no flags
+    assert(regs[3] >= 1 && regs[3] <= 7);
+    assert(bcd_in_range(month, 1, 12) && (regs[5] & ~(DS3231_MONTH_MASK | DS3231_CENTURY_FLAG)) == 0);
+    assert(bcd_in_range(regs[4], 1, month_days[bcd2dec(month) - 1]));
+    assert(bcd_in_range(regs[6], 0, 99));
+
+    int64_t epoch = ds3231_regs_to_epoch(regs);
+    assert(epoch >= DS3231_EPOCH_MIN && epoch <= DS3231_EPOCH_MAX);
+    assert(ds3231_epoch_to_regs(epoch, back) == ESP_OK);
+
+    // The comma list takes the day of week as given, ISO 8601 calculates it like ds3231_epoch_to_regs()
+    bool iso_8601 = size >= 19 && data[4] == '-';
+    for (int i = 0; i < 7; i++)
+        assert(back[i] == regs[i] || (i == 3 && !iso_8601));
+
+    return 0;
+}
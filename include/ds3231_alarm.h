@@ -0,0 +1,115 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+#include "driver/gpio.h"
+
+#define DS3231_ALARM_STACK_SIZE 3072
+#define DS3231_ALARM_STATIC_CAPACITY 32 // Largest capacity with DS3231_STATIC_ALLOCATION
+#define DS3231_ALARM_ID_INVALID 0
+
+/**
+ * @brief Alarm callback, called from the dispatcher task.
+ *
+ * @param epoch Deadline of the alarm, seconds since 1970-01-01 00:00:00 UTC.
+ * @param arg Argument given to ds3231_alarm_add().
+ */
+typedef void (*ds3231_alarm_callback_t)(int64_t epoch, void *arg);
+
+/**
+ * @brief Handle of a scheduled alarm. A handle goes stale when its one-shot alarm fires or is cancelled.
+ */
+typedef uint32_t ds3231_alarm_id_t;
+
+typedef struct
+{
+  uint32_t dispatched;       // Callbacks called
+  uint32_t interrupts;       // INT edges seen
+  uint32_t hw_programs;      // Alarm register updates
+  uint64_t total_latency_us; // INT edge to callback
+  uint32_t max_latency_us;
+} ds3231_alarm_stats_t;
+
+/**
+ * @brief Start the alarm scheduler. Any number of software alarms share the two alarms of the chip:
+ * only the earliest deadline is programmed, into Alarm 2 when it falls on a whole minute and into
+ * Alarm 1 otherwise. INT/SQW is switched to the interrupt output, so it cannot be combined with ds3231_sqw.h.
+ *
+ * @param int_io GPIO connected to INT/SQW (open drain, the internal pull-up is enabled).
+ * GPIO_NUM_NC: no GPIO interrupt, the dispatcher wakes up on its own at the deadline.
+ * @param capacity Maximum number of scheduled alarms, up to 65535.
+ * @param priority Priority of the dispatcher task.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG capacity is 0, or above DS3231_ALARM_STATIC_CAPACITY with DS3231_STATIC_ALLOCATION.
+ * - ESP_ERR_INVALID_STATE Already started.
+ * - ESP_ERR_NO_MEM Could not allocate the alarm table or the dispatcher task.
+ * - ESP_FAIL Could not initialise the register map (ds3231_regmap_init()).
+ * - Errors of the GPIO setup. Whatever was set up is released again, the call can be repeated.
+ */
+esp_err_t ds3231_alarm_init(gpio_num_t int_io, uint16_t capacity, UBaseType_t priority);
+
+/**
+ * @brief Schedule an alarm, O(log n). Deadlines already in the past fire right away.
+ *
+ * @param epoch Deadline, seconds since 1970-01-01 00:00:00 UTC.
+ * @param period_s Repeat period in seconds, 0 - one-shot.
+ * @param callback Callback.
+ * @param arg Argument of the callback.
+ * @param [out] id Handle for ds3231_alarm_cancel(), can be NULL.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG callback is NULL.
+ * - ESP_ERR_INVALID_STATE ds3231_alarm_init() has not succeeded.
+ * - ESP_ERR_NO_MEM capacity alarms are already scheduled.
+ */
+esp_err_t ds3231_alarm_add(int64_t epoch, uint32_t period_s, ds3231_alarm_callback_t callback, void *arg,
+                           ds3231_alarm_id_t *id);
+
+/**
+ * @brief Cancel a scheduled alarm, O(log n).
+ *
+ * @param id Handle from ds3231_alarm_add().
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_NOT_FOUND The handle is stale.
+ * - ESP_ERR_INVALID_STATE ds3231_alarm_init() has not succeeded.
+ */
+esp_err_t ds3231_alarm_cancel(ds3231_alarm_id_t id);
+
+/**
+ * @brief Signal the INT edge from task context, e.g. from the simulator. The GPIO ISR has its own path.
+ */
+void ds3231_alarm_inject_interrupt(void);
+
+/**
+ * @brief Get a copy of the counters.
+ *
+ * @param [out] stats Counters.
+ */
+void ds3231_alarm_get_stats(ds3231_alarm_stats_t *stats);
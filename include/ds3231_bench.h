@@ -0,0 +1,99 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+#include "ds3231_sim.h"
+#include "ds3231_alarm.h"
+
+#define DS3231_BENCH_PORT I2C_NUM_1        // Port the simulated DS3231 is attached to, no I2C traffic
+#define DS3231_BENCH_ITERATIONS 1000       // Default timed iterations per case
+#define DS3231_BENCH_MAX_ITERATIONS 2000
+#define DS3231_BENCH_ALLOC_ITERATIONS 16   // Iterations traced for the allocation count
+#define DS3231_BENCH_ALLOC_RECORDS 256    // Heap trace records, a full trace is run again with half the iterations
+#define DS3231_BENCH_STACK_SIZE 4096
+#define DS3231_BENCH_STRESS_READERS 4      // Reader tasks of the stress runs, spread over both cores
+#define DS3231_BENCH_STRESS_MS 1000        // Duration of each stress run
+#define DS3231_BENCH_COALESCE_CALLS 64     // Date/time reads per caller in the single flight runs (1, 4, 16 callers)
+#define DS3231_BENCH_WORKER_CALLS 64       // Time register reads per submitter in the bus worker runs (1, 4, 16 submitters)
+#define DS3231_BENCH_LOG_EVENTS 1000       // Events of the event log summary
+#define DS3231_BENCH_DECODE_DUMPS 64       // Register dumps decoded per round of the decoder summary
+#define DS3231_BENCH_DECODE_ROUNDS 100
+#define DS3231_BENCH_CONSENSUS_CHIPS 16    // Simulated RTCs of the consensus summary, runs with 1, 2, 4 ... of them
+#define DS3231_BENCH_CONSENSUS_ROUNDS 50   // Consensus rounds per run
+#if DS3231_STATIC_ALLOCATION
+#define DS3231_BENCH_ALARMS (DS3231_ALARM_STATIC_CAPACITY - 1) // One entry is the run's sentinel
+#else
+#define DS3231_BENCH_ALARMS 10000          // Alarms armed by the alarm run (+ 1 sentinel), fewer when the table does not fit
+#endif
+#define DS3231_BENCH_ALARM_SECONDS 4       // The alarm run spreads its deadlines over this many seconds
+
+typedef struct
+{
+  uint32_t iterations;     // Timed iterations per case, up to DS3231_BENCH_MAX_ITERATIONS
+  uint32_t bus_freq_hz;    // Clock of the simulated bus, 0 - no bus latency
+  ds3231_sim_t *alarm_sim; // Model behind the default device for the alarm run, NULL - no alarm run
+} ds3231_bench_config_t;
+
+/**
+ * @brief Run every benchmark case against a simulated DS3231 and write the results as one JSON
+ * document: ns/op, p50/p90/p99/max and allocations/op (null unless CONFIG_HEAP_TRACING_STANDALONE).
+ * The cases run in a task pinned to the calling core, timed with the CPU cycle counter.
+ * The stress runs read the time from DS3231_BENCH_STRESS_READERS tasks at once, through a snapshot
+ * cell updated by a writer task as fast as it can (checking for torn reads) and through the bus mutex.
+ * The format_render cases render the registers of one time with each precompiled format, the strftime
+ * cases the same time from a struct tm with the equivalent spec.
+ * The epoch cases convert the same time to seconds since the epoch with ds3231_regs_to_epoch(), with
+ * ds3231_time_to_epoch() on decimal digits and with mktime() on the struct tm.
+ * The i2c_cmd_link cases build the command of a register write on the heap and in a static buffer,
+ * the difference is the per call saving of DS3231_STATIC_ALLOCATION on the write path.
+ * The single flight runs let 1, 4 and 16 tasks read the date and time at once and count bus transactions.
+ * The bus worker runs queue time register reads to the bus worker (ds3231_bus_worker.h) from 1, 4 and 16
+ * tasks at once and give the reads per second and the submission to completion latency.
+ * The alarm run needs config->alarm_sim and starts the alarm scheduler (ds3231_alarm.h) on the default device
+ * unless it runs already. It arms DS3231_BENCH_ALARMS alarms an hour or two ahead and cancels them (ns/op of
+ * ds3231_alarm_add() and ds3231_alarm_cancel()), then arms them again over the next DS3231_BENCH_ALARM_SECONDS
+ * seconds and drives the model's INT edges: the latency from the edge to the first callback and to every callback.
+ * Without the alarm run "alarm" is null.
+ * The event log cases append records to a log on a storage which only counts (log_append) and format
+ * the same events as text lines (log_string), the event_log summary gives the bytes per event, the
+ * events per second and the flash writes and erases per 1000 events.
+ * The decode summary gives the register dumps per second of ds3231_decode_batch() and of the scalar
+ * reference decoder, and the number of dumps on which the two disagree.
+ * The consensus runs read 1, 2, 4 ... DS3231_BENCH_CONSENSUS_CHIPS simulated RTCs on DS3231_BENCH_PORT,
+ * the 4th is set 30 s ahead and the 8th has lost its power, and give the round latency, the bound and the
+ * error of the result against the time the chips were set from, for both selection modes.
+ *
+ * @param config Configuration, NULL - DS3231_BENCH_ITERATIONS at I2C_MASTER_FREQ_HZ without the alarm run.
+ * @param out Destination stream, e.g. stdout.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE DS3231_BENCH_PORT is used by a real device.
+ * - ESP_ERR_NO_MEM Could not create the benchmark task, or not even one alarm fits.
+ */
+esp_err_t ds3231_bench_run(const ds3231_bench_config_t *config, FILE *out);
@@ -0,0 +1,66 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <esp_err.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Bus backend used by ds3231_read_data() and ds3231_write_data().
+ *
+ * The driver never talks to the I2C peripheral directly, every transaction goes through
+ * one of these function tables. The default backend uses the ESP-IDF I2C master driver,
+ * the simulated DS3231 (see ds3231_sim.h) provides another one.
+ */
+typedef struct
+{
+  /**
+   * @brief Write followed by a read with a repeated start between them.
+   */
+  esp_err_t (*write_read)(void *ctx, uint8_t device_address, const uint8_t *write_buffer, size_t write_size,
+                          uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait);
+  /**
+   * @brief Write the register address followed by the data in one transaction.
+   */
+  esp_err_t (*write)(void *ctx, uint8_t device_address, const uint8_t *address, size_t address_size,
+                     const uint8_t *tx_buffer, size_t tx_buffer_size, TickType_t ticks_to_wait);
+  /**
+   * @brief Free a bus held low by a slave (9 SCL pulses and a STOP) and reset the controller.
+   * Optional, NULL when the backend cannot do it.
+   */
+  esp_err_t (*recover)(void *ctx);
+  // Backend specific context passed to every call (I2C port number, simulator instance...)
+  void *ctx;
+} ds3231_bus_backend_t;
+
+/**
+ * @brief Backend using the ESP-IDF I2C master driver on I2C_MASTER_PORT.
+ */
+extern const ds3231_bus_backend_t ds3231_esp_bus_backend;
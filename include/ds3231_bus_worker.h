@@ -0,0 +1,151 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#include <freertos/queue.h>
+
+#define DS3231_BUS_WORKER_STACK_SIZE 3072
+#define DS3231_BUS_WORKER_QUEUE_DEPTH 16 // Default depth of each priority queue
+
+typedef enum
+{
+  DS3231_BUS_OP_READ,
+  DS3231_BUS_OP_WRITE
+} ds3231_bus_op_t;
+
+typedef enum
+{
+  DS3231_BUS_PRIORITY_HIGH, // Served first, e.g. time reads
+  DS3231_BUS_PRIORITY_LOW,  // Bulk configuration writes
+  DS3231_BUS_PRIORITY_COUNT
+} ds3231_bus_priority_t;
+
+/**
+ * @brief Completion callback, called from the worker task.
+ */
+typedef void (*ds3231_bus_callback_t)(esp_err_t result, void *arg);
+
+/**
+ * @brief Transaction descriptor. The buffer has to stay valid until the completion.
+ */
+typedef struct
+{
+  ds3231_bus_op_t op;
+  ds3231_dev_t *dev;              // Device, NULL - the default device of i2c_ds3231_init()
+  uint8_t address;                // First register
+  uint8_t *buffer;                // Destination of a read, source of a write
+  size_t size;                    // Number of registers
+  ds3231_bus_callback_t callback; // Completion callback, NULL to notify notify_task instead
+  void *arg;                      // Argument of the callback
+  TaskHandle_t notify_task;       // Task notified with the result (esp_err_t) when callback is NULL
+} ds3231_bus_request_t;
+
+typedef struct
+{
+  uint32_t completed;
+  uint32_t failed;
+  uint32_t rejected;         // Queue was full
+  uint64_t total_latency_us; // Submission to completion
+  uint32_t max_latency_us;
+} ds3231_bus_worker_stats_t;
+
+/**
+ * @brief Start the bus worker task. From then on it serves the submitted transactions one by one.
+ * The worker is opt-in: it does not own the bus, the driver API (ds3231_get_date_time(), ds3231_dev_read_data(),
+ * the regmap, the temperature service, ...) keeps going to the device directly under the device lock. The priorities
+ * only order the transactions submitted here, against each other.
+ *
+ * @param priority Priority of the worker task.
+ * @param queue_depth Depth of each priority queue, 0 selects DS3231_BUS_WORKER_QUEUE_DEPTH.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG queue_depth is above DS3231_BUS_WORKER_QUEUE_DEPTH with DS3231_STATIC_ALLOCATION.
+ * - ESP_ERR_INVALID_STATE The worker is already running.
+ * - ESP_ERR_NO_MEM Could not create the queues or the task.
+ */
+esp_err_t ds3231_bus_worker_start(UBaseType_t priority, size_t queue_depth);
+
+/**
+ * @brief Queue a transaction. Completion is reported via the callback or the task notification.
+ *
+ * @param request Transaction descriptor, copied into the queue.
+ * @param priority Queue to use.
+ * @param ticks_to_wait Time to wait for room in the queue.
+ * @return
+ * - ESP_OK Queued.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE The worker is not running.
+ * - ESP_ERR_TIMEOUT The queue is full.
+ */
+esp_err_t ds3231_bus_submit(const ds3231_bus_request_t *request, ds3231_bus_priority_t priority, TickType_t ticks_to_wait);
+
+/**
+ * @brief Blocking read through the worker from the default device. The calling task waits on a
+ * semaphore of its own, its task notifications are not used.
+ *
+ * @param address First register.
+ * @param [out] rx_buffer Register values.
+ * @param rx_buffer_size Number of registers.
+ * @param priority Queue to use.
+ * @return Result of ds3231_bus_submit() or of the transaction.
+ */
+esp_err_t ds3231_bus_worker_read(uint8_t address, uint8_t *rx_buffer, size_t rx_buffer_size, ds3231_bus_priority_t priority);
+
+/**
+ * @brief Blocking write through the worker to the default device. The calling task waits on a
+ * semaphore of its own, its task notifications are not used.
+ *
+ * @param address First register.
+ * @param tx_buffer Register values.
+ * @param tx_buffer_size Number of registers.
+ * @param priority Queue to use.
+ * @return Result of ds3231_bus_submit() or of the transaction.
+ */
+esp_err_t ds3231_bus_worker_write(uint8_t address, uint8_t *tx_buffer, size_t tx_buffer_size, ds3231_bus_priority_t priority);
+
+/**
+ * @brief Blocking read through the worker from any device, see ds3231_bus_worker_read().
+ *
+ * @param dev Device handle.
+ * @param address First register.
+ * @param [out] rx_buffer Register values.
+ * @param rx_buffer_size Number of registers.
+ * @param priority Queue to use.
+ * @return Result of ds3231_bus_submit() or of the transaction, ESP_ERR_INVALID_ARG without a device.
+ */
+esp_err_t ds3231_bus_worker_dev_read(ds3231_dev_t *dev, uint8_t address, uint8_t *rx_buffer, size_t rx_buffer_size,
+                                     ds3231_bus_priority_t priority);
+
+/**
+ * @brief Get a copy of the counters of a priority queue.
+ *
+ * @param priority Queue.
+ * @param [out] stats Counters.
+ */
+void ds3231_bus_worker_get_stats(ds3231_bus_priority_t priority, ds3231_bus_worker_stats_t *stats);
@@ -0,0 +1,158 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_CAL_WINDOW 64              // Samples in the sliding window of the fit
+#define DS3231_CAL_INTERVAL_S 300         // Default time between two samples of the calibration task
+#define DS3231_CAL_MIN_SPAN_S 3600        // Default window span needed before the aging offset is trimmed
+#define DS3231_CAL_TRIM_STDERR_PPM 0.03f  // Largest standard error of the drift which allows a trim
+#define DS3231_CAL_MIN_TEMP_SPREAD 1.0f   // Temperature range of the window needed for the temperature term, degrees
+#define DS3231_CAL_JUMP_US 500000         // Sample off the fit by more than this: the time was set, restart the window
+#define DS3231_CAL_MAX_ERROR_MS 100       // Time error the suggested resync interval allows
+#define DS3231_CAL_STACK_SIZE 3072
+
+/**
+ * @brief Reference clock: microseconds on any fixed epoch, e.g. esp_timer_get_time() or an NTP disciplined
+ * gettimeofday(). The aging offset is trimmed towards it, so it has to be better than the RTC.
+ */
+typedef int64_t (*ds3231_cal_reference_t)(void *ctx);
+
+typedef struct
+{
+  ds3231_cal_reference_t reference; // NULL - esp_timer_get_time()
+  void *reference_ctx;
+  uint32_t interval_s;              // Time between samples of the calibration task
+  uint32_t min_span_s;              // Window span needed before the aging offset is trimmed
+  bool auto_trim;                   // Write the aging offset as soon as the drift is known well enough
+} ds3231_cal_config_t;
+
+#define DS3231_CAL_CONFIG_DEFAULT()       \
+  {                                       \
+    .reference = NULL,                    \
+    .reference_ctx = NULL,                \
+    .interval_s = DS3231_CAL_INTERVAL_S,  \
+    .min_span_s = DS3231_CAL_MIN_SPAN_S,  \
+    .auto_trim = true                     \
+  }
+
+typedef struct
+{
+  uint32_t samples;         // Samples in the window
+  float span_s;             // Reference time covered by the window
+  float drift_ppm;          // RTC against the reference at the mean temperature since the last trim, positive - fast
+  float drift_stderr_ppm;   // Standard error of drift_ppm
+  float temp_coeff_ppm;     // Drift change per degree, 0 - the window lacks DS3231_CAL_MIN_TEMP_SPREAD
+  float mean_temp;          // Mean temperature of the window, degrees Celsius
+  float rms_error_us;       // RMS distance of the samples from the fit, the edge detection noise
+  float initial_drift_ppm;  // Drift before the first trim, NAN - not known yet
+  int8_t aging_offset;      // Current aging offset register
+  uint32_t trims;           // Aging offset writes
+  uint32_t restarts;        // Windows dropped because the time was set
+  uint32_t resync_interval_s; // Time until |drift| + 2 standard errors accumulate DS3231_CAL_MAX_ERROR_MS, 0 - unknown
+} ds3231_cal_status_t;
+
+/**
+ * @brief Set up the calibration and read the aging offset. Needs the register map (ds3231_regmap.h) and
+ * the temperature service (ds3231_temp.h).
+ *
+ * @param config Configuration, NULL - DS3231_CAL_CONFIG_DEFAULT().
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_NO_MEM Could not create the mutex.
+ * - Errors of ds3231_regmap_read().
+ */
+esp_err_t ds3231_cal_init(const ds3231_cal_config_t *config);
+
+/**
+ * @brief ds3231_cal_init() and a task which takes a sample every config->interval_s seconds.
+ *
+ * @param config Configuration, NULL - DS3231_CAL_CONFIG_DEFAULT().
+ * @param priority Priority of the calibration task.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE Already started.
+ * - ESP_ERR_NO_MEM Could not create the task.
+ * - Errors of ds3231_cal_init().
+ */
+esp_err_t ds3231_cal_start(const ds3231_cal_config_t *config, UBaseType_t priority);
+
+/**
+ * @brief Measure one sample now: the reference time of a seconds edge of the RTC, found by polling the
+ * time registers (up to about 1 s, the last few ms without sleeping) and the temperature. Updates the
+ * fit and, with auto_trim, the aging offset.
+ *
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE Not initialised.
+ * - ESP_ERR_TIMEOUT No seconds edge seen, the oscillator may be stopped.
+ * - Errors of ds3231_read_data().
+ */
+esp_err_t ds3231_cal_sample(void);
+
+/**
+ * @brief Add a sample measured elsewhere, e.g. an SQW edge timestamped against a GPS PPS.
+ *
+ * @param ref_us Reference time of the sample, on the epoch of the configured reference.
+ * @param rtc_us RTC time at the same moment, microseconds since 1970-01-01 00:00:00 UTC.
+ * @param temp Temperature, degrees Celsius.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE Not initialised.
+ * - ESP_ERR_INVALID_ARG The reference time did not advance.
+ * - Errors of the aging offset write with auto_trim.
+ */
+esp_err_t ds3231_cal_feed(int64_t ref_us, int64_t rtc_us, float temp);
+
+/**
+ * @brief Write the aging offset which cancels the estimated drift (restarting the window when it changes),
+ * whether the estimate is good enough for auto_trim or not.
+ *
+ * @return
+ * - ESP_OK Success, also when the aging offset is already right.
+ * - ESP_ERR_INVALID_STATE Not initialised or fewer than 3 samples.
+ * - Errors of ds3231_regmap_write() and ds3231_regmap_flush().
+ */
+esp_err_t ds3231_cal_trim(void);
+
+/**
+ * @brief Drop the samples, e.g. after the reference clock jumped.
+ */
+void ds3231_cal_reset(void);
+
+/**
+ * @brief Current estimate.
+ *
+ * @param [out] status Estimate.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG status is NULL.
+ * - ESP_ERR_INVALID_STATE Not initialised.
+ */
+esp_err_t ds3231_cal_get_status(ds3231_cal_status_t *status);
@@ -0,0 +1,139 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_CONSENSUS_MAX_SOURCES 16
+#define DS3231_CONSENSUS_WEIGHT 4                 // Vote of a source with a valid time
+#define DS3231_CONSENSUS_OSF_WEIGHT 1             // Vote of a source whose oscillator stopped (OSF set)
+#define DS3231_CONSENSUS_MEDIAN_LIMIT_US 1500000  // Median selection: sources further from the median are outliers
+#define DS3231_CONSENSUS_STACK_SIZE 2560
+
+typedef enum
+{
+  DS3231_CONSENSUS_MARZULLO, // Largest weight of overlapping intervals, the result is their intersection
+  DS3231_CONSENSUS_MEDIAN    // Weighted median of the interval centres
+} ds3231_consensus_mode_t;
+
+/**
+ * @brief Trusted time agreed on by the sources.
+ */
+typedef struct
+{
+  int64_t epoch_us;    // Microseconds since 1970-01-01 00:00:00 UTC at mono_us
+  int64_t mono_us;     // esp_timer time all the reads were aligned to
+  int64_t bound_us;    // The time at mono_us is epoch_us +/- bound_us, if the agreeing sources are right
+  uint8_t sources;     // Sources read successfully
+  uint8_t agreeing;    // Sources whose interval contains the result (median: within the limit)
+  uint32_t failed;     // Bit per source which could not be read
+  uint32_t outliers;   // Bit per source which was read but disagrees with the result
+  uint32_t osf;        // Bit per source with the Oscillator Stop Flag set
+  uint32_t latency_us; // Duration of the round, from the start of the reads to the result
+} ds3231_consensus_result_t;
+
+/**
+ * @brief Consensus over several DS3231s, filled by ds3231_consensus_init().
+ *
+ * Every round reads the time and status registers of all sources, one reader task per I2C port so that
+ * the buses work in parallel. A register read only gives the whole second and happens somewhere within
+ * the transaction, so each read becomes the interval of times the source allows at one common esp_timer
+ * instant: [seconds - (instant - end of the read), seconds + 1 s + (instant - start of the read)).
+ * The sources vote with their intervals, sources with OSF set with a smaller weight.
+ */
+typedef struct
+{
+  ds3231_dev_t *sources[DS3231_CONSENSUS_MAX_SOURCES];
+  size_t count;
+  SemaphoreHandle_t lock;                 // One round at a time, guards the source list
+  SemaphoreHandle_t done;                 // Counting, given by every reader at the end of its reads
+#if DS3231_STATIC_ALLOCATION
+  StaticSemaphore_t lock_buffer;
+  StaticSemaphore_t done_buffer;
+  StaticTask_t reader_tcb[I2C_NUM_MAX];
+  StackType_t reader_stack[I2C_NUM_MAX][DS3231_CONSENSUS_STACK_SIZE];
+#endif
+  TaskHandle_t readers[I2C_NUM_MAX];      // Reader task of each port
+  esp_err_t read_result[DS3231_CONSENSUS_MAX_SOURCES];
+  int64_t read_start_us[DS3231_CONSENSUS_MAX_SOURCES];
+  int64_t read_end_us[DS3231_CONSENSUS_MAX_SOURCES];
+  uint8_t registers[DS3231_CONSENSUS_MAX_SOURCES][DS3231_STATUS_REGISTER_ADDRESS + 1];
+  portMUX_TYPE result_lock;
+  bool published;
+  ds3231_consensus_result_t result; // Result of the last successful round
+} ds3231_consensus_t;
+
+/**
+ * @brief Start the reader tasks, one per I2C port.
+ *
+ * @param consensus Consensus to fill.
+ * @param priority Priority of the reader tasks.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_NO_MEM Could not create the semaphores or the tasks, whatever was created is deleted again.
+ */
+esp_err_t ds3231_consensus_init(ds3231_consensus_t *consensus, UBaseType_t priority);
+
+/**
+ * @brief Replace the sources, between two rounds.
+ *
+ * @param consensus Consensus.
+ * @param sources Initialised devices, on any ports. The handles have to stay valid while they are used.
+ * @param count Number of sources, 1 - DS3231_CONSENSUS_MAX_SOURCES.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE The consensus is not initialised.
+ */
+esp_err_t ds3231_consensus_set_sources(ds3231_consensus_t *consensus, ds3231_dev_t *const *sources, size_t count);
+
+/**
+ * @brief Read all sources once and select the time. A result is only published when the sources
+ * agreeing with it have more than half of the weight of the sources which could be read.
+ *
+ * @param consensus Consensus.
+ * @param mode Selection of the result.
+ * @param [out] result Result of the round, also filled when there was no majority. Can be NULL.
+ * @return
+ * - ESP_OK Success, the result was published.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE The consensus is not initialised or has no sources.
+ * - ESP_ERR_NOT_FOUND No source could be read.
+ * - ESP_ERR_INVALID_RESPONSE The sources do not agree, no majority.
+ */
+esp_err_t ds3231_consensus_read(ds3231_consensus_t *consensus, ds3231_consensus_mode_t mode,
+                                ds3231_consensus_result_t *result);
+
+/**
+ * @brief Get the last published result, callable from any task.
+ *
+ * @param consensus Consensus.
+ * @param [out] result Result, its time now is epoch_us + (esp_timer_get_time() - mono_us).
+ * @return true - success, false - nothing was published yet.
+ */
+bool ds3231_consensus_get(ds3231_consensus_t *consensus, ds3231_consensus_result_t *result);
@@ -0,0 +1,80 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "ds3231_epoch.h"
+
+#define DS3231_DECODE_VERIFY_CHUNK 32 // Snapshots decoded per step of ds3231_decode_verify(), on the stack
+
+/**
+ * @brief Structure of arrays filled by the batch decoders, one element per snapshot.
+ */
+typedef struct
+{
+  int64_t *epoch;       // Seconds since 1970-01-01 00:00:00 UTC
+  int16_t *temp_q;      // Temperature in 1/4 degrees Celsius
+  uint8_t *osf;         // 1 - Oscillator Stop Flag set
+  uint8_t *alarm_flags; // DS3231_STATUS_A1F | DS3231_STATUS_A2F of the status register
+} ds3231_decode_out_t;
+
+/**
+ * @brief Decode register dumps as returned by ds3231_read_data() from register 0, DS3231_REGISTER_COUNT
+ * bytes each, back to back. The BCD digits of the time registers are unpacked for several dumps at
+ * once: 4 per instruction with AVX2, 2 with SSE2 (x86 builds with -mavx2 / -msse2), 1 in a 64 bit
+ * word otherwise, which is the code ds3231_regs_to_epoch() uses on the device.
+ *
+ * @param dumps count * DS3231_REGISTER_COUNT bytes.
+ * @param count Number of dumps.
+ * @param out Output arrays with room for count elements each.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ */
+esp_err_t ds3231_decode_batch(const uint8_t *dumps, size_t count, const ds3231_decode_out_t *out);
+
+/**
+ * @brief Same as ds3231_decode_batch() one dump at a time, with bcd2dec() for every field.
+ * The reference ds3231_decode_verify() compares against.
+ */
+esp_err_t ds3231_decode_batch_scalar(const uint8_t *dumps, size_t count, const ds3231_decode_out_t *out);
+
+/**
+ * @brief Decode with both ds3231_decode_batch() and ds3231_decode_batch_scalar() and compare the results.
+ *
+ * @param dumps count * DS3231_REGISTER_COUNT bytes.
+ * @param count Number of dumps.
+ * @param [out] mismatches Dumps with any field different, 0 - bit identical.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ */
+esp_err_t ds3231_decode_verify(const uint8_t *dumps, size_t count, size_t *mismatches);
+
+/**
+ * @brief Name of the unpacking used by ds3231_decode_batch(): "avx2", "sse2" or "swar".
+ */
+const char *ds3231_decode_impl(void);
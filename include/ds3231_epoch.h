@@ -0,0 +1,111 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_EPOCH_MIN 946684800LL  // 2000-01-01 00:00:00
+#define DS3231_EPOCH_MAX 7258118399LL // 2199-12-31 23:59:59
+
+#define DS3231_TIME_DIGIT_MASK 0x00FF1F3F073F7F7FULL // Value bits of the 7 time registers, register 0 lowest
+
+/**
+ * @brief Convert the 7 time registers from BCD to decimal in one go, 8 bytes at a time in a 64 bit word.
+ * Every byte is bcd2dec() of the register masked with DS3231_TIME_DIGIT_MASK, hours as written:
+ * ds3231_time_to_epoch() sorts out 12 hour mode and the century bit.
+ *
+ * @param regs Raw register values starting at DS3231_TIME_ADDRESS.
+ * @param [out] digits 7 decimal values.
+ */
+void ds3231_bcd_unpack_time(const uint8_t *regs, uint8_t *digits);
+
+/**
+ * @brief Seconds since the epoch from the raw time registers and their decimal values, the second half
+ * of ds3231_regs_to_epoch() for callers which unpack many registers at once (ds3231_decode.h).
+ *
+ * @param regs Raw register values starting at DS3231_TIME_ADDRESS.
+ * @param digits Decimal values as from ds3231_bcd_unpack_time().
+ * @return Seconds since the epoch.
+ */
+int64_t ds3231_time_to_epoch(const uint8_t *regs, const uint8_t *digits);
+
+/**
+ * @brief Convert the 7 time registers to seconds since 1970-01-01 00:00:00 UTC.
+ * The century bit of the month register selects 20xx / 21xx, 12 hour mode is supported.
+ * No mktime: the result does not depend on TZ.
+ *
+ * @param regs Raw register values starting at DS3231_TIME_ADDRESS.
+ * @return Seconds since the epoch.
+ */
+int64_t ds3231_regs_to_epoch(const uint8_t *regs);
+
+/**
+ * @brief Convert seconds since the epoch to the 7 time registers (24 hour mode, 1 - Sunday).
+ *
+ * @param epoch Seconds since 1970-01-01 00:00:00 UTC, DS3231_EPOCH_MIN - DS3231_EPOCH_MAX.
+ * @param [out] regs Register values starting at DS3231_TIME_ADDRESS.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG epoch is out of the range of the RTC.
+ */
+esp_err_t ds3231_epoch_to_regs(int64_t epoch, uint8_t *regs);
+
+/**
+ * @brief Read the current time as seconds since the epoch.
+ *
+ * @param [out] epoch Seconds since 1970-01-01 00:00:00 UTC.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_get_epoch(int64_t *epoch);
+
+/**
+ * @brief Same as ds3231_get_epoch() on the given device.
+ */
+esp_err_t ds3231_dev_get_epoch(ds3231_dev_t *dev, int64_t *epoch);
+
+/**
+ * @brief Set the time from seconds since the epoch.
+ *
+ * @param epoch Seconds since 1970-01-01 00:00:00 UTC, DS3231_EPOCH_MIN - DS3231_EPOCH_MAX.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG epoch is out of the range of the RTC.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_set_epoch(int64_t epoch);
+
+/**
+ * @brief Same as ds3231_set_epoch() on the given device.
+ */
+esp_err_t ds3231_dev_set_epoch(ds3231_dev_t *dev, int64_t epoch);
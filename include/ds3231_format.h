@@ -0,0 +1,89 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_FORMAT_MAX_OPS 24   // Ops of one compiled format
+#define DS3231_FORMAT_MAX_CUSTOM 8 // Custom formats which can be registered
+
+/**
+ * @brief A format spec compiled into a sequence of ops which render straight from the raw
+ * time registers. Every op is two bytes: the op code and its argument.
+ */
+typedef struct
+{
+  uint8_t ops[DS3231_FORMAT_MAX_OPS * 2];
+  uint8_t op_count;
+  uint8_t length; // Length of the rendered string without the terminating 0
+} ds3231_format_t;
+
+/**
+ * @brief Compile a strftime-like spec. Supported conversions: %Y %y %m %d %H %I %M %S %p %u %%,
+ * every other character is copied as it is. %u is the day of the week as in strftime, 1 - Monday to
+ * 7 - Sunday, converted from the day register (1 - Sunday).
+ *
+ * @param spec Format spec, e.g. "%Y-%m-%d %H:%M:%S".
+ * @param [out] format Compiled format.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Unknown conversion.
+ * - ESP_ERR_INVALID_SIZE The spec needs more than DS3231_FORMAT_MAX_OPS ops.
+ */
+esp_err_t ds3231_format_compile(const char *spec, ds3231_format_t *format);
+
+/**
+ * @brief Render the time registers with a compiled format.
+ *
+ * @param format Compiled format.
+ * @param regs Raw register values starting at DS3231_TIME_ADDRESS (7 bytes).
+ * @param [out] str_buffer Destination of the C string.
+ * @param buffer_size Size of str_buffer.
+ * @return Length of the string, 0 if str_buffer is too small.
+ */
+size_t ds3231_format_render(const ds3231_format_t *format, const uint8_t *regs, char *str_buffer, size_t buffer_size);
+
+/**
+ * @brief Get the compiled format of a date_time_format value, UNIX_TIMESTAMPS has none.
+ *
+ * @param dt_format Built-in or registered format.
+ * @return Compiled format, NULL if dt_format has none.
+ */
+const ds3231_format_t *ds3231_format_get(date_time_format dt_format);
+
+/**
+ * @brief Register a custom format which can be passed to ds3231_get_date_time_r().
+ *
+ * @param spec Format spec, see ds3231_format_compile().
+ * @param [out] dt_format Value to pass as date_time_format.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error or unknown conversion.
+ * - ESP_ERR_INVALID_SIZE The spec is too long.
+ * - ESP_ERR_NO_MEM All DS3231_FORMAT_MAX_CUSTOM slots are used.
+ */
+esp_err_t ds3231_format_register(const char *spec, date_time_format *dt_format);
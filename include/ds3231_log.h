@@ -0,0 +1,176 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_LOG_PAGE_SIZE 256          // Flash program page, the unit of one write
+#define DS3231_LOG_SECTOR_SIZE 4096       // Flash erase unit
+#define DS3231_LOG_PAGE_HEADER_SIZE 16    // Magic, record bytes, sequence number, base epoch
+#define DS3231_LOG_PAGE_CRC_SIZE 2        // CRC-16 behind the records
+#define DS3231_LOG_MAX_PAYLOAD 32         // Payload bytes of one record
+#define DS3231_LOG_MAGIC 0x4C44           // "DL", little endian
+#define DS3231_LOG_PARTITION_LABEL "rtclog"
+
+/**
+ * @brief Storage of the event log: a flash partition, or a plain file in a host build.
+ * Behaves like NOR flash: erase sets whole sectors to 0xFF, write only goes to erased space.
+ */
+typedef struct
+{
+  esp_err_t (*read)(void *ctx, uint32_t offset, void *buffer, size_t size);
+  esp_err_t (*write)(void *ctx, uint32_t offset, const void *buffer, size_t size);
+  esp_err_t (*erase)(void *ctx, uint32_t offset, size_t size);
+  uint32_t size; // Bytes, a multiple of DS3231_LOG_SECTOR_SIZE
+  // Storage specific context passed to every call (partition, FILE...)
+  void *ctx;
+} ds3231_log_storage_t;
+
+typedef struct
+{
+  uint32_t events;       // Records appended
+  uint32_t dropped;      // Records lost with a page which could not be written
+  uint64_t record_bytes; // Encoded size of the appended records, without the page headers
+  uint32_t page_writes;  // Storage writes, one per page
+  uint32_t erases;       // Sector erases
+  uint32_t next_seq;     // Sequence number of the page being filled
+  uint32_t buffered;     // Record bytes waiting in the page buffer
+} ds3231_log_stats_t;
+
+/**
+ * @brief Append-only event log, filled by ds3231_log_init().
+ *
+ * Records are collected in a RAM page and written when the page is full or on ds3231_log_flush(),
+ * the storage is a ring of pages with increasing sequence numbers. Page layout (little endian):
+ * magic u16, record bytes u16, sequence number u32, base epoch s64, the records, CRC-16/CCITT-FALSE
+ * u16 over everything in front of it, 0xFF up to the end of the page.
+ * Record: zigzag varint of the seconds since the previous record (the first one of a page since
+ * the base epoch), event id u8, payload size u8, payload.
+ */
+typedef struct
+{
+  ds3231_log_storage_t storage;
+  SemaphoreHandle_t lock;
+#if DS3231_STATIC_ALLOCATION
+  StaticSemaphore_t lock_buffer;
+#endif
+  uint32_t offset;     // Storage offset of the page being filled
+  int64_t last_epoch;  // Time of the last record in the page buffer
+  uint16_t used;       // Record bytes in the page buffer
+  uint16_t events;     // Records in the page buffer
+  uint8_t page[DS3231_LOG_PAGE_SIZE];
+  ds3231_log_stats_t stats;
+} ds3231_log_t;
+
+/**
+ * @brief Open a log on a storage: the pages are scanned for the highest sequence number and the
+ * log continues after it, a page spoilt by a power loss during a write is skipped.
+ *
+ * @param log Log to fill.
+ * @param storage Storage, copied.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error, the storage is smaller than two sectors.
+ * - ESP_ERR_NO_MEM Could not create the mutex.
+ * - Errors of the storage read.
+ */
+esp_err_t ds3231_log_init(ds3231_log_t *log, const ds3231_log_storage_t *storage);
+
+/**
+ * @brief Append a record stamped with the current time: from the snapshot (ds3231_snapshot.h) when
+ * it is running, else from the time service. Writes the page when it is full.
+ *
+ * @param log Log.
+ * @param event Event id, meaning up to the application.
+ * @param data Payload, NULL when size is 0.
+ * @param size Payload size, up to DS3231_LOG_MAX_PAYLOAD.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE Not initialised.
+ * - Errors of ds3231_ts_get_time().
+ * - Errors of the storage write or erase, the records of the page are lost.
+ */
+esp_err_t ds3231_log_append(ds3231_log_t *log, uint8_t event, const void *data, size_t size);
+
+/**
+ * @brief Same as ds3231_log_append() with the time given.
+ *
+ * @param epoch Seconds since 1970-01-01 00:00:00 UTC.
+ */
+esp_err_t ds3231_log_append_at(ds3231_log_t *log, int64_t epoch, uint8_t event, const void *data, size_t size);
+
+/**
+ * @brief Write the page buffer now, e.g. before a reset. The page is closed even when it is not
+ * full, flash cannot be written twice without an erase.
+ *
+ * @param log Log.
+ * @return
+ * - ESP_OK Success, also when the buffer was empty.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE Not initialised.
+ * - Errors of the storage write or erase.
+ */
+esp_err_t ds3231_log_flush(ds3231_log_t *log);
+
+/**
+ * @brief Get a copy of the counters.
+ *
+ * @param log Log.
+ * @param [out] stats Counters.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE Not initialised.
+ */
+esp_err_t ds3231_log_get_stats(ds3231_log_t *log, ds3231_log_stats_t *stats);
+
+/**
+ * @brief Storage on a data partition, see partitions.csv.
+ *
+ * @param [out] storage Storage to fill.
+ * @param label Partition label, NULL - DS3231_LOG_PARTITION_LABEL.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_NOT_FOUND No partition with this label.
+ */
+esp_err_t ds3231_log_partition_storage(ds3231_log_storage_t *storage, const char *label);
+
+/**
+ * @brief Storage in a plain file, for a host build or a mounted file system. A missing or short
+ * file is extended with 0xFF to size bytes. The file stays open.
+ *
+ * @param [out] storage Storage to fill.
+ * @param path File path.
+ * @param size Bytes, a multiple of DS3231_LOG_SECTOR_SIZE.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_FAIL Could not open or extend the file.
+ */
+esp_err_t ds3231_log_file_storage(ds3231_log_storage_t *storage, const char *path, uint32_t size);
@@ -0,0 +1,45 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+/**
+ * @brief Parse a date and time string straight into the 7 time registers. Reentrant, the string is
+ * not modified and does not need to be 0 terminated. Accepted formats:
+ * - "sec,min,hour,dow,date,month,year" with 1 or 2 digit fields, year 00-99 (2000-2099), dow 1 - Sunday.
+ * - ISO 8601 "YYYY-MM-DDTHH:MM:SS" (a space instead of 'T' and a trailing 'Z' are accepted),
+ *   year 2000-2199, the day of week is calculated.
+ *
+ * @param str Date and time string.
+ * @param len Length of str.
+ * @param [out] regs Register values starting at DS3231_TIME_ADDRESS (24 hour mode).
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Syntax error or a field is out of range (including the day of the month).
+ */
+esp_err_t ds3231_parse_date_time(const char *str, size_t len, uint8_t *regs);
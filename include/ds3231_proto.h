@@ -0,0 +1,151 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+// Frame: SYNC LEN CMD SEQ PAYLOAD[LEN] CRC16 (little endian, CRC-16/CCITT-FALSE over LEN..PAYLOAD)
+#define DS3231_PROTO_SYNC 0xA5         // Never part of a text command, starts a binary frame
+#define DS3231_PROTO_VERSION 1
+#define DS3231_PROTO_HEADER_SIZE 4     // SYNC, LEN, CMD, SEQ
+#define DS3231_PROTO_CRC_SIZE 2
+#define DS3231_PROTO_MAX_PAYLOAD 192
+#define DS3231_PROTO_MAX_FRAME (DS3231_PROTO_HEADER_SIZE + DS3231_PROTO_MAX_PAYLOAD + DS3231_PROTO_CRC_SIZE)
+#define DS3231_PROTO_MAX_OPS 16        // Operations per batch
+#define DS3231_PROTO_REPLY 0x80        // Set in the command id of a reply
+
+// Command ids
+#define DS3231_PROTO_CMD_PING 0x01     // Reply payload: version
+#define DS3231_PROTO_CMD_BATCH 0x02    // Payload: operations, reply payload: one result per operation
+#define DS3231_PROTO_CMD_NAK 0x7F      // Reply only, payload: ds3231_proto_nak_t
+
+/**
+ * @brief Operations of a batch. A result is the operation id, a status byte and the fixed-width
+ * data of the operation, zero filled when the status is not DS3231_PROTO_OK. Multi-byte fields are little endian.
+ */
+typedef enum
+{
+  DS3231_PROTO_OP_TIME = 0x01,      // Result: int64 seconds since 1970-01-01 00:00:00 UTC, from the time registers
+  DS3231_PROTO_OP_TIME_REGS = 0x02, // Result: the 7 BCD time registers
+  DS3231_PROTO_OP_TIME_US = 0x03,   // Result: int64 microseconds since the epoch, from the snapshot, no bus access
+  DS3231_PROTO_OP_TEMP = 0x04,      // Result: int16 temperature in 1/4 degrees Celsius, cached
+  DS3231_PROTO_OP_STATUS = 0x05,    // Result: status register
+  DS3231_PROTO_OP_SET_TIME = 0x10,  // Argument: int64 seconds since the epoch, result: nothing
+  DS3231_PROTO_OP_CLEAR_OSF = 0x11, // Result: nothing
+} ds3231_proto_op_t;
+
+typedef enum
+{
+  DS3231_PROTO_OK = 0,
+  DS3231_PROTO_ERR_FAIL = 1,
+  DS3231_PROTO_ERR_TIMEOUT = 2,
+  DS3231_PROTO_ERR_INVALID_STATE = 3,
+  DS3231_PROTO_ERR_INVALID_ARG = 4,
+  DS3231_PROTO_ERR_UNKNOWN_OP = 5,
+} ds3231_proto_status_t;
+
+typedef enum
+{
+  DS3231_PROTO_NAK_CRC = 1,         // Frame damaged, nothing was executed
+  DS3231_PROTO_NAK_COMMAND = 2,     // Unknown command id
+  DS3231_PROTO_NAK_MALFORMED = 3,   // Truncated operation or too many operations
+} ds3231_proto_nak_t;
+
+typedef enum
+{
+  DS3231_PROTO_NOT_FRAME, // The byte does not belong to a frame, hand it to the text console
+  DS3231_PROTO_PENDING,   // The byte was taken, the frame is not complete yet
+  DS3231_PROTO_FRAME,     // A complete frame is in the parser
+} ds3231_proto_feed_t;
+
+/**
+ * @brief Byte-wise frame parser, one per stream.
+ */
+typedef struct
+{
+  uint16_t pos;    // Bytes of the current frame received, 0 - waiting for DS3231_PROTO_SYNC
+  uint8_t frame[DS3231_PROTO_MAX_FRAME];
+} ds3231_proto_parser_t;
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+ *
+ * @param data Data.
+ * @param size Size of data.
+ * @return CRC.
+ */
+uint16_t ds3231_proto_crc16(const uint8_t *data, size_t size);
+
+/**
+ * @brief Discard a partly received frame, e.g. after an inter-byte timeout.
+ *
+ * @param parser Parser.
+ */
+void ds3231_proto_reset(ds3231_proto_parser_t *parser);
+
+/**
+ * @brief Feed one received byte. Outside a frame only DS3231_PROTO_SYNC is taken. A length byte above
+ * DS3231_PROTO_MAX_PAYLOAD after it drops the SYNC as noise and is returned as DS3231_PROTO_NOT_FRAME.
+ *
+ * @param parser Parser.
+ * @param byte Received byte.
+ * @return What became of the byte, with DS3231_PROTO_FRAME call ds3231_proto_handle() before the next byte.
+ */
+ds3231_proto_feed_t ds3231_proto_feed(ds3231_proto_parser_t *parser, uint8_t byte);
+
+/**
+ * @brief Number of bytes the frame in progress still needs, so a reader can stop at its end.
+ *
+ * @param parser Parser.
+ * @return Missing bytes, 1 while the length byte has not been received yet.
+ */
+size_t ds3231_proto_missing(const ds3231_proto_parser_t *parser);
+
+/**
+ * @brief Check and execute the complete frame in the parser and build the reply frame, then wait for the next frame.
+ * The operations of a batch are executed in order, a failing operation does not stop the later ones.
+ *
+ * @param parser Parser holding a complete frame.
+ * @param [out] reply Reply frame.
+ * @param reply_size Size of reply, DS3231_PROTO_MAX_FRAME fits every reply.
+ * @return Length of the reply frame, 0 - reply does not fit.
+ */
+size_t ds3231_proto_handle(ds3231_proto_parser_t *parser, uint8_t *reply, size_t reply_size);
+
+/**
+ * @brief Build a frame.
+ *
+ * @param cmd Command id.
+ * @param seq Sequence number, replies echo the one of the request.
+ * @param payload Payload.
+ * @param payload_size Size of payload, up to DS3231_PROTO_MAX_PAYLOAD.
+ * @param [out] frame Frame.
+ * @param frame_size Size of frame.
+ * @return Length of the frame, 0 - invalid size.
+ */
+size_t ds3231_proto_encode(uint8_t cmd, uint8_t seq, const uint8_t *payload, size_t payload_size, uint8_t *frame,
+                           size_t frame_size);
@@ -0,0 +1,151 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_REGMAP_AGE_ALWAYS 0         // Re-read the register on every access
+#define DS3231_REGMAP_AGE_NEVER INT64_MAX  // The register only changes when we write it
+#define DS3231_REGMAP_TEMPERATURE_AGE_US (64LL * 1000000) // Automatic temperature conversion period
+#define DS3231_REGMAP_MERGE_GAP 2          // Clean registers bridged to merge two dirty runs
+
+typedef struct
+{
+  uint32_t read_transactions;
+  uint32_t write_transactions;
+  uint32_t bytes_read;
+  uint32_t bytes_written;
+} ds3231_regmap_stats_t;
+
+/**
+ * @brief Create the shadow copy of the register map (0x00 - 0x12). It is empty until the first access.
+ *
+ * Staleness rules: the time and status registers are re-read on every access, the temperature
+ * registers once per DS3231_REGMAP_TEMPERATURE_AGE_US, alarm, control and aging offset registers
+ * are only read once. The rules can be changed with ds3231_regmap_set_max_age().
+ *
+ * @return
+ * - ESP_OK Success.
+ * - ESP_FAIL Could not create the mutex.
+ */
+esp_err_t ds3231_regmap_init(void);
+
+/**
+ * @brief Refresh the whole shadow with one burst read and drop the pending writes.
+ *
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE ds3231_regmap_init() has not been called.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_regmap_refresh(void);
+
+/**
+ * @brief Read registers through the shadow. Only the stale registers are read from the chip,
+ * in one burst covering all of them. Pending writes are returned as written.
+ *
+ * @param reg First register.
+ * @param [out] values Register values.
+ * @param count Number of registers.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE ds3231_regmap_init() has not been called.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_regmap_read(uint8_t reg, uint8_t *values, size_t count);
+
+/**
+ * @brief Write registers into the shadow and mark them dirty. Nothing goes to the chip until
+ * ds3231_regmap_flush(). For the status register a 0 in OSF/A2F/A1F clears the flag,
+ * the other flags are left as they are on the chip.
+ *
+ * @param reg First register.
+ * @param values Register values.
+ * @param count Number of registers.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE ds3231_regmap_init() has not been called.
+ */
+esp_err_t ds3231_regmap_write(uint8_t reg, const uint8_t *values, size_t count);
+
+/**
+ * @brief Read-modify-write of the bits selected by mask, the read goes through the shadow.
+ *
+ * @param reg Register.
+ * @param mask Bits to change.
+ * @param value New value of the bits.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE ds3231_regmap_init() has not been called.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_regmap_update_bits(uint8_t reg, uint8_t mask, uint8_t value);
+
+/**
+ * @brief Write the dirty registers. Contiguous dirty runs go out in one transaction each, runs
+ * separated by at most DS3231_REGMAP_MERGE_GAP clean non-volatile registers are merged.
+ *
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE ds3231_regmap_init() has not been called.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_regmap_flush(void);
+
+/**
+ * @brief Change the staleness rule of a register.
+ *
+ * @param reg Register.
+ * @param max_age_us Age after which the shadow is re-read, DS3231_REGMAP_AGE_ALWAYS or DS3231_REGMAP_AGE_NEVER.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE ds3231_regmap_init() has not been called.
+ */
+esp_err_t ds3231_regmap_set_max_age(uint8_t reg, int64_t max_age_us);
+
+/**
+ * @brief Drop the shadow of a register range, e.g. after it was written around the shadow.
+ *
+ * @param reg First register.
+ * @param count Number of registers.
+ */
+void ds3231_regmap_invalidate(uint8_t reg, size_t count);
+
+/**
+ * @brief Get a copy of the bus traffic counters, all 0 before ds3231_regmap_init().
+ *
+ * @param [out] stats Counters.
+ */
+void ds3231_regmap_get_stats(ds3231_regmap_stats_t *stats);
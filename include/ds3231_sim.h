@@ -0,0 +1,211 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#include <stdbool.h>
+
+#define DS3231_SIM_CONTROL_DEFAULT 0x1C // EOSC = 0, INTCN = 1, RS2 = RS1 = 1
+#define DS3231_SIM_STATUS_DEFAULT 0x88  // OSF = 1, EN32kHz = 1
+#define DS3231_SIM_BUS_MAX_CHIPS 32     // Models behind one multiplexer
+
+/**
+ * @brief Software model of a DS3231.
+ *
+ * The model keeps the whole register file (0x00 - 0x12), advances the BCD time registers
+ * from esp_timer, sets the alarm flags, honours the read-only/clear-only bits of the
+ * status register and charges every transaction the time it would take on the wire.
+ * The model is not thread safe, callers serialise it with the driver's bus lock.
+ */
+typedef struct
+{
+  uint8_t address;                          // 7-bit device address the model answers to
+  uint8_t registers[DS3231_REGISTER_COUNT]; // Register file
+  uint8_t pointer;                          // Register pointer, auto-incremented after every byte
+  uint32_t bus_freq_hz;                     // Simulated SCL frequency
+  uint32_t byte_time_ns;                    // Time of one byte + ACK on the wire (9 SCL periods)
+  int64_t next_tick_us;                     // Monotonic time of the next seconds increment
+  uint32_t transactions;                    // Number of transactions served
+  void (*sqw_edge)(void);                   // Called on every falling edge of the 1 Hz SQW output, can be NULL
+  void (*int_edge)(void);                   // Called when an enabled alarm pulls INT low, can be NULL
+  uint32_t fault_nack;                      // Transactions left to be NACKed
+  bool fault_stuck;                         // SDA held low: every transaction times out until the bus is cleared
+  uint32_t fault_delay_us;                  // Extra response time of every transaction
+  uint32_t recoveries;                      // Bus clear procedures seen
+  float drift_ppm;                          // Frequency error at 25 degrees with aging offset 0, positive - fast
+  float temp_coeff_ppm;                     // Frequency change per degree away from 25 degrees
+  uint32_t tick_frac_ns;                    // Part of the next second below the microsecond
+} ds3231_sim_t;
+
+/**
+ * @brief Several models on one simulated bus, each answering to its own address. Real DS3231s all use
+ * DS3231_ADDRESS, the addresses stand in for the channels of an I2C multiplexer in front of them.
+ * Transactions to an address no model answers to are NACKed.
+ */
+typedef struct
+{
+  ds3231_sim_t *chips[DS3231_SIM_BUS_MAX_CHIPS];
+  size_t count;
+} ds3231_sim_bus_t;
+
+/**
+ * @brief Initialise the model to the power-on state: 2000-01-01 00:00:00, OSF set.
+ *
+ * @param [out] sim Model to initialise.
+ * @param bus_freq_hz Simulated I2C clock (100000 or 400000 typically), 0 disables the bus latency.
+ */
+void ds3231_sim_init(ds3231_sim_t *sim, uint32_t bus_freq_hz);
+
+/**
+ * @brief Change the simulated I2C clock. The per-byte latency is 9 / bus_freq_hz.
+ *
+ * @param sim Model.
+ * @param bus_freq_hz New clock, 0 disables the bus latency.
+ */
+void ds3231_sim_set_bus_freq(ds3231_sim_t *sim, uint32_t bus_freq_hz);
+
+/**
+ * @brief Fill a bus backend which routes the driver's transactions to the model.
+ *
+ * @param sim Model.
+ * @param [out] backend Backend to fill.
+ */
+void ds3231_sim_get_backend(ds3231_sim_t *sim, ds3231_bus_backend_t *backend);
+
+/**
+ * @brief NACK the next transactions, as a glitch on the address byte would.
+ *
+ * @param sim Model.
+ * @param count Number of transactions to NACK.
+ */
+void ds3231_sim_inject_nack(ds3231_sim_t *sim, uint32_t count);
+
+/**
+ * @brief Hold SDA low like a slave interrupted in the middle of a read. Every transaction waits for its
+ * whole timeout and fails with ESP_ERR_TIMEOUT until the backend's recover (bus clear) runs.
+ *
+ * @param sim Model.
+ * @param stuck true - hold SDA low, false - release it.
+ */
+void ds3231_sim_inject_stuck(ds3231_sim_t *sim, bool stuck);
+
+/**
+ * @brief Slow the model down. A transaction whose delay exceeds its timeout fails with ESP_ERR_TIMEOUT
+ * after the timeout.
+ *
+ * @param sim Model.
+ * @param delay_us Extra response time of every transaction, 0 - none.
+ */
+void ds3231_sim_set_response_delay(ds3231_sim_t *sim, uint32_t delay_us);
+
+/**
+ * @brief Bring the time registers up to date with the monotonic clock.
+ * Calls sim->sqw_edge for every second when INT/SQW is configured as a 1 Hz square wave,
+ * so a task calling this periodically stands in for the SQW interrupt.
+ *
+ * @param sim Model.
+ */
+void ds3231_sim_tick(ds3231_sim_t *sim);
+
+/**
+ * @brief Set the value the model reports in the temperature registers.
+ *
+ * @param sim Model.
+ * @param temp Temperature, degrees Celsius, rounded down to 0.25 degree.
+ */
+void ds3231_sim_set_temperature(ds3231_sim_t *sim, float temp);
+
+/**
+ * @brief Let the model's seconds run at the wrong rate: drift_ppm + temp_coeff_ppm * (T - 25) - 0.1 * aging offset,
+ * T being the temperature set with ds3231_sim_set_temperature(). Unlike the chip, which takes a new aging
+ * offset over with the next temperature conversion, the model uses it immediately.
+ *
+ * @param sim Model.
+ * @param drift_ppm Frequency error at 25 degrees with aging offset 0, positive - the time runs fast.
+ * @param temp_coeff_ppm Frequency change per degree.
+ */
+void ds3231_sim_set_drift(ds3231_sim_t *sim, float drift_ppm, float temp_coeff_ppm);
+
+/**
+ * @brief Simulate a power loss: clears the time and sets OSF.
+ *
+ * @param sim Model.
+ */
+void ds3231_sim_power_loss(ds3231_sim_t *sim);
+
+/**
+ * @brief Time a transaction of the given size occupies the bus, in nanoseconds.
+ *
+ * @param sim Model.
+ * @param bytes Bytes transferred including the address bytes.
+ * @param starts Number of START/repeated START conditions.
+ * @return Transfer time in nanoseconds.
+ */
+uint32_t ds3231_sim_transfer_time_ns(const ds3231_sim_t *sim, size_t bytes, size_t starts);
+
+/**
+ * @brief Set the time registers as if they were written at epoch_us: the next seconds increment comes
+ * when the fraction of the second is over, so models set from one clock at different moments keep the
+ * same phase.
+ *
+ * @param sim Model.
+ * @param epoch_us Microseconds since 1970-01-01 00:00:00 UTC, within the range of the RTC.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG epoch_us is out of the range of the RTC.
+ */
+esp_err_t ds3231_sim_set_time(ds3231_sim_t *sim, int64_t epoch_us);
+
+/**
+ * @brief Initialise an empty multiplexer.
+ *
+ * @param [out] bus Multiplexer.
+ */
+void ds3231_sim_bus_init(ds3231_sim_bus_t *bus);
+
+/**
+ * @brief Put a model behind the multiplexer.
+ *
+ * @param bus Multiplexer.
+ * @param sim Model, it has to stay valid while the bus is used.
+ * @param address Address the model answers to from now on.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG address is above 0x7F or taken by another model.
+ * - ESP_ERR_NO_MEM DS3231_SIM_BUS_MAX_CHIPS models are attached already.
+ */
+esp_err_t ds3231_sim_bus_attach(ds3231_sim_bus_t *bus, ds3231_sim_t *sim, uint8_t address);
+
+/**
+ * @brief Fill a bus backend which routes every transaction to the model with the device address.
+ * The bus recovery reaches all models.
+ *
+ * @param bus Multiplexer.
+ * @param [out] backend Backend to fill.
+ */
+void ds3231_sim_bus_get_backend(ds3231_sim_bus_t *bus, ds3231_bus_backend_t *backend);
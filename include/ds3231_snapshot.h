@@ -0,0 +1,108 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#include <stdatomic.h>
+
+#define DS3231_SNAPSHOT_PERIOD_MS 100 // Default publishing period of the updater task
+#define DS3231_SNAPSHOT_STACK_SIZE 2560
+
+/**
+ * @brief Current time as published by the updater task.
+ */
+typedef struct
+{
+  int64_t epoch_us;     // Microseconds since 1970-01-01 00:00:00 UTC at mono_us
+  int64_t mono_us;      // esp_timer time of epoch_us, the time now is epoch_us + (esp_timer_get_time() - mono_us)
+  int64_t last_sync_us; // esp_timer time of the last read of the time registers
+  bool osf;             // Oscillator Stop Flag at the last sync
+} ds3231_snapshot_t;
+
+/**
+ * @brief Sequence lock around a snapshot. Writers are serialised by a spinlock, readers take no lock:
+ * they copy the data and retry when the sequence number was odd or changed meanwhile.
+ */
+typedef struct
+{
+  atomic_uint seq; // Odd while a write is in progress, 0 - never written
+  portMUX_TYPE writer;
+  ds3231_snapshot_t data;
+} ds3231_snapshot_cell_t;
+
+#define DS3231_SNAPSHOT_CELL_INIT() {.seq = 0, .writer = portMUX_INITIALIZER_UNLOCKED}
+
+/**
+ * @brief Publish a snapshot into a cell.
+ *
+ * @param cell Cell.
+ * @param snapshot Snapshot to publish.
+ */
+void ds3231_snapshot_store(ds3231_snapshot_cell_t *cell, const ds3231_snapshot_t *snapshot);
+
+/**
+ * @brief Read a consistent copy of a cell without locking, callable from any task on either core.
+ *
+ * @param cell Cell.
+ * @param [out] snapshot Copy.
+ * @return true - success, false - nothing was published yet.
+ */
+bool ds3231_snapshot_load(ds3231_snapshot_cell_t *cell, ds3231_snapshot_t *snapshot);
+
+/**
+ * @brief Start the updater task, which publishes the time from the time service (ds3231_time_service.h)
+ * and the OSF bit into the global snapshot. The time service decides when the bus is used.
+ *
+ * @param period_ms Publishing period, 0 - DS3231_SNAPSHOT_PERIOD_MS.
+ * @param priority Priority of the updater task.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE Already started.
+ * - ESP_ERR_NO_MEM Could not create the task.
+ */
+esp_err_t ds3231_snapshot_start(uint32_t period_ms, UBaseType_t priority);
+
+/**
+ * @brief Read the global snapshot, lock free and without bus access.
+ *
+ * @param [out] snapshot Copy.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE Nothing was published yet.
+ */
+esp_err_t ds3231_snapshot_get(ds3231_snapshot_t *snapshot);
+
+/**
+ * @brief Current time from the global snapshot, lock free and without bus access.
+ *
+ * @param [out] epoch_us Microseconds since 1970-01-01 00:00:00 UTC.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE Nothing was published yet.
+ */
+esp_err_t ds3231_snapshot_get_time_us(int64_t *epoch_us);
@@ -0,0 +1,116 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+#include "driver/gpio.h"
+
+#define DS3231_SQW_MAX_WAITERS 8          // Tasks which can wait for the next tick at the same time
+#define DS3231_SQW_VERIFY_STACK_SIZE 2560
+
+typedef struct
+{
+  uint32_t edges;        // SQW edges seen
+  uint32_t verifications;
+  uint32_t corrections;  // Verifications which found the counted time off
+} ds3231_sqw_stats_t;
+
+/**
+ * @brief Switch the INT/SQW pin to a 1 Hz square wave and keep the time by counting its falling
+ * edges. The time registers are read once, right after an edge, and then only on verification.
+ *
+ * @param sqw_io GPIO connected to INT/SQW (open drain, the internal pull-up is enabled).
+ * GPIO_NUM_NC: no GPIO interrupt, the edges come from ds3231_sqw_inject_edge(), e.g. from the simulator.
+ * @param verify_interval_s Period of the verification against the time registers, 0 - no verification.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE Already running.
+ * - ESP_ERR_TIMEOUT No edge within 2 seconds.
+ * - ESP_ERR_NO_MEM Could not create the semaphore or the verification task.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ */
+esp_err_t ds3231_sqw_start(gpio_num_t sqw_io, uint32_t verify_interval_s);
+
+/**
+ * @brief Get the counted time.
+ *
+ * @param [out] epoch Seconds since 1970-01-01 00:00:00 UTC.
+ * @param [out] edge_us esp_timer time of the edge which started this second, can be NULL.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE ds3231_sqw_start() has not succeeded.
+ */
+esp_err_t ds3231_sqw_get_time(int64_t *epoch, int64_t *edge_us);
+
+/**
+ * @brief Get the counted time with the sub-second part taken from esp_timer.
+ *
+ * @param [out] epoch_us Microseconds since 1970-01-01 00:00:00 UTC.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE ds3231_sqw_start() has not succeeded.
+ */
+esp_err_t ds3231_sqw_get_time_us(int64_t *epoch_us);
+
+/**
+ * @brief Block until the next second boundary of the RTC, for work which has to be aligned to it.
+ * Every waiter blocks on its own semaphore, the task notifications of the caller are not used.
+ *
+ * @param ticks_to_wait Timeout.
+ * @param [out] epoch The second which just started, can be NULL.
+ * @param [out] edge_us esp_timer time of the edge, can be NULL.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE ds3231_sqw_start() has not succeeded.
+ * - ESP_ERR_NO_MEM DS3231_SQW_MAX_WAITERS tasks are already waiting.
+ * - ESP_ERR_TIMEOUT No edge in time.
+ */
+esp_err_t ds3231_sqw_wait_tick(TickType_t ticks_to_wait, int64_t *epoch, int64_t *edge_us);
+
+/**
+ * @brief Compare the counted time with the time registers and correct it.
+ * Waits for the next edge, so the registers are read well inside the second.
+ *
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE ds3231_sqw_start() has not succeeded.
+ * - ESP_ERR_TIMEOUT No edge within 2 seconds.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ */
+esp_err_t ds3231_sqw_verify(void);
+
+/**
+ * @brief Feed one falling edge from task context, e.g. from the simulator. The GPIO ISR has its own path.
+ */
+void ds3231_sqw_inject_edge(void);
+
+/**
+ * @brief Get a copy of the counters.
+ *
+ * @param [out] stats Counters.
+ */
+void ds3231_sqw_get_stats(ds3231_sqw_stats_t *stats);
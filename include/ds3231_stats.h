@@ -0,0 +1,131 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#if DS3231_STATS_ENABLE
+#if CONFIG_FREERTOS_UNICORE
+#include "hal/cpu_hal.h"
+#else
+#include <esp_timer.h>
+#endif
+#endif
+
+#define DS3231_STATS_BUCKETS 20 // Bucket i counts durations in [2^(i-1), 2^i) us, the last one everything above
+
+typedef enum
+{
+  DS3231_STATS_OP_READ,
+  DS3231_STATS_OP_WRITE,
+  DS3231_STATS_OP_COUNT
+} ds3231_stats_op_t;
+
+typedef enum
+{
+  DS3231_STATS_ERR_OK,
+  DS3231_STATS_ERR_FAIL,          // NACK
+  DS3231_STATS_ERR_TIMEOUT,       // Bus busy or lock timeout
+  DS3231_STATS_ERR_INVALID_STATE,
+  DS3231_STATS_ERR_INVALID_ARG,
+  DS3231_STATS_ERR_OTHER,
+  DS3231_STATS_ERR_COUNT
+} ds3231_stats_err_t;
+
+typedef struct
+{
+  uint32_t lock_wait[DS3231_STATS_OP_COUNT][DS3231_STATS_BUCKETS]; // Histogram of the bus lock wait
+  uint32_t bus_time[DS3231_STATS_OP_COUNT][DS3231_STATS_BUCKETS];  // Histogram of the transfer itself
+  uint32_t registers[DS3231_STATS_OP_COUNT][DS3231_REGISTER_COUNT]; // Transactions by first register
+  uint32_t errors[DS3231_STATS_OP_COUNT][DS3231_STATS_ERR_COUNT];   // Transactions by result
+  uint32_t lock_timeouts[DS3231_STATS_OP_COUNT];                    // Transactions which never got the bus lock
+  uint32_t max_lock_wait_us[DS3231_STATS_OP_COUNT];
+  uint32_t max_bus_time_us[DS3231_STATS_OP_COUNT];
+} ds3231_stats_t;
+
+#if DS3231_STATS_ENABLE
+
+/*
+ * Timestamps are CPU cycles on a single core build. With both cores the task can move to the
+ * other core while it is blocked on the lock or the transfer, and the cycle counters of the
+ * two cores are unrelated, so esp_timer is used instead.
+ */
+#if CONFIG_FREERTOS_UNICORE
+#define DS3231_STATS_TIMESTAMP() cpu_hal_get_cycle_count()
+#define DS3231_STATS_ELAPSED_US(start, end) ((uint32_t)((end) - (start)) / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ)
+#else
+#define DS3231_STATS_TIMESTAMP() ((uint32_t)esp_timer_get_time())
+#define DS3231_STATS_ELAPSED_US(start, end) ((uint32_t)((end) - (start)))
+#endif
+
+/**
+ * @brief Count one transaction. Lock free, callable from any task.
+ *
+ * @param op Direction.
+ * @param reg First register.
+ * @param lock_wait_us Time spent waiting for the bus lock.
+ * @param bus_time_us Time of the transfer, ignored when the lock timed out.
+ * @param lock_timeout The bus lock was not obtained, the transfer did not happen.
+ * @param result Result of the transaction.
+ */
+void ds3231_stats_record(ds3231_stats_op_t op, uint8_t reg, uint32_t lock_wait_us, uint32_t bus_time_us,
+                         bool lock_timeout, esp_err_t result);
+
+#else
+
+// Nothing is left after optimisation, the arguments are only evaluated to avoid unused variable warnings
+#define DS3231_STATS_TIMESTAMP() 0U
+#define DS3231_STATS_ELAPSED_US(start, end) ((void)(start), (void)(end), 0U)
+#define ds3231_stats_record(op, reg, lock_wait_us, bus_time_us, lock_timeout, result) \
+  ((void)(lock_wait_us), (void)(bus_time_us))
+
+#endif
+
+/**
+ * @brief Get a copy of the counters. The copy is not atomic as a whole, counters updated
+ * meanwhile may be off by the transactions in flight.
+ *
+ * @param [out] stats Counters, all zero when DS3231_STATS_ENABLE is 0.
+ */
+void ds3231_stats_get(ds3231_stats_t *stats);
+
+/**
+ * @brief Zero all counters.
+ */
+void ds3231_stats_reset(void);
+
+/**
+ * @brief Print a summary of the counters to stdout.
+ */
+void ds3231_stats_print(void);
+
+/**
+ * @brief Write all counters as CSV rows "section,op,key,value".
+ *
+ * @param out Destination stream, e.g. stdout.
+ */
+void ds3231_stats_write_csv(FILE *out);
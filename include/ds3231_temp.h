@@ -0,0 +1,130 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_TEMP_CONVERSION_PERIOD_MS 64000 // Automatic conversion period of the chip
+#define DS3231_TEMP_CONVERSION_TIMEOUT_MS 500  // Upper bound of a forced conversion (typically 125 ms)
+// Default max_age_ms, a cached automatic conversion is then at most 1.5 conversion periods old
+#define DS3231_TEMP_MAX_AGE_MS (DS3231_TEMP_CONVERSION_PERIOD_MS / 2)
+#define DS3231_TEMP_HISTORY_SIZE 64            // Samples kept for the statistics
+#define DS3231_TEMP_EWMA_ALPHA 0.125f          // Default weight of a new sample in the EWMA
+
+typedef struct
+{
+  uint32_t max_age_ms;    // A sample is served from the cache for this long after its read, DS3231_TEMP_MAX_AGE_MS by default
+  bool force_conversion;  // Start a conversion (CONV) for every new sample instead of taking the last automatic one
+  float ewma_alpha;       // Weight of a new sample in the EWMA, (0, 1]
+} ds3231_temp_config_t;
+
+typedef struct
+{
+  int16_t quarters;       // Temperature in 0.25 degree Celsius steps
+  int64_t read_us;        // esp_timer time of the read, an automatic conversion can be a conversion period older
+} ds3231_temp_sample_t;
+
+typedef struct
+{
+  uint32_t count;         // Samples in the history
+  float last;
+  float min;
+  float max;
+  float mean;
+  float ewma;
+} ds3231_temp_history_t;
+
+typedef struct
+{
+  uint32_t hits;          // Queries served from the cache
+  uint32_t reads;         // Queries which read the temperature registers
+  uint32_t conversions;   // Forced conversions
+  uint32_t errors;
+} ds3231_temp_stats_t;
+
+/**
+ * @brief Configure the temperature service. The registers are read on the first query.
+ *
+ * @param config Configuration, NULL selects the defaults above.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_NO_MEM Could not create the mutex.
+ */
+esp_err_t ds3231_temp_init(const ds3231_temp_config_t *config);
+
+/**
+ * @brief Get the temperature. The bus is only used when the cached sample was read more than max_age_ms ago,
+ * every new sample goes into the history. Without force_conversion the register holds the last automatic
+ * conversion, which is up to DS3231_TEMP_CONVERSION_PERIOD_MS older than the read, so the value returned can be
+ * max_age_ms + DS3231_TEMP_CONVERSION_PERIOD_MS old (96 s by default). With force_conversion it is at most
+ * max_age_ms old.
+ *
+ * @param [out] temp Temperature, degrees Celsius.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE ds3231_temp_init() has not succeeded.
+ * - ESP_ERR_TIMEOUT The forced conversion did not finish in time.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ */
+esp_err_t ds3231_temp_get(float *temp);
+
+/**
+ * @brief Force a conversion now: wait for BSY to clear, set CONV, wait for CONV to clear and read the result.
+ *
+ * @param [out] temp Temperature, degrees Celsius, can be NULL.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_STATE ds3231_temp_init() has not succeeded.
+ * - ESP_ERR_TIMEOUT The conversion did not finish in DS3231_TEMP_CONVERSION_TIMEOUT_MS.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ */
+esp_err_t ds3231_temp_convert(float *temp);
+
+/**
+ * @brief Get min, max, mean of the samples in the history and the EWMA of all samples.
+ *
+ * @param [out] history Statistics, count is 0 while there are no samples.
+ */
+void ds3231_temp_get_history(ds3231_temp_history_t *history);
+
+/**
+ * @brief Copy the newest samples of the history, oldest first.
+ *
+ * @param [out] samples Destination.
+ * @param max_count Size of samples.
+ * @return Number of samples copied.
+ */
+size_t ds3231_temp_get_samples(ds3231_temp_sample_t *samples, size_t max_count);
+
+/**
+ * @brief Get a copy of the cache counters.
+ *
+ * @param [out] stats Counters.
+ */
+void ds3231_temp_get_stats(ds3231_temp_stats_t *stats);
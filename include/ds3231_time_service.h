@@ -0,0 +1,111 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_TS_RESYNC_INTERVAL_MS 60000     // Default resync period
+#define DS3231_TS_MIN_RESYNC_INTERVAL_MS 1000  // Lower bound when drift is detected
+#define DS3231_TS_DRIFT_THRESHOLD_MS 50        // Deviation at resync which counts as drift
+
+typedef struct
+{
+  uint32_t resync_interval_ms;     // Period of the regular resync from the RTC
+  uint32_t min_resync_interval_ms; // The interval is halved down to this value while drift is detected
+  uint32_t drift_threshold_ms;     // Deviation of the extrapolated time from the RTC which counts as drift
+} ds3231_ts_config_t;
+
+typedef struct
+{
+  uint32_t hits;         // Queries served from the cache
+  uint32_t resyncs;      // Queries which read the RTC
+  uint32_t drift_events; // Resyncs which found the extrapolated time off by more than the threshold
+  uint32_t errors;       // Failed resyncs
+} ds3231_ts_stats_t;
+
+/**
+ * @brief Configure the time service. The RTC is read on the first query.
+ *
+ * @param config Configuration, NULL selects the defaults above.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ */
+esp_err_t ds3231_ts_init(const ds3231_ts_config_t *config);
+
+/**
+ * @brief Get the current time. The time registers are read only when the cache is empty or the
+ * resync interval is over, otherwise the time is extrapolated from esp_timer.
+ *
+ * @param [out] epoch_us Microseconds since 1970-01-01 00:00:00.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_ts_get_time(int64_t *epoch_us);
+
+/**
+ * @brief Start the time line at a known time without reading the RTC, e.g. restored after deep sleep
+ * (ds3231_warm.h). Queries are extrapolated from it until the first resync.
+ *
+ * @param epoch_us Microseconds since 1970-01-01 00:00:00 now.
+ * @param valid_ms Time until the first resync.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG valid_ms is 0.
+ */
+esp_err_t ds3231_ts_seed(int64_t epoch_us, uint32_t valid_ms);
+
+/**
+ * @brief Resync from the RTC now, whatever the interval says.
+ *
+ * @param [out] epoch_us Microseconds since 1970-01-01 00:00:00 UTC.
+ * @param [out] deviation_us Optional, how far the time line was outside the second the RTC showed and
+ * has been moved, 0 - inside it or there was no time line yet.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_ts_resync(int64_t *epoch_us, int64_t *deviation_us);
+
+/**
+ * @brief Force a resync on the next query, e.g. after ds3231_set_date_time().
+ */
+void ds3231_ts_invalidate(void);
+
+/**
+ * @brief Get a copy of the cache counters.
+ *
+ * @param [out] stats Counters.
+ */
+void ds3231_ts_get_stats(ds3231_ts_stats_t *stats);
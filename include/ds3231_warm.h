@@ -0,0 +1,115 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_ds3231.h"
+
+#define DS3231_WARM_VERIFY_DELAY_MS 2000  // Deferred check of a restored time against the RTC
+#define DS3231_WARM_MAX_SLEEP_S 3600      // Longer sleeps boot cold, the ESP32 RTC slow clock is off by up to a few %
+#define DS3231_WARM_MAX_ERROR_MS 50       // Difference found by the check which counts as a correction
+#define DS3231_WARM_STACK_SIZE 2560
+
+typedef struct
+{
+  bool warm;                     // The time of this boot was restored from RTC memory
+  int64_t first_time_us;         // esp_timer time of the first valid timestamp of this boot, 0 - none yet
+  int64_t verified_us;           // esp_timer time the RTC confirmed a restored time, 0 - not (yet)
+  int64_t correction_us;         // How far the check moved the restored time
+  uint8_t osf;                   // Oscillator Stop Flag, as known from the last read
+  uint8_t status;                // Status register, as known from the last read
+  uint32_t cold_boots;           // Since power-on
+  uint32_t warm_boots;
+  uint32_t corrections;          // Warm boots whose time the check had to move by more than DS3231_WARM_MAX_ERROR_MS
+  int64_t cold_first_time_avg_us; // Mean first_time_us of the cold boots, 0 - none
+  int64_t warm_first_time_avg_us; // Mean first_time_us of the warm boots, 0 - none
+} ds3231_warm_stats_t;
+
+/**
+ * @brief Restore the time without bus access when the chip wakes from deep sleep with a state saved by
+ * ds3231_warm_save(): the saved RTC time plus the system time elapsed since then (kept by the ESP32
+ * across deep sleep) goes to settimeofday() and seeds the time service. Call it early in app_main,
+ * after ds3231_ts_init() and before anything asks for the time.
+ *
+ * @return true - warm boot, the time is set; false - cold boot, use ds3231_warm_cold_boot().
+ */
+bool ds3231_warm_restore(void);
+
+/**
+ * @brief Full start-up probe of a cold boot: reads the status register and the time, sets the system
+ * time and records the time of the first valid timestamp.
+ *
+ * @param [out] osf Oscillator Stop Flag, optional.
+ * @param [out] status Status register, optional.
+ * @return
+ * - ESP_OK Success.
+ * - Errors of ds3231_power_lost() and ds3231_ts_resync().
+ */
+esp_err_t ds3231_warm_cold_boot(uint8_t *osf, uint8_t *status);
+
+/**
+ * @brief After a warm boot, start a task which checks the restored time and the OSF bit against the
+ * RTC after DS3231_WARM_VERIFY_DELAY_MS, corrects the time if needed and ends. Nothing to do after a
+ * cold boot.
+ *
+ * @param priority Priority of the task, low: it is off the critical path.
+ * @return
+ * - ESP_OK Success, also after a cold boot.
+ * - ESP_ERR_INVALID_STATE Already started.
+ * - ESP_ERR_NO_MEM Could not create the task.
+ */
+esp_err_t ds3231_warm_verify_start(UBaseType_t priority);
+
+/**
+ * @brief Save the current time, the OSF bit and the status register for the next boot, right before
+ * esp_deep_sleep_start(). No bus access when the time service is in sync.
+ *
+ * @return
+ * - ESP_OK Success.
+ * - Errors of ds3231_ts_get_time().
+ * - ESP_FAIL The state file could not be written.
+ */
+esp_err_t ds3231_warm_save(void);
+
+/**
+ * @brief Update the OSF bit and the status register kept for the next boot, e.g. after OSF was cleared.
+ */
+void ds3231_warm_set_status(uint8_t osf, uint8_t status);
+
+/**
+ * @brief Get the boot counters and timings.
+ *
+ * @param [out] stats Counters.
+ */
+void ds3231_warm_get_stats(ds3231_warm_stats_t *stats);
+
+/**
+ * @brief Keep the state in a file instead of RTC slow memory, for a host build: a valid file counts as
+ * a deep sleep wake. Call it before ds3231_warm_restore().
+ *
+ * @param path File path, NULL - back to RTC memory.
+ */
+void ds3231_warm_set_state_file(const char *path);
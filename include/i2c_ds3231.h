@@ -33,6 +33,8 @@
 #include "driver/i2c.h"
 #include "sdkconfig.h"
 
+#include "ds3231_bus.h"
+
 #include "string.h"
 #include <stdio.h>
 #include "time.h"
@@ -45,17 +47,74 @@
 #define I2C_MASTER_TX_BUF_DISABLE 0   // I2C master doesn't need buffer
 #define I2C_MASTER_RX_BUF_DISABLE 0   // I2C master doesn't need buffer
 
+#ifndef DS3231_USE_SIMULATOR
+#define DS3231_USE_SIMULATOR 0        // 1 - run against the simulated DS3231 (ds3231_sim.h) instead of the bus
+#endif
+#ifndef DS3231_USE_SQW
+#define DS3231_USE_SQW 0              // 1 - keep the time by counting the 1 Hz SQW edges (ds3231_sqw.h)
+#endif
+#define DS3231_SQW_IO GPIO_NUM_4      // GPIO connected to INT/SQW
+#define DS3231_SQW_VERIFY_S 3600      // Period of the SQW time verification against the time registers
+#ifndef DS3231_USE_CAL
+#define DS3231_USE_CAL 0              // 1 - estimate the drift and trim the aging offset (ds3231_cal.h)
+#endif
+#ifndef DS3231_USE_LOG
+#define DS3231_USE_LOG 0              // 1 - keep an event log on the rtclog partition (ds3231_log.h)
+#endif
+#ifndef DS3231_USE_WARM_BOOT
+#define DS3231_USE_WARM_BOOT 0        // 1 - restore the time from RTC memory after deep sleep (ds3231_warm.h)
+#endif
+#ifndef DS3231_STATS_ENABLE
+#define DS3231_STATS_ENABLE 1         // 0 - compile the transaction statistics (ds3231_stats.h) out
+#endif
+#ifndef DS3231_STATIC_ALLOCATION
+#define DS3231_STATIC_ALLOCATION 0    // 1 - mutexes, tasks, queues and command links of the driver never come from the heap
+#endif
+#define DS3231_CMD_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(3) // Command link of a register write: address, register, data
+
 #define DS3231_ADDRESS 0x68                 // DS3231RTC address
 #define DS3231_TIME_ADDRESS 0x00         // Address of Seconds Register of DS3231
+#define DS3231_ALARM1_ADDRESS 0x07          // Address of Alarm 1 Seconds Register of DS3231
+#define DS3231_ALARM2_ADDRESS 0x0B          // Address of Alarm 2 Minutes Register of DS3231
+#define DS3231_CONTROL_REGISTER_ADDRESS 0x0E // Address of Control Register of DS3231
 #define DS3231_STATUS_REGISTER_ADDRESS 0x0F // Address of Status Register of DS3231
+#define DS3231_AGING_OFFSET_ADDRESS 0x10    // Address of Aging Offset Register of DS3231
+#define DS3231_AGING_PPM_PER_LSB 0.1        // Frequency change of one aging offset step at 25 degrees, positive - slower
 #define DS3231_ADDRESS_TEMPERATURE 0x11     // Address of Temperature Register of DS3231
+#define DS3231_REGISTER_COUNT 0x13          // Registers 0x00 - 0x12
 
 #define DS3231_12HOUR_FLAG 0x40
 #define DS3231_12HOUR_MASK 0x1F
 #define DS3231_PM_FLAG 0x20
 #define DS3231_MONTH_MASK 0x1F
+#define DS3231_CENTURY_FLAG 0x80
+
+// Control register bits
+#define DS3231_CONTROL_EOSC 0x80
+#define DS3231_CONTROL_BBSQW 0x40
+#define DS3231_CONTROL_CONV 0x20
+#define DS3231_CONTROL_RS2 0x10
+#define DS3231_CONTROL_RS1 0x08
+#define DS3231_CONTROL_INTCN 0x04
+#define DS3231_CONTROL_A2IE 0x02
+#define DS3231_CONTROL_A1IE 0x01
+
+// Status register bits
+#define DS3231_STATUS_OSF 0x80
+#define DS3231_STATUS_EN32KHZ 0x08
+#define DS3231_STATUS_BSY 0x04
+#define DS3231_STATUS_A2F 0x02
+#define DS3231_STATUS_A1F 0x01
+
+#define I2CDEV_TIMEOUT 1000            // Upper bound of a transaction timeout, ms
+#define DS3231_TIMEOUT_MIN_MS 20       // Lower bound of the adaptive transaction timeout
+#define DS3231_TIMEOUT_FACTOR 8        // Timeout = factor * average transaction time + DS3231_TIMEOUT_MIN_MS
+#define DS3231_RETRY_COUNT 2           // Retries of a transaction which was NACKed or timed out
+#define DS3231_RETRY_BACKOFF_MS 10     // Delay before the first retry, doubled for every further one
+#define DS3231_READ_WINDOW_US 0        // Default freshness window of shared reads, see ds3231_dev_set_read_window()
+#define DS3231_READ_WINDOW_OFF -1      // Every read goes to the bus
 
-#define I2CDEV_TIMEOUT 1000
+#define DS3231_DATE_TIME_STR_SIZE 30 // Buffer size which fits every date_time_format
 
 typedef enum
 {
@@ -64,20 +123,66 @@ typedef enum
   ONLY_DATE,
   ONLY_TIME_24,
   ONLY_TIME_AM_PM,
-  UNIX_TIMESTAMPS
+  UNIX_TIMESTAMPS,
+  DATE_TIME_CUSTOM // First value handed out by ds3231_format_register()
 } date_time_format;
 
 static const char MAIN_TAG[] = "main";
 static const char DS3231_TAG[] = "ds3231";
 
-// Device mutex
-SemaphoreHandle_t mutex;
+/**
+ * @brief Set-up of one DS3231. Devices on the same port share the bus set-up and its lock.
+ */
+typedef struct
+{
+  i2c_port_t port;
+  uint8_t address;                     // 7-bit device address
+  gpio_num_t sda_io;
+  gpio_num_t scl_io;
+  uint32_t clk_speed;                  // I2C clock frequency
+  const ds3231_bus_backend_t *backend; // NULL - ESP-IDF I2C master driver on port
+} ds3231_dev_config_t;
+
+#define DS3231_DEV_CONFIG_DEFAULT() \
+  {                                 \
+    .port = I2C_MASTER_PORT,        \
+    .address = DS3231_ADDRESS,      \
+    .sda_io = I2C_MASTER_SDA_IO,    \
+    .scl_io = I2C_MASTER_SCL_IO,    \
+    .clk_speed = I2C_MASTER_FREQ_HZ,\
+    .backend = NULL                 \
+  }
+
+/**
+ * @brief Health of the bus a device is on.
+ */
+typedef struct
+{
+  uint32_t retries;             // Transactions repeated after a NACK or a timeout
+  uint32_t recoveries;          // Bus clear procedures run after a timeout
+  uint32_t recovery_failures;   // Bus clear procedures after which SDA was still low
+  uint32_t last_recovery_us;    // Duration of the last bus clear procedure
+  uint32_t avg_transfer_us;     // Moving average of successful transactions, 0 - nothing measured yet
+  uint32_t timeout_ms;          // Current transaction timeout
+  uint32_t coalesced_reads;     // Reads served from a transaction of another caller
+} ds3231_bus_health_t;
 
+/**
+ * @brief Device handle, filled by ds3231_dev_init().
+ */
+typedef struct
+{
+  i2c_port_t port;
+  uint8_t address;
+  gpio_num_t sda_io;
+  gpio_num_t scl_io;
+  uint32_t clk_speed;
+  const ds3231_bus_backend_t *backend; // Backend of the bus
+  SemaphoreHandle_t lock;              // Lock of the bus, transactions on different ports run in parallel
+} ds3231_dev_t;
 
-// OSF bit global value
-uint8_t osf_bit_value;
-// Control/Status register global value
-uint8_t status_reg_value;
+// Device used by the functions without a handle, set up by i2c_ds3231_init()
+extern ds3231_dev_t ds3231_default_dev;
 
 /**
  * @brief Configure the I2C environment and install driver.
@@ -91,7 +196,63 @@ uint8_t status_reg_value;
 esp_err_t i2c_ds3231_init(void);
 
 /**
- * @brief Read data from registers.
+ * @brief Set up a device handle. The first device of a port configures the bus and installs
+ * the I2C driver (or takes config->backend), later devices on the same port share it.
+ *
+ * @param [out] dev Device handle.
+ * @param config Device set-up, see DS3231_DEV_CONFIG_DEFAULT().
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE The port is already set up with different pins, clock or backend.
+ * - ESP_FAIL Driver installation error or could not create the bus mutex.
+ */
+esp_err_t ds3231_dev_init(ds3231_dev_t *dev, const ds3231_dev_config_t *config);
+
+/**
+ * @brief Get the retry and recovery counters and the adaptive timeout of the device's bus.
+ *
+ * @param dev Device handle.
+ * @param [out] health Counters.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE The device is not initialised.
+ */
+esp_err_t ds3231_dev_get_bus_health(ds3231_dev_t *dev, ds3231_bus_health_t *health);
+
+/**
+ * @brief Let concurrent reads share one transaction (single flight). A read which finds that the same
+ * registers of the same device were read by a transaction which completed after its own call started,
+ * minus window_us, gets those bytes instead of going to the bus. With 0 only callers which arrive
+ * while the transaction is in flight share it. Any write to the device drops the shared bytes.
+ * The setting applies to the whole bus of the device.
+ *
+ * @param dev Device handle.
+ * @param window_us Freshness window, DS3231_READ_WINDOW_OFF - no sharing.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_ERR_INVALID_STATE The device is not initialised.
+ */
+esp_err_t ds3231_dev_set_read_window(ds3231_dev_t *dev, int32_t window_us);
+
+/**
+ * @brief Initialise the driver on top of a custom bus backend, e.g. the simulated DS3231.
+ * The I2C peripheral is not touched.
+ *
+ * @param backend Bus backend, it has to stay valid while the driver is used.
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error.
+ * - ESP_FAIL Could not create the device mutex.
+ */
+esp_err_t i2c_ds3231_init_backend(const ds3231_bus_backend_t *backend);
+
+/**
+ * @brief Read data from registers. A NACK or a timeout is retried up to DS3231_RETRY_COUNT times with
+ * exponential backoff, a timeout first runs the bus clear procedure of the backend. The timeout adapts
+ * to the measured transaction time.
  *
  * @param address Address of start of reading data.
  * @param address_size Size of addresses for reading.
@@ -102,12 +263,17 @@ esp_err_t i2c_ds3231_init(void);
  * - ESP_ERR_INVALID_ARG Parameter error.
  * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
  * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
- * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy or the bus lock was not obtained.
  */
 esp_err_t ds3231_read_data(const uint8_t address, const size_t address_size, uint8_t *rx_buffer, size_t rx_buffer_size);
 
 /**
- * @brief Write data to registers.
+ * @brief Same as ds3231_read_data() on the given device.
+ */
+esp_err_t ds3231_dev_read_data(ds3231_dev_t *dev, const uint8_t address, const size_t address_size, uint8_t *rx_buffer, size_t rx_buffer_size);
+
+/**
+ * @brief Write data to registers. Retries and timeouts as ds3231_read_data().
  *
  * @param address Address of start of reading data.
  * @param address_size Size of addresses for reading.
@@ -118,10 +284,15 @@ esp_err_t ds3231_read_data(const uint8_t address, const size_t address_size, uin
  * - ESP_ERR_INVALID_ARG Parameter error.
  * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
  * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
- * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy or the bus lock was not obtained.
  */
 esp_err_t ds3231_write_data(const uint8_t address, const size_t address_size, uint8_t *tx_buffer, size_t tx_buffer_size);
 
+/**
+ * @brief Same as ds3231_write_data() on the given device.
+ */
+esp_err_t ds3231_dev_write_data(ds3231_dev_t *dev, const uint8_t address, const size_t address_size, uint8_t *tx_buffer, size_t tx_buffer_size);
+
 /**
  * @brief Check OSF (Oscillator Stop Flag) of status register. Check DS3231 documentation for details.
  *
@@ -136,6 +307,11 @@ esp_err_t ds3231_write_data(const uint8_t address, const size_t address_size, ui
  */
 esp_err_t ds3231_power_lost(uint8_t *status, uint8_t *status_register);
 
+/**
+ * @brief Same as ds3231_power_lost() on the given device.
+ */
+esp_err_t ds3231_dev_power_lost(ds3231_dev_t *dev, uint8_t *status, uint8_t *status_register);
+
 /**
  * @brief Convert a binary coded decimal value to decimal. RTC stores time/date values as BCD.
  *
@@ -153,13 +329,43 @@ uint8_t bcd2dec(uint8_t value);
 uint8_t dec2bcd(uint8_t value);
 
 /**
- * @brief Store date and time into string. The function does not execute the freeing memory.
+ * @brief Convert the 7 time registers (seconds to year) into a struct tm.
+ * 12 hour mode and the century bit are handled like in ds3231_regs_to_epoch().
+ *
+ * @param regs Raw register values starting at DS3231_TIME_ADDRESS.
+ * @param [out] time Broken-down time, tm_isdst is 0.
+ */
+void ds3231_regs_to_tm(const uint8_t *regs, struct tm *time);
+
+/**
+ * @brief Store date and time into a caller-owned buffer. The function does not allocate memory.
+ *
+ * @param [out] str_buffer Destination array where the resulting C string is copied.
+ * @param buffer_size Size of str_buffer, DS3231_DATE_TIME_STR_SIZE fits every format.
+ * @param dt_format The date and time format for printing, built-in or registered with ds3231_format_register().
+ * @return
+ * - ESP_OK Success.
+ * - ESP_ERR_INVALID_ARG Parameter error or str_buffer is too small.
+ * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
+ * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t ds3231_get_date_time_r(char *str_buffer, size_t buffer_size, date_time_format dt_format);
+
+/**
+ * @brief Same as ds3231_get_date_time_r() on the given device.
+ */
+esp_err_t ds3231_dev_get_date_time_r(ds3231_dev_t *dev, char *str_buffer, size_t buffer_size, date_time_format dt_format);
+
+/**
+ * @brief Store date and time into string. The function does not execute the freeing memory. On error *str_buffer is NULL.
  *
  * @param [out] str_buffer The pointer to the destination array where the resulting C string is copied.
  * @param dt_format The date and time format for printing.
  * @return
  * - ESP_OK Success.
  * - ESP_ERR_NO_MEM: If memory allocation is failed.
+ * - ESP_ERR_NOT_SUPPORTED Built with DS3231_STATIC_ALLOCATION, use ds3231_get_date_time_r().
  * - ESP_ERR_INVALID_ARG Parameter error.
  * - ESP_FAIL Sending command error, slave hasn't ACK the transfer.
  * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
@@ -167,10 +373,16 @@ uint8_t dec2bcd(uint8_t value);
  */
 esp_err_t ds3231_get_date_time(char **str_buffer, date_time_format dt_format);
 
+/**
+ * @brief Same as ds3231_get_date_time() on the given device.
+ */
+esp_err_t ds3231_dev_get_date_time(ds3231_dev_t *dev, char **str_buffer, date_time_format dt_format);
+
 /**
  * @brief Set new date and time into DS3231.
  *
- * @param str_buffer The pointer of new date and time string.
+ * @param date_time_str New date and time, "sec,min,hour,dow,date,month,year" or ISO 8601
+ * "YYYY-MM-DDTHH:MM:SS", see ds3231_parse_date_time(). The string is not modified.
  * @return
  * - ESP_OK Success.
  * - ESP_ERR_INVALID_ARG Parameter error.
@@ -178,7 +390,12 @@ esp_err_t ds3231_get_date_time(char **str_buffer, date_time_format dt_format);
  * - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
  * - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
  */
-esp_err_t ds3231_set_date_time(char *date_time_str);
+esp_err_t ds3231_set_date_time(const char *date_time_str);
+
+/**
+ * @brief Same as ds3231_set_date_time() on the given device.
+ */
+esp_err_t ds3231_dev_set_date_time(ds3231_dev_t *dev, const char *date_time_str);
 
 /**
  * @brief Get temperature
@@ -187,4 +404,9 @@ esp_err_t ds3231_set_date_time(char *date_time_str);
  * @return
  * - ESP_OK Success.
  */
-esp_err_t ds3231_get_temperature(float *temp);
\ No newline at end of file
+esp_err_t ds3231_get_temperature(float *temp);
+
+/**
+ * @brief Same as ds3231_get_temperature() on the given device.
+ */
+esp_err_t ds3231_dev_get_temperature(ds3231_dev_t *dev, float *temp);
\ No newline at end of file
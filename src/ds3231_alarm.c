@@ -0,0 +1,495 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_alarm.h"
+#include "ds3231_epoch.h"
+#include "ds3231_regmap.h"
+
+#include <stdlib.h>
+#include <esp_timer.h>
+
+#define ALARM_NONE -1
+#define ALARM_ID(index, generation) (((ds3231_alarm_id_t)(generation) << 16) | (index))
+#define ALARM_ID_INDEX(id) ((id) & 0xFFFF)
+#define ALARM_ID_GENERATION(id) ((id) >> 16)
+#define ALARM_FALLBACK_MARGIN_MS 1500 // Wake-up after the deadline in case the INT edge got lost
+
+typedef struct
+{
+  int64_t deadline;
+  uint32_t period_s;
+  ds3231_alarm_callback_t callback;
+  void *arg;
+  int32_t heap_index; // Position in alarm_heap, or the next free entry while unused
+  uint16_t generation;
+} alarm_entry_t;
+
+static SemaphoreHandle_t alarm_mutex;
+static TaskHandle_t alarm_task;
+static alarm_entry_t *alarm_entries;
+static uint16_t *alarm_heap; // Min-heap of entry indices ordered by deadline
+#if DS3231_STATIC_ALLOCATION
+static alarm_entry_t alarm_entries_buffer[DS3231_ALARM_STATIC_CAPACITY];
+static uint16_t alarm_heap_buffer[DS3231_ALARM_STATIC_CAPACITY];
+static StaticSemaphore_t alarm_mutex_buffer;
+static StaticTask_t alarm_tcb;
+static StackType_t alarm_stack[DS3231_ALARM_STACK_SIZE];
+#endif
+static uint16_t alarm_capacity;
+static uint16_t alarm_count;
+static int32_t alarm_free;
+static int64_t alarm_armed = INT64_MAX; // Deadline in the alarm registers
+
+// Guards the counters and alarm_irq_us, which the ISR writes
+static portMUX_TYPE alarm_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static ds3231_alarm_stats_t alarm_stats;
+static int64_t alarm_irq_us;
+
+static inline bool heap_less(uint16_t a, uint16_t b)
+{
+    return alarm_entries[alarm_heap[a]].deadline < alarm_entries[alarm_heap[b]].deadline;
+}
+
+static inline void heap_swap(uint16_t a, uint16_t b)
+{
+    uint16_t tmp = alarm_heap[a];
+
+    alarm_heap[a] = alarm_heap[b];
+    alarm_heap[b] = tmp;
+    alarm_entries[alarm_heap[a]].heap_index = a;
+    alarm_entries[alarm_heap[b]].heap_index = b;
+}
+
+static void heap_sift_up(uint16_t i)
+{
+    while (i > 0 && heap_less(i, (i - 1) / 2))
+    {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_sift_down(uint16_t i)
+{
+    while (1)
+    {
+        uint32_t smallest = i;
+        uint32_t left = 2 * (uint32_t)i + 1;
+        uint32_t right = left + 1;
+
+        if (left < alarm_count && heap_less(left, smallest))
+            smallest = left;
+        if (right < alarm_count && heap_less(right, smallest))
+            smallest = right;
+        if (smallest == i)
+            return;
+
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+static void heap_push(uint16_t entry)
+{
+    alarm_heap[alarm_count] = entry;
+    alarm_entries[entry].heap_index = alarm_count;
+    heap_sift_up(alarm_count++);
+}
+
+static void heap_remove(uint16_t i)
+{
+    alarm_entries[alarm_heap[i]].heap_index = ALARM_NONE;
+    if (i == --alarm_count)
+        return;
+
+    alarm_heap[i] = alarm_heap[alarm_count];
+    alarm_entries[alarm_heap[i]].heap_index = i;
+    heap_sift_down(i);
+    heap_sift_up(i);
+}
+
+static void entry_free(uint16_t entry)
+{
+    // A new generation makes the old handle stale, 0 is skipped so no handle is ALARM_ID_INVALID
+    if (++alarm_entries[entry].generation == 0)
+        alarm_entries[entry].generation = 1;
+    alarm_entries[entry].heap_index = alarm_free;
+    alarm_free = entry;
+}
+
+static void IRAM_ATTR alarm_isr_handler(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&alarm_stats_lock);
+    alarm_irq_us = now;
+    alarm_stats.interrupts++;
+    portEXIT_CRITICAL_ISR(&alarm_stats_lock);
+    // The handler is added before the dispatcher task exists
+    if (alarm_task != NULL)
+        vTaskNotifyGiveFromISR(alarm_task, &woken);
+    if (woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void ds3231_alarm_inject_interrupt(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&alarm_stats_lock);
+    alarm_irq_us = now;
+    alarm_stats.interrupts++;
+    portEXIT_CRITICAL(&alarm_stats_lock);
+    if (alarm_task != NULL)
+        xTaskNotifyGive(alarm_task);
+}
+
+// Program the earliest deadline into Alarm 1 (seconds resolution) or Alarm 2 (whole minutes)
+static esp_err_t alarm_program(int64_t deadline)
+{
+    uint8_t time[7];
+    uint8_t enable = 0;
+
+    if (deadline != INT64_MAX)
+    {
+        esp_err_t result = ds3231_epoch_to_regs(deadline, time);
+        if (result != ESP_OK)
+            return result;
+
+        // All mask bits 0: match seconds, minutes, hours and date, hours in 24-hour mode
+        if (time[0] == 0)
+        {
+            uint8_t alarm2[3] = {time[1], time[2], time[4]};
+            result = ds3231_regmap_write(DS3231_ALARM2_ADDRESS, alarm2, sizeof(alarm2));
+            enable = DS3231_CONTROL_A2IE;
+        }
+        else
+        {
+            uint8_t alarm1[4] = {time[0], time[1], time[2], time[4]};
+            result = ds3231_regmap_write(DS3231_ALARM1_ADDRESS, alarm1, sizeof(alarm1));
+            enable = DS3231_CONTROL_A1IE;
+        }
+        if (result != ESP_OK)
+            return result;
+    }
+
+    esp_err_t result = ds3231_regmap_update_bits(DS3231_CONTROL_REGISTER_ADDRESS,
+                                                 DS3231_CONTROL_INTCN | DS3231_CONTROL_A2IE | DS3231_CONTROL_A1IE,
+                                                 DS3231_CONTROL_INTCN | enable);
+    if (result == ESP_OK)
+        result = ds3231_regmap_flush();
+    if (result != ESP_OK)
+        return result;
+
+    alarm_armed = deadline;
+    portENTER_CRITICAL(&alarm_stats_lock);
+    alarm_stats.hw_programs++;
+    portEXIT_CRITICAL(&alarm_stats_lock);
+
+    return ESP_OK;
+}
+
+static void alarm_record_dispatch(int64_t irq_us)
+{
+    // Wake-ups by the fallback timeout or by ds3231_alarm_add() have no latency to report
+    uint32_t latency = irq_us > 0 ? (uint32_t)(esp_timer_get_time() - irq_us) : 0;
+
+    portENTER_CRITICAL(&alarm_stats_lock);
+    alarm_stats.dispatched++;
+    alarm_stats.total_latency_us += latency;
+    if (latency > alarm_stats.max_latency_us)
+        alarm_stats.max_latency_us = latency;
+    portEXIT_CRITICAL(&alarm_stats_lock);
+}
+
+// Run the expired alarms, re-arm the hardware and return how long to sleep
+static TickType_t alarm_dispatch(void)
+{
+    int64_t now;
+
+    portENTER_CRITICAL(&alarm_stats_lock);
+    int64_t irq_us = alarm_irq_us;
+    alarm_irq_us = 0;
+    portEXIT_CRITICAL(&alarm_stats_lock);
+
+    // Acknowledge the interrupt, INT stays low while A1F or A2F is set
+    esp_err_t result = ds3231_regmap_update_bits(DS3231_STATUS_REGISTER_ADDRESS,
+                                                 DS3231_STATUS_A2F | DS3231_STATUS_A1F, 0);
+    if (result == ESP_OK)
+        result = ds3231_regmap_flush();
+    if (result == ESP_OK)
+        result = ds3231_get_epoch(&now);
+    if (result != ESP_OK)
+    {
+        ESP_LOGW(DS3231_TAG, "Alarm dispatch failed: %s", esp_err_to_name(result));
+        return pdMS_TO_TICKS(ALARM_FALLBACK_MARGIN_MS);
+    }
+
+    while (1)
+    {
+        xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+        if (alarm_count == 0 || alarm_entries[alarm_heap[0]].deadline > now)
+            break;
+
+        uint16_t entry = alarm_heap[0];
+        alarm_entry_t *alarm = &alarm_entries[entry];
+        int64_t deadline = alarm->deadline;
+        ds3231_alarm_callback_t callback = alarm->callback;
+        void *arg = alarm->arg;
+
+        heap_remove(0);
+        if (alarm->period_s > 0)
+        {
+            // Missed periods are skipped, not replayed
+            do
+                alarm->deadline += alarm->period_s;
+            while (alarm->deadline <= now);
+            heap_push(entry);
+        }
+        else
+        {
+            entry_free(entry);
+        }
+        xSemaphoreGive(alarm_mutex);
+
+        alarm_record_dispatch(irq_us);
+        callback(deadline, arg);
+    }
+
+    int64_t next = alarm_count > 0 ? alarm_entries[alarm_heap[0]].deadline : INT64_MAX;
+    xSemaphoreGive(alarm_mutex);
+
+    if (next != alarm_armed)
+    {
+        result = alarm_program(next);
+        if (result != ESP_OK)
+            ESP_LOGW(DS3231_TAG, "Alarm programming failed: %s", esp_err_to_name(result));
+    }
+
+    if (next == INT64_MAX)
+        return portMAX_DELAY;
+
+    // The deadline may pass while the registers are written, then no edge comes for it
+    int64_t wait_s = next - now;
+    if (wait_s > 3600)
+        wait_s = 3600;
+
+    return pdMS_TO_TICKS(wait_s * 1000 + ALARM_FALLBACK_MARGIN_MS);
+}
+
+static void alarm_dispatcher_task(void *pvParameters)
+{
+    while (1)
+    {
+        TickType_t wait = alarm_dispatch();
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+// Undo a failed ds3231_alarm_init(), the dispatcher task is created last and never has to go
+static void alarm_release(gpio_num_t int_io, bool handler_added, bool service_installed)
+{
+    if (handler_added)
+        gpio_isr_handler_remove(int_io);
+    if (service_installed)
+        gpio_uninstall_isr_service();
+
+#if !DS3231_STATIC_ALLOCATION
+    free(alarm_entries);
+    free(alarm_heap);
+#endif
+    if (alarm_mutex != NULL)
+        vSemaphoreDelete(alarm_mutex);
+    alarm_entries = NULL;
+    alarm_heap = NULL;
+    alarm_mutex = NULL;
+    alarm_capacity = 0;
+}
+
+esp_err_t ds3231_alarm_init(gpio_num_t int_io, uint16_t capacity, UBaseType_t priority)
+{
+    bool handler_added = false;
+    bool service_installed = false;
+
+    if (capacity == 0)
+        return ESP_ERR_INVALID_ARG;
+    if (alarm_task != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+#if DS3231_STATIC_ALLOCATION
+    if (capacity > DS3231_ALARM_STATIC_CAPACITY)
+        return ESP_ERR_INVALID_ARG;
+#endif
+
+    // The alarm and control registers are written through the register map
+    esp_err_t result = ds3231_regmap_init();
+    if (result != ESP_OK)
+        return result;
+
+#if DS3231_STATIC_ALLOCATION
+    alarm_entries = alarm_entries_buffer;
+    alarm_heap = alarm_heap_buffer;
+    alarm_mutex = xSemaphoreCreateMutexStatic(&alarm_mutex_buffer);
+#else
+    alarm_entries = calloc(capacity, sizeof(alarm_entry_t));
+    alarm_heap = calloc(capacity, sizeof(uint16_t));
+    alarm_mutex = xSemaphoreCreateMutex();
+#endif
+    if (alarm_entries == NULL || alarm_heap == NULL || alarm_mutex == NULL)
+    {
+        alarm_release(int_io, false, false);
+        return ESP_ERR_NO_MEM;
+    }
+
+    alarm_capacity = capacity;
+    alarm_count = 0;
+    alarm_armed = INT64_MAX;
+    alarm_free = ALARM_NONE;
+    for (int32_t i = capacity - 1; i >= 0; i--)
+    {
+        alarm_entries[i].generation = 1;
+        alarm_entries[i].heap_index = alarm_free;
+        alarm_free = i;
+    }
+
+    if (int_io != GPIO_NUM_NC)
+    {
+        gpio_config_t conf = {
+            .pin_bit_mask = 1ULL << int_io,
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_ENABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_NEGEDGE};
+
+        result = gpio_config(&conf);
+        if (result == ESP_OK)
+        {
+            // Somebody else may have installed the ISR service already, then it stays
+            result = gpio_install_isr_service(0);
+            service_installed = result == ESP_OK;
+            if (result == ESP_ERR_INVALID_STATE)
+                result = ESP_OK;
+        }
+        if (result == ESP_OK)
+        {
+            result = gpio_isr_handler_add(int_io, alarm_isr_handler, NULL);
+            handler_added = result == ESP_OK;
+        }
+        if (result != ESP_OK)
+        {
+            alarm_release(int_io, handler_added, service_installed);
+            return result;
+        }
+    }
+
+#if DS3231_STATIC_ALLOCATION
+    alarm_task = xTaskCreateStatic(alarm_dispatcher_task, "DS3231 Alarm Task", DS3231_ALARM_STACK_SIZE, NULL, priority,
+                                   alarm_stack, &alarm_tcb);
+#else
+    if (xTaskCreate(alarm_dispatcher_task, "DS3231 Alarm Task", DS3231_ALARM_STACK_SIZE, NULL, priority, &alarm_task) != pdPASS)
+    {
+        alarm_task = NULL;
+        alarm_release(int_io, handler_added, service_installed);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_alarm_add(int64_t epoch, uint32_t period_s, ds3231_alarm_callback_t callback, void *arg,
+                           ds3231_alarm_id_t *id)
+{
+    if (callback == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (alarm_task == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+    if (alarm_free == ALARM_NONE)
+    {
+        xSemaphoreGive(alarm_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint16_t entry = alarm_free;
+    alarm_entry_t *alarm = &alarm_entries[entry];
+
+    alarm_free = alarm->heap_index;
+    alarm->deadline = epoch;
+    alarm->period_s = period_s;
+    alarm->callback = callback;
+    alarm->arg = arg;
+    heap_push(entry);
+
+    bool earliest = alarm_heap[0] == entry;
+    if (id != NULL)
+        *id = ALARM_ID(entry, alarm->generation);
+    xSemaphoreGive(alarm_mutex);
+
+    // A new earliest deadline has to go into the alarm registers
+    if (earliest)
+        xTaskNotifyGive(alarm_task);
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_alarm_cancel(ds3231_alarm_id_t id)
+{
+    uint32_t entry = ALARM_ID_INDEX(id);
+
+    if (alarm_task == NULL)
+        return ESP_ERR_INVALID_STATE;
+    if (entry >= alarm_capacity)
+        return ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+    alarm_entry_t *alarm = &alarm_entries[entry];
+    if (alarm->generation != ALARM_ID_GENERATION(id) || alarm->heap_index == ALARM_NONE ||
+        alarm_heap[alarm->heap_index] != entry)
+    {
+        xSemaphoreGive(alarm_mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    heap_remove(alarm->heap_index);
+    entry_free(entry);
+    xSemaphoreGive(alarm_mutex);
+
+    // The armed deadline stays, the dispatcher re-arms when it fires for nothing
+
+    return ESP_OK;
+}
+
+void ds3231_alarm_get_stats(ds3231_alarm_stats_t *stats)
+{
+    portENTER_CRITICAL(&alarm_stats_lock);
+    *stats = alarm_stats;
+    portEXIT_CRITICAL(&alarm_stats_lock);
+}
@@ -0,0 +1,1018 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_bench.h"
+#include "ds3231_sim.h"
+#include "ds3231_parse.h"
+#include "ds3231_snapshot.h"
+#include "ds3231_log.h"
+#include "ds3231_decode.h"
+#include "ds3231_consensus.h"
+#include "ds3231_format.h"
+#include "ds3231_epoch.h"
+#include "ds3231_bus_worker.h"
+#include "ds3231_alarm.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <esp_timer.h>
+#include "hal/cpu_hal.h"
+#if CONFIG_HEAP_TRACING_STANDALONE
+#include "esp_heap_trace.h"
+#endif
+
+#define BENCH_CYCLES_TO_NS(cycles) ((uint64_t)(cycles) * 1000 / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ)
+
+typedef void (*bench_fn_t)(const void *arg);
+
+typedef struct
+{
+  const char *name;
+  bench_fn_t fn;
+  const void *arg;
+} bench_case_t;
+
+typedef struct
+{
+  const ds3231_bench_config_t *config;
+  FILE *out;
+  TaskHandle_t caller;
+  esp_err_t result;
+} bench_job_t;
+
+static ds3231_sim_t bench_sim;
+static ds3231_sim_bus_t bench_bus;
+static ds3231_bus_backend_t bench_backend;
+static ds3231_dev_t bench_dev;
+static ds3231_sim_t bench_chips[DS3231_BENCH_CONSENSUS_CHIPS];
+static ds3231_dev_t bench_chip_devs[DS3231_BENCH_CONSENSUS_CHIPS];
+static ds3231_consensus_t bench_rtcs;
+static uint32_t bench_samples[DS3231_BENCH_MAX_ITERATIONS];
+static volatile uint8_t bench_sink; // Keeps the compiler from dropping the pure cases
+
+#if CONFIG_HEAP_TRACING_STANDALONE
+static heap_trace_record_t bench_trace[DS3231_BENCH_ALLOC_RECORDS];
+#endif
+
+static const date_time_format bench_formats[] = {
+    DATE_AND_TIME_24, DATE_AND_TIME_AM_PM, ONLY_DATE, ONLY_TIME_24, ONLY_TIME_AM_PM, UNIX_TIMESTAMPS};
+
+// Precompiled formats and the same specs for strftime()
+typedef struct
+{
+  date_time_format dt_format;
+  const char *spec;
+} bench_format_spec_t;
+
+static const bench_format_spec_t bench_format_specs[] = {
+    {DATE_AND_TIME_24, "%Y-%m-%d %H:%M:%S"},
+    {DATE_AND_TIME_AM_PM, "%Y-%m-%d %I:%M:%S %p"},
+    {ONLY_DATE, "%Y-%m-%d"},
+    {ONLY_TIME_24, "%H:%M:%S"},
+    {ONLY_TIME_AM_PM, "%I:%M:%S %p"}};
+
+// 2021-06-15 13:45:30, a Tuesday, as registers and as the struct tm strftime() gets
+static const uint8_t bench_time_regs[7] = {0x30, 0x45, 0x13, 0x03, 0x15, 0x06, 0x21};
+static struct tm bench_tm;
+
+static const char bench_comma_time[] = "30,45,13,3,15,6,21";
+static const char bench_iso_time[] = "2021-06-15T13:45:30";
+static const bool bench_static_link = true;
+
+// Event log on a storage which only counts, the flash is not worn by the benchmark
+static ds3231_log_t bench_log;
+static int64_t bench_log_epoch = 1623764730;
+static uint32_t bench_log_count;
+
+static void bench_bcd2dec(const void *arg)
+{
+    for (uint8_t i = 0; i < 0x60; i += 0x11)
+        bench_sink += bcd2dec(i);
+}
+
+static void bench_dec2bcd(const void *arg)
+{
+    for (uint8_t i = 0; i < 60; i += 7)
+        bench_sink += dec2bcd(i);
+}
+
+static void bench_get_date_time_r(const void *arg)
+{
+    char buf[DS3231_DATE_TIME_STR_SIZE];
+
+    ds3231_dev_get_date_time_r(&bench_dev, buf, sizeof(buf), *(const date_time_format *)arg);
+}
+
+static void bench_get_date_time(const void *arg)
+{
+    char *buf = NULL;
+
+    if (ds3231_dev_get_date_time(&bench_dev, &buf, *(const date_time_format *)arg) == ESP_OK)
+        free(buf);
+}
+
+#if !DS3231_STATIC_ALLOCATION
+// ds3231_get_date_time() as it was before ds3231_get_date_time_r(): the string, the registers and the
+// struct tm each on the heap, the baseline of the allocation count
+static void bench_get_date_time_baseline(const void *arg)
+{
+    const bench_format_spec_t *spec = arg;
+    char *buf = malloc(DS3231_DATE_TIME_STR_SIZE);
+    uint8_t *regs = malloc(7);
+    struct tm *time = malloc(sizeof(struct tm));
+
+    if (buf != NULL && regs != NULL && time != NULL &&
+        ds3231_dev_read_data(&bench_dev, DS3231_TIME_ADDRESS, 1, regs, 7) == ESP_OK)
+    {
+        ds3231_regs_to_tm(regs, time);
+        bench_sink += strftime(buf, DS3231_DATE_TIME_STR_SIZE, spec->spec, time);
+    }
+    free(time);
+    free(regs);
+    free(buf);
+}
+#endif
+
+static void bench_format_render(const void *arg)
+{
+    const bench_format_spec_t *spec = arg;
+    char buf[DS3231_DATE_TIME_STR_SIZE];
+
+    bench_sink += ds3231_format_render(ds3231_format_get(spec->dt_format), bench_time_regs, buf, sizeof(buf));
+}
+
+static void bench_strftime(const void *arg)
+{
+    const bench_format_spec_t *spec = arg;
+    char buf[DS3231_DATE_TIME_STR_SIZE];
+
+    bench_sink += strftime(buf, sizeof(buf), spec->spec, &bench_tm);
+}
+
+static void bench_regs_to_epoch(const void *arg)
+{
+    bench_sink += (uint8_t)ds3231_regs_to_epoch(bench_time_regs);
+}
+
+static void bench_time_to_epoch(const void *arg)
+{
+    static const uint8_t digits[7] = {30, 45, 13, 3, 15, 6, 21};
+
+    bench_sink += (uint8_t)ds3231_time_to_epoch(bench_time_regs, digits);
+}
+
+// mktime() normalises its argument, every call gets a fresh copy
+static void bench_mktime(const void *arg)
+{
+    struct tm time = bench_tm;
+
+    bench_sink += (uint8_t)mktime(&time);
+}
+
+static void bench_parse(const void *arg)
+{
+    uint8_t regs[7];
+
+    ds3231_parse_date_time(arg, strlen(arg), regs);
+}
+
+static void bench_set_date_time(const void *arg)
+{
+    ds3231_dev_set_date_time(&bench_dev, arg);
+}
+
+// Command link of a register write as esp_bus_write() builds it, without running it on a bus
+static void bench_cmd_link(const void *arg)
+{
+    static const uint8_t data[7] = {0x30, 0x45, 0x13, 0x03, 0x15, 0x06, 0x21};
+    uint8_t address = DS3231_TIME_ADDRESS;
+    uint8_t buffer[DS3231_CMD_LINK_SIZE];
+    bool use_static = arg != NULL && *(const bool *)arg;
+
+    i2c_cmd_handle_t cmd = use_static ? i2c_cmd_link_create_static(buffer, sizeof(buffer)) : i2c_cmd_link_create();
+    if (cmd == NULL)
+        return;
+
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, DS3231_ADDRESS << 1, true);
+    i2c_master_write(cmd, &address, 1, true);
+    i2c_master_write(cmd, data, sizeof(data), true);
+    i2c_master_stop(cmd);
+
+    if (use_static)
+        i2c_cmd_link_delete_static(cmd);
+    else
+        i2c_cmd_link_delete(cmd);
+}
+
+static esp_err_t bench_storage_read(void *ctx, uint32_t offset, void *buffer, size_t size)
+{
+    memset(buffer, 0xFF, size);
+    return ESP_OK;
+}
+
+static esp_err_t bench_storage_write(void *ctx, uint32_t offset, const void *buffer, size_t size)
+{
+    return ESP_OK;
+}
+
+static esp_err_t bench_storage_erase(void *ctx, uint32_t offset, size_t size)
+{
+    return ESP_OK;
+}
+
+static const ds3231_log_storage_t bench_storage = {
+    .read = bench_storage_read,
+    .write = bench_storage_write,
+    .erase = bench_storage_erase,
+    .size = 16 * DS3231_LOG_SECTOR_SIZE,
+    .ctx = NULL};
+
+// An event every 0 - 3 s, every fourth one with a 4 byte payload
+static void bench_log_append(const void *arg)
+{
+    uint32_t count = bench_log_count++;
+
+    bench_log_epoch += count % 4;
+    ds3231_log_append_at(&bench_log, bench_log_epoch, (uint8_t)count, &count, count % 4 == 0 ? sizeof(count) : 0);
+}
+
+// The same event as a text log would store it: formatted time, event id and payload in hex
+static size_t bench_format_event(char *line, size_t line_size, int64_t epoch, uint32_t count)
+{
+    time_t time = (time_t)epoch;
+    struct tm tm;
+
+    gmtime_r(&time, &tm);
+    size_t size = strftime(line, line_size, "%Y-%m-%d %H:%M:%S", &tm);
+    if (count % 4 == 0)
+        size += snprintf(line + size, line_size - size, " %u %08x\n", count & 0xFF, count);
+    else
+        size += snprintf(line + size, line_size - size, " %u\n", count & 0xFF);
+
+    return size;
+}
+
+static void bench_log_string(const void *arg)
+{
+    char line[DS3231_DATE_TIME_STR_SIZE + 16];
+    uint32_t count = bench_log_count++;
+
+    bench_log_epoch += count % 4;
+    bench_sink += bench_format_event(line, sizeof(line), bench_log_epoch, count);
+}
+
+static void bench_get_temperature(const void *arg)
+{
+    float temp;
+
+    ds3231_dev_get_temperature(&bench_dev, &temp);
+}
+
+static void bench_power_lost(const void *arg)
+{
+    uint8_t osf, status;
+
+    ds3231_dev_power_lost(&bench_dev, &osf, &status);
+}
+
+static const bench_case_t bench_cases[] = {
+    {"bcd2dec_x6", bench_bcd2dec, NULL},
+    {"dec2bcd_x9", bench_dec2bcd, NULL},
+    {"get_date_time_r/DATE_AND_TIME_24", bench_get_date_time_r, &bench_formats[0]},
+    {"get_date_time_r/DATE_AND_TIME_AM_PM", bench_get_date_time_r, &bench_formats[1]},
+    {"get_date_time_r/ONLY_DATE", bench_get_date_time_r, &bench_formats[2]},
+    {"get_date_time_r/ONLY_TIME_24", bench_get_date_time_r, &bench_formats[3]},
+    {"get_date_time_r/ONLY_TIME_AM_PM", bench_get_date_time_r, &bench_formats[4]},
+    {"get_date_time_r/UNIX_TIMESTAMPS", bench_get_date_time_r, &bench_formats[5]},
+#if !DS3231_STATIC_ALLOCATION
+    {"get_date_time/DATE_AND_TIME_24", bench_get_date_time, &bench_formats[0]},
+    {"get_date_time/DATE_AND_TIME_AM_PM", bench_get_date_time, &bench_formats[1]},
+    {"get_date_time/ONLY_DATE", bench_get_date_time, &bench_formats[2]},
+    {"get_date_time/ONLY_TIME_24", bench_get_date_time, &bench_formats[3]},
+    {"get_date_time/ONLY_TIME_AM_PM", bench_get_date_time, &bench_formats[4]},
+    {"get_date_time/UNIX_TIMESTAMPS", bench_get_date_time, &bench_formats[5]},
+    {"get_date_time_baseline/DATE_AND_TIME_24", bench_get_date_time_baseline, &bench_format_specs[0]},
+#endif
+    {"format_render/DATE_AND_TIME_24", bench_format_render, &bench_format_specs[0]},
+    {"strftime/DATE_AND_TIME_24", bench_strftime, &bench_format_specs[0]},
+    {"format_render/DATE_AND_TIME_AM_PM", bench_format_render, &bench_format_specs[1]},
+    {"strftime/DATE_AND_TIME_AM_PM", bench_strftime, &bench_format_specs[1]},
+    {"format_render/ONLY_DATE", bench_format_render, &bench_format_specs[2]},
+    {"strftime/ONLY_DATE", bench_strftime, &bench_format_specs[2]},
+    {"format_render/ONLY_TIME_24", bench_format_render, &bench_format_specs[3]},
+    {"strftime/ONLY_TIME_24", bench_strftime, &bench_format_specs[3]},
+    {"format_render/ONLY_TIME_AM_PM", bench_format_render, &bench_format_specs[4]},
+    {"strftime/ONLY_TIME_AM_PM", bench_strftime, &bench_format_specs[4]},
+    {"epoch/regs_to_epoch", bench_regs_to_epoch, NULL},
+    {"epoch/time_to_epoch", bench_time_to_epoch, NULL},
+    {"epoch/mktime", bench_mktime, NULL},
+    {"parse_date_time/comma", bench_parse, bench_comma_time},
+    {"parse_date_time/iso", bench_parse, bench_iso_time},
+    {"set_date_time/comma", bench_set_date_time, bench_comma_time},
+    {"set_date_time/iso", bench_set_date_time, bench_iso_time},
+    {"i2c_cmd_link/heap", bench_cmd_link, NULL},
+    {"i2c_cmd_link/static", bench_cmd_link, &bench_static_link},
+    {"log_append", bench_log_append, NULL},
+    {"log_string", bench_log_string, NULL},
+    {"get_temperature", bench_get_temperature, NULL},
+    {"power_lost", bench_power_lost, NULL},
+};
+
+static int bench_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t bench_percentile_ns(uint32_t count, uint32_t percent)
+{
+    return BENCH_CYCLES_TO_NS(bench_samples[(count - 1) * percent / 100]);
+}
+
+// Allocations per call, negative when heap tracing is not compiled in or a single call fills the trace
+static float bench_allocations(const bench_case_t *bench)
+{
+#if CONFIG_HEAP_TRACING_STANDALONE
+    // A full trace may have dropped its oldest records, count fewer calls then
+    for (int iterations = DS3231_BENCH_ALLOC_ITERATIONS; iterations > 0; iterations /= 2)
+    {
+        if (heap_trace_init_standalone(bench_trace, DS3231_BENCH_ALLOC_RECORDS) != ESP_OK)
+            return -1.0f;
+
+        // HEAP_TRACE_ALL keeps freed blocks, so the record count is the number of allocations
+        heap_trace_start(HEAP_TRACE_ALL);
+        for (int i = 0; i < iterations; i++)
+            bench->fn(bench->arg);
+        heap_trace_stop();
+
+        size_t count = heap_trace_get_count();
+        if (count < DS3231_BENCH_ALLOC_RECORDS)
+            return (float)count / iterations;
+    }
+#endif
+    return -1.0f;
+}
+
+static void bench_run_case(const bench_case_t *bench, uint32_t iterations, FILE *out, bool last)
+{
+    uint64_t total = 0;
+
+    // Warm-up: caches
+    bench->fn(bench->arg);
+
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        uint32_t start = cpu_hal_get_cycle_count();
+        bench->fn(bench->arg);
+        bench_samples[i] = cpu_hal_get_cycle_count() - start;
+        total += bench_samples[i];
+    }
+
+    qsort(bench_samples, iterations, sizeof(bench_samples[0]), bench_compare);
+
+    float allocs = bench_allocations(bench);
+
+    fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, "
+                 "\"max_ns\": %llu, ",
+            bench->name, (unsigned long long)(BENCH_CYCLES_TO_NS(total) / iterations),
+            (unsigned long long)bench_percentile_ns(iterations, 50),
+            (unsigned long long)bench_percentile_ns(iterations, 90),
+            (unsigned long long)bench_percentile_ns(iterations, 99),
+            (unsigned long long)BENCH_CYCLES_TO_NS(bench_samples[iterations - 1]));
+    if (allocs < 0.0f)
+        fprintf(out, "\"allocs_per_op\": null}%s\n", last ? "" : ",");
+    else
+        fprintf(out, "\"allocs_per_op\": %.2f}%s\n", allocs, last ? "" : ",");
+}
+
+typedef struct
+{
+  bool use_mutex;      // Read the time registers through the bus mutex instead of the snapshot cell
+  uint32_t reads;
+  uint32_t torn;       // Snapshots whose fields do not belong to the same write
+  TaskHandle_t waiter;
+} bench_reader_t;
+
+static ds3231_snapshot_cell_t bench_cell = DS3231_SNAPSHOT_CELL_INIT();
+static volatile bool bench_stop;
+
+// Every published snapshot is derived from one counter, a mix of two writes breaks the relation
+static void bench_writer_task(void *pvParameters)
+{
+    ds3231_snapshot_t snapshot = {0};
+    TaskHandle_t waiter = pvParameters;
+
+    for (int64_t k = 1; !bench_stop; k++)
+    {
+        snapshot.epoch_us = k;
+        snapshot.mono_us = 3 * k;
+        snapshot.last_sync_us = 7 * k;
+        snapshot.osf = k & 1;
+        ds3231_snapshot_store(&bench_cell, &snapshot);
+    }
+
+    xTaskNotifyGive(waiter);
+    vTaskDelete(NULL);
+}
+
+static void bench_reader_task(void *pvParameters)
+{
+    bench_reader_t *reader = pvParameters;
+    ds3231_snapshot_t snapshot;
+    uint8_t regs[7];
+
+    while (!bench_stop)
+    {
+        if (reader->use_mutex)
+        {
+            ds3231_dev_read_data(&bench_dev, DS3231_TIME_ADDRESS, 1, regs, sizeof(regs));
+        }
+        else if (ds3231_snapshot_load(&bench_cell, &snapshot))
+        {
+            int64_t k = snapshot.epoch_us;
+            if (snapshot.mono_us != 3 * k || snapshot.last_sync_us != 7 * k || snapshot.osf != (k & 1))
+                reader->torn++;
+        }
+        reader->reads++;
+    }
+
+    xTaskNotifyGive(reader->waiter);
+    vTaskDelete(NULL);
+}
+
+static void bench_stress(bool use_mutex, FILE *out, bool last)
+{
+    bench_reader_t readers[DS3231_BENCH_STRESS_READERS];
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    uint32_t tasks = 0;
+    uint32_t reads = 0;
+    uint32_t torn = 0;
+
+    bench_stop = false;
+    if (!use_mutex && xTaskCreatePinnedToCore(bench_writer_task, "Bench Writer", 2048, xTaskGetCurrentTaskHandle(),
+                                              priority, NULL, 0) == pdPASS)
+        tasks++;
+
+    for (int i = 0; i < DS3231_BENCH_STRESS_READERS; i++)
+    {
+        readers[i] = (bench_reader_t){.use_mutex = use_mutex, .waiter = xTaskGetCurrentTaskHandle()};
+        if (xTaskCreatePinnedToCore(bench_reader_task, "Bench Reader", 2048, &readers[i], priority, NULL,
+                                    i % portNUM_PROCESSORS) == pdPASS)
+            tasks++;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(DS3231_BENCH_STRESS_MS));
+    bench_stop = true;
+    while (tasks-- > 0)
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+    for (int i = 0; i < DS3231_BENCH_STRESS_READERS; i++)
+    {
+        reads += readers[i].reads;
+        torn += readers[i].torn;
+    }
+
+    fprintf(out, "    {\"name\": \"%s\", \"readers\": %d, \"reads_per_s\": %llu, \"torn\": %u}%s\n",
+            use_mutex ? "time_regs/mutex" : "time/seqlock", DS3231_BENCH_STRESS_READERS,
+            (unsigned long long)reads * 1000 / DS3231_BENCH_STRESS_MS, torn, last ? "" : ",");
+}
+
+static volatile uint32_t bench_sample_count;
+
+_Static_assert(16 * DS3231_BENCH_COALESCE_CALLS <= DS3231_BENCH_MAX_ITERATIONS, "samples do not fit");
+
+static void bench_caller_task(void *pvParameters)
+{
+    TaskHandle_t waiter = pvParameters;
+    char buf[DS3231_DATE_TIME_STR_SIZE];
+
+    for (int i = 0; i < DS3231_BENCH_COALESCE_CALLS; i++)
+    {
+        int64_t start = esp_timer_get_time();
+        ds3231_dev_get_date_time_r(&bench_dev, buf, sizeof(buf), DATE_AND_TIME_24);
+        uint32_t index = __atomic_fetch_add(&bench_sample_count, 1, __ATOMIC_RELAXED);
+        bench_samples[index] = (uint32_t)(esp_timer_get_time() - start);
+    }
+
+    xTaskNotifyGive(waiter);
+    vTaskDelete(NULL);
+}
+
+// Concurrent date/time reads: the bus transactions show how many of them shared one transfer
+static void bench_coalesce(uint32_t callers, FILE *out, bool last)
+{
+    uint32_t tasks = 0;
+    uint32_t transactions = bench_sim.transactions;
+
+    bench_sample_count = 0;
+    for (uint32_t i = 0; i < callers; i++)
+        if (xTaskCreatePinnedToCore(bench_caller_task, "Bench Caller", 2560, xTaskGetCurrentTaskHandle(),
+                                    uxTaskPriorityGet(NULL), NULL, i % portNUM_PROCESSORS) == pdPASS)
+            tasks++;
+
+    while (tasks-- > 0)
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+    uint32_t count = bench_sample_count;
+    transactions = bench_sim.transactions - transactions;
+    qsort(bench_samples, count, sizeof(bench_samples[0]), bench_compare);
+
+    fprintf(out, "    {\"name\": \"get_date_time_r/%u_callers\", \"calls\": %u, \"bus_transactions\": %u, "
+                 "\"p50_us\": %u, \"p99_us\": %u, \"max_us\": %u}%s\n",
+            callers, count, transactions, bench_samples[(count - 1) * 50 / 100], bench_samples[(count - 1) * 99 / 100],
+            bench_samples[count - 1], last ? "" : ",");
+}
+
+_Static_assert(16 * DS3231_BENCH_WORKER_CALLS <= DS3231_BENCH_MAX_ITERATIONS, "samples do not fit");
+
+static void bench_submitter_task(void *pvParameters)
+{
+    TaskHandle_t waiter = pvParameters;
+    uint8_t regs[7];
+
+    for (int i = 0; i < DS3231_BENCH_WORKER_CALLS; i++)
+    {
+        int64_t start = esp_timer_get_time();
+        ds3231_bus_worker_dev_read(&bench_dev, DS3231_TIME_ADDRESS, regs, sizeof(regs), DS3231_BUS_PRIORITY_HIGH);
+        uint32_t index = __atomic_fetch_add(&bench_sample_count, 1, __ATOMIC_RELAXED);
+        bench_samples[index] = (uint32_t)(esp_timer_get_time() - start);
+    }
+
+    xTaskNotifyGive(waiter);
+    vTaskDelete(NULL);
+}
+
+// Time register reads queued to the bus worker from several tasks at once, submission to completion
+static void bench_worker(uint32_t submitters, FILE *out, bool last)
+{
+    uint32_t tasks = 0;
+
+    bench_sample_count = 0;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < submitters; i++)
+        if (xTaskCreatePinnedToCore(bench_submitter_task, "Bench Submitter", 2560, xTaskGetCurrentTaskHandle(),
+                                    uxTaskPriorityGet(NULL), NULL, i % portNUM_PROCESSORS) == pdPASS)
+            tasks++;
+
+    while (tasks-- > 0)
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    int64_t elapsed_us = esp_timer_get_time() - start;
+
+    uint32_t count = bench_sample_count;
+    qsort(bench_samples, count, sizeof(bench_samples[0]), bench_compare);
+
+    fprintf(out, "    {\"name\": \"bus_worker/%u_submitters\", \"reads\": %u, \"reads_per_s\": %llu, "
+                 "\"p50_us\": %u, \"p99_us\": %u, \"max_us\": %u}%s\n",
+            submitters, count, (unsigned long long)count * 1000000ULL / (elapsed_us > 0 ? elapsed_us : 1),
+            bench_samples[(count - 1) * 50 / 100], bench_samples[(count - 1) * 99 / 100], bench_samples[count - 1],
+            last ? "" : ",");
+}
+
+typedef struct
+{
+  int64_t edge_us;        // Last INT edge of the model
+  uint32_t edges;
+  uint32_t batch;         // Callbacks since the last edge
+  uint32_t dispatched;
+  uint64_t total_us;      // Edge to callback
+  uint32_t max_first_us;  // Edge to the first callback after it
+  uint32_t max_us;
+} bench_alarm_run_t;
+
+static ds3231_alarm_id_t *bench_alarm_ids;
+#if DS3231_STATIC_ALLOCATION
+static ds3231_alarm_id_t bench_alarm_ids_buffer[DS3231_BENCH_ALARMS];
+#endif
+static portMUX_TYPE bench_alarm_lock = portMUX_INITIALIZER_UNLOCKED;
+static bench_alarm_run_t bench_alarm_run;
+
+// Stands in for the INT edge, called by the model with the bus lock held
+static void bench_alarm_edge(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&bench_alarm_lock);
+    bench_alarm_run.edge_us = now;
+    bench_alarm_run.edges++;
+    bench_alarm_run.batch = 0;
+    portEXIT_CRITICAL(&bench_alarm_lock);
+
+    ds3231_alarm_inject_interrupt();
+}
+
+static void bench_alarm_callback(int64_t epoch, void *arg)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&bench_alarm_lock);
+    uint32_t latency = (uint32_t)(now - bench_alarm_run.edge_us);
+    if (bench_alarm_run.batch++ == 0 && latency > bench_alarm_run.max_first_us)
+        bench_alarm_run.max_first_us = latency;
+    if (latency > bench_alarm_run.max_us)
+        bench_alarm_run.max_us = latency;
+    bench_alarm_run.total_us += latency;
+    bench_alarm_run.dispatched++;
+    portEXIT_CRITICAL(&bench_alarm_lock);
+}
+
+// Start the scheduler with room for DS3231_BENCH_ALARMS and the sentinel, or as many as fit
+static esp_err_t bench_alarm_init(void)
+{
+    esp_err_t result = ESP_ERR_NO_MEM;
+
+#if DS3231_STATIC_ALLOCATION
+    bench_alarm_ids = bench_alarm_ids_buffer;
+    result = ds3231_alarm_init(GPIO_NUM_NC, DS3231_BENCH_ALARMS + 1, uxTaskPriorityGet(NULL) + 1);
+#else
+    if (bench_alarm_ids == NULL)
+        bench_alarm_ids = calloc(DS3231_BENCH_ALARMS, sizeof(ds3231_alarm_id_t));
+    if (bench_alarm_ids == NULL)
+        return ESP_ERR_NO_MEM;
+
+    for (uint32_t capacity = DS3231_BENCH_ALARMS + 1; capacity > 0 && result == ESP_ERR_NO_MEM; capacity /= 2)
+        result = ds3231_alarm_init(GPIO_NUM_NC, capacity, uxTaskPriorityGet(NULL) + 1);
+#endif
+
+    // Started by an earlier run or by the application, the alarms then stop at its capacity
+    return result == ESP_ERR_INVALID_STATE ? ESP_OK : result;
+}
+
+// Insert and cancel cost with DS3231_BENCH_ALARMS alarms, then INT edge to callback latency
+static void bench_alarm(ds3231_sim_t *sim, FILE *out)
+{
+    ds3231_alarm_id_t sentinel;
+    uint32_t armed = 0;
+    uint32_t cancelled = 0;
+    uint32_t seed = 1;
+    int64_t now;
+
+    if (sim == NULL || ds3231_get_epoch(&now) != ESP_OK)
+    {
+        fprintf(out, "  \"alarm\": null,\n");
+        return;
+    }
+
+    // With the earliest deadline in place no insert below wakes the dispatcher, only the heap is timed
+    ds3231_alarm_add(now + 1800, 0, bench_alarm_callback, NULL, &sentinel);
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    uint32_t start = cpu_hal_get_cycle_count();
+    for (; armed < DS3231_BENCH_ALARMS; armed++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        if (ds3231_alarm_add(now + 3600 + seed % 3600, 0, bench_alarm_callback, NULL, &bench_alarm_ids[armed]) != ESP_OK)
+            break;
+    }
+    uint32_t insert_cycles = cpu_hal_get_cycle_count() - start;
+
+    start = cpu_hal_get_cycle_count();
+    for (uint32_t i = 0; i < armed; i++)
+        if (ds3231_alarm_cancel(bench_alarm_ids[i]) == ESP_OK)
+            cancelled++;
+    uint32_t cancel_cycles = cpu_hal_get_cycle_count() - start;
+    ds3231_alarm_cancel(sentinel);
+
+    if (armed == 0 || ds3231_get_epoch(&now) != ESP_OK)
+    {
+        fprintf(out, "  \"alarm\": null,\n");
+        return;
+    }
+
+    xSemaphoreTake(ds3231_default_dev.lock, portMAX_DELAY);
+    void (*int_edge)(void) = sim->int_edge;
+    sim->int_edge = bench_alarm_edge;
+    xSemaphoreGive(ds3231_default_dev.lock);
+
+    portENTER_CRITICAL(&bench_alarm_lock);
+    memset(&bench_alarm_run, 0, sizeof(bench_alarm_run));
+    portEXIT_CRITICAL(&bench_alarm_lock);
+
+    for (uint32_t i = 0; i < armed; i++)
+        ds3231_alarm_add(now + 2 + i % DS3231_BENCH_ALARM_SECONDS, 0, bench_alarm_callback, NULL, NULL);
+
+    // Nothing else advances the model between transactions, the edges come from these ticks
+    int64_t end_us = esp_timer_get_time() + (DS3231_BENCH_ALARM_SECONDS + 4) * 1000000LL;
+    bench_alarm_run_t run;
+    do
+    {
+        vTaskDelay(1);
+        xSemaphoreTake(ds3231_default_dev.lock, portMAX_DELAY);
+        ds3231_sim_tick(sim);
+        xSemaphoreGive(ds3231_default_dev.lock);
+
+        portENTER_CRITICAL(&bench_alarm_lock);
+        run = bench_alarm_run;
+        portEXIT_CRITICAL(&bench_alarm_lock);
+    } while (run.dispatched < armed && esp_timer_get_time() < end_us);
+
+    xSemaphoreTake(ds3231_default_dev.lock, portMAX_DELAY);
+    sim->int_edge = int_edge;
+    xSemaphoreGive(ds3231_default_dev.lock);
+
+    fprintf(out, "  \"alarm\": {\"alarms\": %u, \"add_ns\": %llu, \"cancel_ns\": %llu, \"cancelled\": %u, \"edges\": %u, "
+                 "\"dispatched\": %u, \"first_callback_max_us\": %u, \"callback_mean_us\": %llu, \"callback_max_us\": %u},\n",
+            armed, (unsigned long long)BENCH_CYCLES_TO_NS(insert_cycles) / armed,
+            (unsigned long long)BENCH_CYCLES_TO_NS(cancel_cycles) / armed, cancelled, run.edges, run.dispatched,
+            run.max_first_us, (unsigned long long)(run.dispatched > 0 ? run.total_us / run.dispatched : 0), run.max_us);
+}
+
+// Size and flash traffic of DS3231_BENCH_LOG_EVENTS events against the string a text log would write
+static void bench_event_log(FILE *out)
+{
+    ds3231_log_stats_t before, after;
+    char line[DS3231_DATE_TIME_STR_SIZE + 16];
+    uint64_t string_bytes = 0;
+
+    ds3231_log_flush(&bench_log);
+    ds3231_log_get_stats(&bench_log, &before);
+
+    uint32_t start = cpu_hal_get_cycle_count();
+    for (int i = 0; i < DS3231_BENCH_LOG_EVENTS; i++)
+        bench_log_append(NULL);
+    ds3231_log_flush(&bench_log);
+    uint32_t cycles = cpu_hal_get_cycle_count() - start;
+
+    ds3231_log_get_stats(&bench_log, &after);
+    for (uint32_t i = 0; i < DS3231_BENCH_LOG_EVENTS; i++)
+        string_bytes += bench_format_event(line, sizeof(line), bench_log_epoch, i);
+
+    uint32_t pages = after.page_writes - before.page_writes;
+    fprintf(out, "  \"event_log\": {\"events\": %d, \"record_bytes_per_event\": %.2f, \"flash_bytes_per_event\": %.2f, "
+                 "\"string_bytes_per_event\": %.2f, \"events_per_s\": %llu, \"flash_writes_per_1000\": %.1f, "
+                 "\"erases_per_1000\": %.1f}\n",
+            DS3231_BENCH_LOG_EVENTS, (float)(after.record_bytes - before.record_bytes) / DS3231_BENCH_LOG_EVENTS,
+            (float)pages * DS3231_LOG_PAGE_SIZE / DS3231_BENCH_LOG_EVENTS, (float)string_bytes / DS3231_BENCH_LOG_EVENTS,
+            (unsigned long long)DS3231_BENCH_LOG_EVENTS * 1000000000ULL / BENCH_CYCLES_TO_NS(cycles),
+            pages * 1000.0f / DS3231_BENCH_LOG_EVENTS, (after.erases - before.erases) * 1000.0f / DS3231_BENCH_LOG_EVENTS);
+}
+
+static uint8_t bench_dumps[DS3231_BENCH_DECODE_DUMPS * DS3231_REGISTER_COUNT];
+static int64_t bench_epochs[DS3231_BENCH_DECODE_DUMPS];
+static int16_t bench_temps[DS3231_BENCH_DECODE_DUMPS];
+static uint8_t bench_osf[DS3231_BENCH_DECODE_DUMPS];
+static uint8_t bench_alarm_flags[DS3231_BENCH_DECODE_DUMPS];
+
+// Snapshots per second of ds3231_decode_batch() on register dumps
+static uint64_t bench_decode_rate(bool scalar)
+{
+    const ds3231_decode_out_t out = {
+        .epoch = bench_epochs, .temp_q = bench_temps, .osf = bench_osf, .alarm_flags = bench_alarm_flags};
+
+    uint32_t start = cpu_hal_get_cycle_count();
+    for (int i = 0; i < DS3231_BENCH_DECODE_ROUNDS; i++)
+    {
+        if (scalar)
+            ds3231_decode_batch_scalar(bench_dumps, DS3231_BENCH_DECODE_DUMPS, &out);
+        else
+            ds3231_decode_batch(bench_dumps, DS3231_BENCH_DECODE_DUMPS, &out);
+    }
+    uint64_t ns = BENCH_CYCLES_TO_NS(cpu_hal_get_cycle_count() - start);
+
+    return (uint64_t)DS3231_BENCH_DECODE_ROUNDS * DS3231_BENCH_DECODE_DUMPS * 1000000000ULL / (ns > 0 ? ns : 1);
+}
+
+// Dumps of random times in both hour modes with random temperatures and flags, checked against the scalar decoder
+static void bench_decode(FILE *out)
+{
+    uint32_t seed = 12345;
+    size_t mismatches = 0;
+
+    for (int i = 0; i < DS3231_BENCH_DECODE_DUMPS; i++)
+    {
+        uint8_t *dump = &bench_dumps[i * DS3231_REGISTER_COUNT];
+
+        for (int j = 0; j < DS3231_REGISTER_COUNT; j++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            dump[j] = (uint8_t)(seed >> 24);
+        }
+        ds3231_epoch_to_regs(DS3231_EPOCH_MIN + seed % (uint32_t)(DS3231_EPOCH_MAX - DS3231_EPOCH_MIN), dump);
+        if (i % 2 == 1)
+        {
+            // Same hour in 12 hour mode
+            uint8_t hour = bcd2dec(dump[2]);
+            dump[2] = DS3231_12HOUR_FLAG | (hour >= 12 ? DS3231_PM_FLAG : 0) | dec2bcd(hour % 12 == 0 ? 12 : hour % 12);
+        }
+    }
+
+    ds3231_decode_verify(bench_dumps, DS3231_BENCH_DECODE_DUMPS, &mismatches);
+    fprintf(out, "  \"decode\": {\"impl\": \"%s\", \"snapshots\": %d, \"snapshots_per_s\": %llu, "
+                 "\"scalar_snapshots_per_s\": %llu, \"mismatches\": %u},\n",
+            ds3231_decode_impl(), DS3231_BENCH_DECODE_ROUNDS * DS3231_BENCH_DECODE_DUMPS,
+            (unsigned long long)bench_decode_rate(false), (unsigned long long)bench_decode_rate(true),
+            (unsigned)mismatches);
+}
+
+_Static_assert(DS3231_BENCH_CONSENSUS_ROUNDS <= DS3231_BENCH_MAX_ITERATIONS, "samples do not fit");
+
+// Chips set from one clock within +/-1 ms, the 4th one 30 s ahead, the 8th one without power (OSF set)
+static int64_t bench_consensus_setup(void)
+{
+    const int64_t epoch_us = 1623764730LL * 1000000;
+    int64_t mono_us = esp_timer_get_time();
+
+    for (int i = 0; i < DS3231_BENCH_CONSENSUS_CHIPS; i++)
+    {
+        ds3231_sim_t *chip = &bench_chips[i];
+
+        xSemaphoreTake(bench_dev.lock, portMAX_DELAY);
+        ds3231_sim_set_time(chip, epoch_us + (esp_timer_get_time() - mono_us) + (i * 337) % 2000 - 1000);
+        chip->registers[DS3231_STATUS_REGISTER_ADDRESS] &= ~DS3231_STATUS_OSF;
+        if (i == 3)
+            ds3231_sim_set_time(chip, epoch_us + (esp_timer_get_time() - mono_us) + 30000000);
+        else if (i == 7)
+            ds3231_sim_power_loss(chip);
+        xSemaphoreGive(bench_dev.lock);
+    }
+
+    // Epoch at esp_timer 0, the truth the results are compared with
+    return epoch_us - mono_us;
+}
+
+static void bench_consensus_run(size_t sources, ds3231_consensus_mode_t mode, int64_t offset_us, FILE *out, bool last)
+{
+    ds3231_dev_t *devs[DS3231_BENCH_CONSENSUS_CHIPS];
+    ds3231_consensus_result_t result = {0};
+    int64_t max_error_us = 0;
+    uint32_t failures = 0;
+    uint32_t outside = 0;
+
+    for (size_t i = 0; i < sources; i++)
+        devs[i] = &bench_chip_devs[i];
+    ds3231_consensus_set_sources(&bench_rtcs, devs, sources);
+
+    for (int i = 0; i < DS3231_BENCH_CONSENSUS_ROUNDS; i++)
+    {
+        if (ds3231_consensus_read(&bench_rtcs, mode, &result) != ESP_OK)
+            failures++;
+
+        int64_t error_us = llabs(result.epoch_us - (offset_us + result.mono_us));
+        if (error_us > max_error_us)
+            max_error_us = error_us;
+        if (error_us > result.bound_us)
+            outside++;
+        bench_samples[i] = result.latency_us;
+    }
+    qsort(bench_samples, DS3231_BENCH_CONSENSUS_ROUNDS, sizeof(bench_samples[0]), bench_compare);
+
+    fprintf(out, "    {\"sources\": %u, \"faulty\": %u, \"mode\": \"%s\", \"p50_us\": %u, \"max_us\": %u, "
+                 "\"bound_us\": %lld, \"max_error_us\": %lld, \"outside_bound\": %u, \"agreeing\": %u, \"no_consensus\": %u}%s\n",
+            (unsigned)sources, (unsigned)(sources > 7 ? 2 : sources > 3 ? 1 : 0),
+            mode == DS3231_CONSENSUS_MARZULLO ? "marzullo" : "median", bench_samples[(DS3231_BENCH_CONSENSUS_ROUNDS - 1) / 2],
+            bench_samples[DS3231_BENCH_CONSENSUS_ROUNDS - 1], (long long)result.bound_us, (long long)max_error_us, outside,
+            result.agreeing, failures, last ? "" : ",");
+}
+
+static void bench_consensus(FILE *out)
+{
+    int64_t offset_us = bench_consensus_setup();
+
+    fprintf(out, "  \"consensus\": [\n");
+    for (size_t sources = 1; sources <= DS3231_BENCH_CONSENSUS_CHIPS; sources *= 2)
+    {
+        bench_consensus_run(sources, DS3231_CONSENSUS_MARZULLO, offset_us, out, false);
+        bench_consensus_run(sources, DS3231_CONSENSUS_MEDIAN, offset_us, out, sources * 2 > DS3231_BENCH_CONSENSUS_CHIPS);
+    }
+    fprintf(out, "  ],\n");
+}
+
+static void bench_task(void *pvParameters)
+{
+    bench_job_t *job = pvParameters;
+    size_t count = sizeof(bench_cases) / sizeof(bench_cases[0]);
+
+    fprintf(job->out, "{\n  \"suite\": \"ds3231\",\n  \"cpu_mhz\": %d,\n  \"bus_freq_hz\": %u,\n  \"iterations\": %u,\n"
+                      "  \"results\": [\n",
+            CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ, job->config->bus_freq_hz, job->config->iterations);
+    for (size_t i = 0; i < count; i++)
+        bench_run_case(&bench_cases[i], job->config->iterations, job->out, i == count - 1);
+    fprintf(job->out, "  ],\n  \"stress\": [\n");
+    bench_stress(false, job->out, false);
+    bench_stress(true, job->out, false);
+    bench_coalesce(1, job->out, false);
+    bench_coalesce(4, job->out, false);
+    bench_coalesce(16, job->out, true);
+    fprintf(job->out, "  ],\n  \"bus_worker\": [\n");
+    bench_worker(1, job->out, false);
+    bench_worker(4, job->out, false);
+    bench_worker(16, job->out, true);
+    fprintf(job->out, "  ],\n");
+    bench_alarm(job->config->alarm_sim, job->out);
+    bench_consensus(job->out);
+    bench_decode(job->out);
+    bench_event_log(job->out);
+    fprintf(job->out, "}\n");
+
+    job->result = ESP_OK;
+    xTaskNotifyGive(job->caller);
+    vTaskDelete(NULL);
+}
+
+esp_err_t ds3231_bench_run(const ds3231_bench_config_t *config, FILE *out)
+{
+    ds3231_bench_config_t defaults = {
+        .iterations = DS3231_BENCH_ITERATIONS,
+        .bus_freq_hz = I2C_MASTER_FREQ_HZ};
+
+    if (config == NULL)
+        config = &defaults;
+    if (out == NULL || config->iterations == 0 || config->iterations > DS3231_BENCH_MAX_ITERATIONS)
+        return ESP_ERR_INVALID_ARG;
+
+    if (bench_dev.lock == NULL)
+    {
+        ds3231_dev_config_t dev_config = DS3231_DEV_CONFIG_DEFAULT();
+
+        // The consensus chips sit next to the benchmarked one, behind the simulated multiplexer
+        ds3231_sim_bus_init(&bench_bus);
+        ds3231_sim_init(&bench_sim, config->bus_freq_hz);
+        esp_err_t result = ds3231_sim_bus_attach(&bench_bus, &bench_sim, DS3231_ADDRESS);
+        for (int i = 0; i < DS3231_BENCH_CONSENSUS_CHIPS && result == ESP_OK; i++)
+        {
+            ds3231_sim_init(&bench_chips[i], config->bus_freq_hz);
+            result = ds3231_sim_bus_attach(&bench_bus, &bench_chips[i], 0x10 + i);
+        }
+        if (result != ESP_OK)
+            return result;
+
+        ds3231_sim_bus_get_backend(&bench_bus, &bench_backend);
+        dev_config.port = DS3231_BENCH_PORT;
+        dev_config.backend = &bench_backend;
+
+        result = ds3231_dev_init(&bench_dev, &dev_config);
+        for (int i = 0; i < DS3231_BENCH_CONSENSUS_CHIPS && result == ESP_OK; i++)
+        {
+            dev_config.address = bench_chips[i].address;
+            result = ds3231_dev_init(&bench_chip_devs[i], &dev_config);
+        }
+        if (result != ESP_OK)
+            return result;
+    }
+
+    // The worker serves bench_dev through the device of each request, it may have been started already
+    esp_err_t worker_result = ds3231_bus_worker_start(uxTaskPriorityGet(NULL), 0);
+    if (worker_result != ESP_OK && worker_result != ESP_ERR_INVALID_STATE)
+        return worker_result;
+
+    if (config->alarm_sim != NULL)
+    {
+        esp_err_t result = bench_alarm_init();
+        if (result != ESP_OK)
+            return result;
+    }
+
+    if (bench_rtcs.lock == NULL)
+    {
+        esp_err_t result = ds3231_consensus_init(&bench_rtcs, uxTaskPriorityGet(NULL));
+        if (result != ESP_OK)
+            return result;
+    }
+
+    ds3231_sim_set_bus_freq(&bench_sim, config->bus_freq_hz);
+    for (int i = 0; i < DS3231_BENCH_CONSENSUS_CHIPS; i++)
+        ds3231_sim_set_bus_freq(&bench_chips[i], config->bus_freq_hz);
+
+    ds3231_regs_to_tm(bench_time_regs, &bench_tm);
+    if (ds3231_regs_to_epoch(bench_time_regs) != mktime(&bench_tm))
+        ESP_LOGW(DS3231_TAG, "ds3231_regs_to_epoch() and mktime() disagree, TZ is not UTC");
+
+    esp_err_t result = ds3231_log_init(&bench_log, &bench_storage);
+    if (result != ESP_OK)
+        return result;
+
+    // Same core all the time, the cycle counters of the two cores are unrelated
+    bench_job_t job = {.config = config, .out = out, .caller = xTaskGetCurrentTaskHandle(), .result = ESP_FAIL};
+    if (xTaskCreatePinnedToCore(bench_task, "DS3231 Bench Task", DS3231_BENCH_STACK_SIZE, &job,
+                                uxTaskPriorityGet(NULL), NULL, xPortGetCoreID()) != pdPASS)
+        return ESP_ERR_NO_MEM;
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    return job.result;
+}
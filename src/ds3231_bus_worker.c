@@ -0,0 +1,262 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_bus_worker.h"
+
+#include <esp_timer.h>
+
+typedef struct
+{
+  ds3231_bus_request_t request;
+  int64_t submit_us;
+} worker_item_t;
+
+// Completion of a blocking transfer, the caller waits on its own semaphore
+typedef struct
+{
+  SemaphoreHandle_t done;
+  esp_err_t result;
+} worker_completion_t;
+
+static QueueHandle_t worker_queue[DS3231_BUS_PRIORITY_COUNT];
+// Counts the queued items of both queues, the worker blocks on it
+static SemaphoreHandle_t worker_pending;
+static TaskHandle_t worker_task;
+#if DS3231_STATIC_ALLOCATION
+static StaticQueue_t worker_queue_buffer[DS3231_BUS_PRIORITY_COUNT];
+static uint8_t worker_queue_storage[DS3231_BUS_PRIORITY_COUNT][DS3231_BUS_WORKER_QUEUE_DEPTH * sizeof(worker_item_t)];
+static StaticSemaphore_t worker_pending_buffer;
+static StaticTask_t worker_tcb;
+static StackType_t worker_stack[DS3231_BUS_WORKER_STACK_SIZE];
+#endif
+static portMUX_TYPE worker_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static ds3231_bus_worker_stats_t worker_stats[DS3231_BUS_PRIORITY_COUNT];
+
+static void worker_complete(ds3231_bus_priority_t priority, const worker_item_t *item, esp_err_t result)
+{
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - item->submit_us);
+
+    portENTER_CRITICAL(&worker_stats_lock);
+    ds3231_bus_worker_stats_t *stats = &worker_stats[priority];
+    stats->completed++;
+    if (result != ESP_OK)
+        stats->failed++;
+    stats->total_latency_us += latency;
+    if (latency > stats->max_latency_us)
+        stats->max_latency_us = latency;
+    portEXIT_CRITICAL(&worker_stats_lock);
+
+    if (item->request.callback != NULL)
+        item->request.callback(result, item->request.arg);
+    else if (item->request.notify_task != NULL)
+        xTaskNotify(item->request.notify_task, (uint32_t)result, eSetValueWithOverwrite);
+}
+
+static void bus_worker_task(void *pvParameters)
+{
+    worker_item_t item;
+
+    while (1)
+    {
+        xSemaphoreTake(worker_pending, portMAX_DELAY);
+
+        // The high priority queue is always drained first
+        for (int priority = 0; priority < DS3231_BUS_PRIORITY_COUNT; priority++)
+        {
+            if (xQueueReceive(worker_queue[priority], &item, 0) != pdTRUE)
+                continue;
+
+            ds3231_dev_t *dev = item.request.dev != NULL ? item.request.dev : &ds3231_default_dev;
+            esp_err_t result;
+            if (item.request.op == DS3231_BUS_OP_READ)
+                result = ds3231_dev_read_data(dev, item.request.address, 1, item.request.buffer, item.request.size);
+            else
+                result = ds3231_dev_write_data(dev, item.request.address, 1, item.request.buffer, item.request.size);
+
+            worker_complete((ds3231_bus_priority_t)priority, &item, result);
+            break;
+        }
+    }
+}
+
+// Release what a failed ds3231_bus_worker_start() created, the task does not exist
+static void worker_release(void)
+{
+    for (int i = 0; i < DS3231_BUS_PRIORITY_COUNT; i++)
+    {
+        if (worker_queue[i] != NULL)
+            vQueueDelete(worker_queue[i]);
+        worker_queue[i] = NULL;
+    }
+
+    if (worker_pending != NULL)
+        vSemaphoreDelete(worker_pending);
+    worker_pending = NULL;
+}
+
+esp_err_t ds3231_bus_worker_start(UBaseType_t priority, size_t queue_depth)
+{
+    if (worker_task != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    if (queue_depth == 0)
+        queue_depth = DS3231_BUS_WORKER_QUEUE_DEPTH;
+#if DS3231_STATIC_ALLOCATION
+    if (queue_depth > DS3231_BUS_WORKER_QUEUE_DEPTH)
+        return ESP_ERR_INVALID_ARG;
+#endif
+
+    for (int i = 0; i < DS3231_BUS_PRIORITY_COUNT; i++)
+    {
+#if DS3231_STATIC_ALLOCATION
+        worker_queue[i] = xQueueCreateStatic(queue_depth, sizeof(worker_item_t), worker_queue_storage[i],
+                                             &worker_queue_buffer[i]);
+#else
+        worker_queue[i] = xQueueCreate(queue_depth, sizeof(worker_item_t));
+#endif
+        if (worker_queue[i] == NULL)
+        {
+            worker_release();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+#if DS3231_STATIC_ALLOCATION
+    worker_pending = xSemaphoreCreateCountingStatic(queue_depth * DS3231_BUS_PRIORITY_COUNT, 0, &worker_pending_buffer);
+#else
+    worker_pending = xSemaphoreCreateCounting(queue_depth * DS3231_BUS_PRIORITY_COUNT, 0);
+#endif
+    if (worker_pending == NULL)
+    {
+        worker_release();
+        return ESP_ERR_NO_MEM;
+    }
+
+#if DS3231_STATIC_ALLOCATION
+    worker_task = xTaskCreateStatic(bus_worker_task, "DS3231 Bus Worker", DS3231_BUS_WORKER_STACK_SIZE, NULL, priority,
+                                    worker_stack, &worker_tcb);
+#else
+    if (xTaskCreate(bus_worker_task, "DS3231 Bus Worker", DS3231_BUS_WORKER_STACK_SIZE, NULL, priority, &worker_task) != pdPASS)
+    {
+        worker_task = NULL;
+        worker_release();
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_bus_submit(const ds3231_bus_request_t *request, ds3231_bus_priority_t priority, TickType_t ticks_to_wait)
+{
+    if (request == NULL || request->buffer == NULL || request->size == 0 || priority >= DS3231_BUS_PRIORITY_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    if (worker_task == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    worker_item_t item = {
+        .request = *request,
+        .submit_us = esp_timer_get_time()};
+
+    if (xQueueSend(worker_queue[priority], &item, ticks_to_wait) != pdTRUE)
+    {
+        portENTER_CRITICAL(&worker_stats_lock);
+        worker_stats[priority].rejected++;
+        portEXIT_CRITICAL(&worker_stats_lock);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    xSemaphoreGive(worker_pending);
+
+    return ESP_OK;
+}
+
+static void worker_transfer_done(esp_err_t result, void *arg)
+{
+    worker_completion_t *completion = arg;
+
+    completion->result = result;
+    xSemaphoreGive(completion->done);
+}
+
+// The task notifications of the caller stay untouched, it may use them for something else
+static esp_err_t worker_transfer(ds3231_dev_t *dev, ds3231_bus_op_t op, uint8_t address, uint8_t *buffer, size_t size,
+                                 ds3231_bus_priority_t priority)
+{
+    StaticSemaphore_t done_buffer;
+    worker_completion_t completion = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+        .result = ESP_FAIL};
+    ds3231_bus_request_t request = {
+        .op = op,
+        .dev = dev,
+        .address = address,
+        .buffer = buffer,
+        .size = size,
+        .callback = worker_transfer_done,
+        .arg = &completion};
+
+    esp_err_t result = ds3231_bus_submit(&request, priority, portMAX_DELAY);
+    if (result == ESP_OK)
+    {
+        // The buffer and the semaphore live on our stack, so wait for the completion whatever it takes
+        xSemaphoreTake(completion.done, portMAX_DELAY);
+        result = completion.result;
+    }
+    vSemaphoreDelete(completion.done);
+
+    return result;
+}
+
+esp_err_t ds3231_bus_worker_read(uint8_t address, uint8_t *rx_buffer, size_t rx_buffer_size, ds3231_bus_priority_t priority)
+{
+    return worker_transfer(NULL, DS3231_BUS_OP_READ, address, rx_buffer, rx_buffer_size, priority);
+}
+
+esp_err_t ds3231_bus_worker_write(uint8_t address, uint8_t *tx_buffer, size_t tx_buffer_size, ds3231_bus_priority_t priority)
+{
+    return worker_transfer(NULL, DS3231_BUS_OP_WRITE, address, tx_buffer, tx_buffer_size, priority);
+}
+
+esp_err_t ds3231_bus_worker_dev_read(ds3231_dev_t *dev, uint8_t address, uint8_t *rx_buffer, size_t rx_buffer_size,
+                                     ds3231_bus_priority_t priority)
+{
+    if (dev == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    return worker_transfer(dev, DS3231_BUS_OP_READ, address, rx_buffer, rx_buffer_size, priority);
+}
+
+void ds3231_bus_worker_get_stats(ds3231_bus_priority_t priority, ds3231_bus_worker_stats_t *stats)
+{
+    if (priority >= DS3231_BUS_PRIORITY_COUNT)
+        return;
+
+    portENTER_CRITICAL(&worker_stats_lock);
+    *stats = worker_stats[priority];
+    portEXIT_CRITICAL(&worker_stats_lock);
+}
@@ -0,0 +1,466 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_cal.h"
+#include "ds3231_epoch.h"
+#include "ds3231_regmap.h"
+#include "ds3231_temp.h"
+
+#include <math.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+
+#define CAL_FINE_POLL_TICKS 4 // Polling without sleep around the expected edge, at most
+
+typedef struct
+{
+  int64_t ref_us;
+  int64_t offset_us;     // RTC time - reference time
+  float temp;
+  double temp_integral;  // Integral of (T - 25) over the reference time since the window start, degree seconds
+} cal_sample_t;
+
+typedef struct
+{
+  bool valid;            // At least 3 samples
+  double rate_ppm;       // At the mean temperature
+  double stderr_ppm;
+  double coeff_ppm;      // Per degree, 0 - temperature term not fitted
+  double mean_temp;
+  double rms_us;
+  double span_s;
+} cal_fit_t;
+
+static ds3231_cal_config_t cal_config;
+static SemaphoreHandle_t cal_mutex;
+static TaskHandle_t cal_task;
+#if DS3231_STATIC_ALLOCATION
+static StaticSemaphore_t cal_mutex_buffer;
+static StaticTask_t cal_tcb;
+static StackType_t cal_stack[DS3231_CAL_STACK_SIZE];
+#endif
+
+// Sliding window, oldest sample at (cal_next - cal_count) modulo DS3231_CAL_WINDOW
+static cal_sample_t cal_samples[DS3231_CAL_WINDOW];
+static uint32_t cal_next;
+static uint32_t cal_count;
+static cal_fit_t cal_fit;
+static int8_t cal_aging;
+static uint32_t cal_trims;
+static uint32_t cal_restarts;
+static float cal_initial_drift = NAN;
+
+static int64_t cal_reference(void)
+{
+    return cal_config.reference != NULL ? cal_config.reference(cal_config.reference_ctx) : esp_timer_get_time();
+}
+
+static const cal_sample_t *cal_sample_at(uint32_t i)
+{
+    return &cal_samples[(cal_next + DS3231_CAL_WINDOW - cal_count + i) % DS3231_CAL_WINDOW];
+}
+
+// Least squares fit of offset = c + rate * t + coeff * integral(T - 25) dt, without the temperature term
+// when the window is too isothermal to tell it from the rate. Times relative to the oldest sample, centred.
+static void cal_update_fit(void)
+{
+    const cal_sample_t *base = cal_sample_at(0);
+    double mean_t = 0.0, mean_s = 0.0, mean_o = 0.0, mean_temp = 0.0;
+    float min_temp = base->temp, max_temp = base->temp;
+    uint32_t n = cal_count;
+
+    cal_fit = (cal_fit_t){.valid = false, .mean_temp = 25.0};
+    if (n == 0)
+        return;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const cal_sample_t *sample = cal_sample_at(i);
+        mean_t += (sample->ref_us - base->ref_us) * 1e-6;
+        mean_s += sample->temp_integral - base->temp_integral;
+        mean_o += (double)(sample->offset_us - base->offset_us);
+        mean_temp += sample->temp;
+        min_temp = fminf(min_temp, sample->temp);
+        max_temp = fmaxf(max_temp, sample->temp);
+    }
+    mean_t /= n;
+    mean_s /= n;
+    mean_o /= n;
+    cal_fit.mean_temp = mean_temp / n;
+    cal_fit.span_s = (cal_sample_at(n - 1)->ref_us - base->ref_us) * 1e-6;
+    if (n < 3)
+        return;
+
+    double stt = 0.0, sts = 0.0, sss = 0.0, sto = 0.0, sso = 0.0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const cal_sample_t *sample = cal_sample_at(i);
+        double t = (sample->ref_us - base->ref_us) * 1e-6 - mean_t;
+        double s = sample->temp_integral - base->temp_integral - mean_s;
+        double o = (double)(sample->offset_us - base->offset_us) - mean_o;
+        stt += t * t;
+        sts += t * s;
+        sss += s * s;
+        sto += t * o;
+        sso += s * o;
+    }
+    if (stt <= 0.0)
+        return;
+
+    double rate, coeff = 0.0, variance;
+    double det = stt * sss - sts * sts;
+    bool use_temp = n >= 4 && max_temp - min_temp >= DS3231_CAL_MIN_TEMP_SPREAD && det > 1e-9 * stt * sss;
+    if (use_temp)
+    {
+        rate = (sto * sss - sso * sts) / det;
+        coeff = (sso * stt - sto * sts) / det;
+        variance = sss / det;
+    }
+    else
+    {
+        rate = sto / stt;
+        variance = 1.0 / stt;
+    }
+
+    double sse = 0.0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const cal_sample_t *sample = cal_sample_at(i);
+        double t = (sample->ref_us - base->ref_us) * 1e-6 - mean_t;
+        double s = sample->temp_integral - base->temp_integral - mean_s;
+        double e = (double)(sample->offset_us - base->offset_us) - mean_o - rate * t - coeff * s;
+        sse += e * e;
+    }
+
+    uint32_t dof = n - (use_temp ? 3 : 2);
+    cal_fit.valid = true;
+    cal_fit.rate_ppm = rate + coeff * (cal_fit.mean_temp - 25.0);
+    cal_fit.coeff_ppm = coeff;
+    cal_fit.stderr_ppm = dof > 0 ? sqrt(sse / dof * variance) : INFINITY;
+    cal_fit.rms_us = sqrt(sse / n);
+}
+
+// Called with cal_mutex held
+static esp_err_t cal_apply_trim(void)
+{
+    long steps = lround(cal_fit.rate_ppm / DS3231_AGING_PPM_PER_LSB);
+    long aging = cal_aging + steps;
+    uint8_t value = (uint8_t)(int8_t)(aging < INT8_MIN ? INT8_MIN : aging > INT8_MAX ? INT8_MAX : aging);
+
+    if (isnan(cal_initial_drift))
+        cal_initial_drift = cal_fit.rate_ppm;
+
+    if ((int8_t)value != cal_aging)
+    {
+        esp_err_t result = ds3231_regmap_write(DS3231_AGING_OFFSET_ADDRESS, &value, 1);
+        if (result == ESP_OK)
+            result = ds3231_regmap_flush();
+        if (result != ESP_OK)
+            return result;
+
+        ESP_LOGI(DS3231_TAG, "Drift %.3f ppm, aging offset %d -> %d", cal_fit.rate_ppm, cal_aging, (int8_t)value);
+        cal_aging = (int8_t)value;
+        cal_trims++;
+
+        // The chip takes the new offset over with the next temperature conversion
+        float temp;
+        if (ds3231_temp_convert(&temp) != ESP_OK)
+            ESP_LOGW(DS3231_TAG, "Temperature conversion after the aging offset change failed");
+
+        // The rate has changed, the old samples do not fit any more
+        cal_count = 0;
+        cal_update_fit();
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_cal_feed(int64_t ref_us, int64_t rtc_us, float temp)
+{
+    esp_err_t result = ESP_OK;
+
+    if (cal_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(cal_mutex, portMAX_DELAY);
+
+    cal_sample_t sample = {.ref_us = ref_us, .offset_us = rtc_us - ref_us, .temp = temp, .temp_integral = 0.0};
+    if (cal_count > 0)
+    {
+        const cal_sample_t *last = cal_sample_at(cal_count - 1);
+        double dt = (ref_us - last->ref_us) * 1e-6;
+        double expected = cal_fit.valid ? cal_fit.rate_ppm * dt : 0.0;
+
+        if (ref_us <= last->ref_us)
+        {
+            xSemaphoreGive(cal_mutex);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        if (fabs((double)(sample.offset_us - last->offset_us) - expected) > DS3231_CAL_JUMP_US)
+        {
+            ESP_LOGW(DS3231_TAG, "RTC time jumped, calibration window restarted");
+            cal_count = 0;
+            cal_restarts++;
+        }
+        else
+        {
+            sample.temp_integral = last->temp_integral + ((last->temp + temp) / 2.0 - 25.0) * dt;
+        }
+    }
+
+    cal_samples[cal_next] = sample;
+    cal_next = (cal_next + 1) % DS3231_CAL_WINDOW;
+    if (cal_count < DS3231_CAL_WINDOW)
+        cal_count++;
+    cal_update_fit();
+
+    // Trim only when the drift is beyond half a step with about 95 % confidence, otherwise the offset
+    // would dither between two steps on noise
+    if (cal_config.auto_trim && cal_fit.valid && cal_fit.span_s >= cal_config.min_span_s &&
+        cal_fit.stderr_ppm <= DS3231_CAL_TRIM_STDERR_PPM &&
+        fabs(cal_fit.rate_ppm) - 2.0 * cal_fit.stderr_ppm >= DS3231_AGING_PPM_PER_LSB / 2)
+        result = cal_apply_trim();
+
+    xSemaphoreGive(cal_mutex);
+
+    return result;
+}
+
+static esp_err_t cal_read_time(int64_t *epoch, uint8_t *seconds)
+{
+    uint8_t regs[7];
+
+    esp_err_t result = ds3231_read_data(DS3231_TIME_ADDRESS, 1, regs, sizeof(regs));
+    if (result != ESP_OK)
+        return result;
+
+    *seconds = regs[0];
+    *epoch = ds3231_regs_to_epoch(regs);
+
+    return ESP_OK;
+}
+
+// Reference time of a seconds edge: find the edge to a tick by polling with sleeps, then wait for the
+// next one and poll back to back across it. The edge is between the last two reads.
+static esp_err_t cal_capture_edge(int64_t *ref_us, int64_t *epoch)
+{
+    uint8_t first, seconds;
+    TickType_t edge_tick = 0;
+    bool found = false;
+
+    esp_err_t result = cal_read_time(epoch, &first);
+    for (int i = 0; result == ESP_OK && i <= configTICK_RATE_HZ + 1; i++)
+    {
+        vTaskDelay(1);
+        result = cal_read_time(epoch, &seconds);
+        if (result == ESP_OK && seconds != first)
+        {
+            edge_tick = xTaskGetTickCount();
+            found = true;
+            break;
+        }
+    }
+    if (result != ESP_OK)
+        return result;
+    if (!found)
+        return ESP_ERR_TIMEOUT;
+
+    // The next edge is between edge_tick - 1 and edge_tick plus a second
+    first = seconds;
+    vTaskDelayUntil(&edge_tick, configTICK_RATE_HZ - 2);
+
+    int64_t previous_us = 0;
+    int64_t deadline_us = cal_reference() + CAL_FINE_POLL_TICKS * portTICK_PERIOD_MS * 1000LL;
+    while (1)
+    {
+        result = cal_read_time(epoch, &seconds);
+        int64_t now_us = cal_reference();
+        if (result != ESP_OK)
+            return result;
+
+        if (seconds != first)
+        {
+            // Woken up too late, the edge is not between two reads
+            if (previous_us == 0)
+                return ESP_ERR_TIMEOUT;
+
+            *ref_us = previous_us + (now_us - previous_us) / 2;
+            return ESP_OK;
+        }
+
+        if (now_us > deadline_us)
+            return ESP_ERR_TIMEOUT;
+        previous_us = now_us;
+    }
+}
+
+esp_err_t ds3231_cal_sample(void)
+{
+    int64_t ref_us, epoch;
+    float temp;
+
+    if (cal_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    esp_err_t result = cal_capture_edge(&ref_us, &epoch);
+    if (result != ESP_OK)
+        return result;
+
+    // Cached, the temperature service converts at most every 64 s anyway
+    if (ds3231_temp_get(&temp) != ESP_OK)
+        temp = cal_fit.mean_temp;
+
+    return ds3231_cal_feed(ref_us, epoch * 1000000LL, temp);
+}
+
+esp_err_t ds3231_cal_trim(void)
+{
+    if (cal_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(cal_mutex, portMAX_DELAY);
+    esp_err_t result = cal_fit.valid ? cal_apply_trim() : ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(cal_mutex);
+
+    return result;
+}
+
+void ds3231_cal_reset(void)
+{
+    if (cal_mutex == NULL)
+        return;
+
+    xSemaphoreTake(cal_mutex, portMAX_DELAY);
+    cal_count = 0;
+    cal_update_fit();
+    xSemaphoreGive(cal_mutex);
+}
+
+esp_err_t ds3231_cal_get_status(ds3231_cal_status_t *status)
+{
+    if (status == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (cal_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(cal_mutex, portMAX_DELAY);
+
+    *status = (ds3231_cal_status_t){
+        .samples = cal_count,
+        .span_s = cal_fit.span_s,
+        .drift_ppm = cal_fit.valid ? cal_fit.rate_ppm : NAN,
+        .drift_stderr_ppm = cal_fit.valid ? cal_fit.stderr_ppm : NAN,
+        .temp_coeff_ppm = cal_fit.coeff_ppm,
+        .mean_temp = cal_fit.mean_temp,
+        .rms_error_us = cal_fit.rms_us,
+        .initial_drift_ppm = cal_initial_drift,
+        .aging_offset = cal_aging,
+        .trims = cal_trims,
+        .restarts = cal_restarts,
+        .resync_interval_s = 0};
+
+    // error_us = ppm * t_s
+    double bound_ppm = fabs(cal_fit.rate_ppm) + 2.0 * cal_fit.stderr_ppm;
+    if (cal_fit.valid && isfinite(bound_ppm))
+    {
+        double interval_s = bound_ppm > 0.0 ? DS3231_CAL_MAX_ERROR_MS * 1000.0 / bound_ppm : UINT32_MAX;
+        status->resync_interval_s = interval_s < UINT32_MAX ? (uint32_t)interval_s : UINT32_MAX;
+    }
+
+    xSemaphoreGive(cal_mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_cal_init(const ds3231_cal_config_t *config)
+{
+    ds3231_cal_config_t defaults = DS3231_CAL_CONFIG_DEFAULT();
+    uint8_t aging;
+
+    if (config == NULL)
+        config = &defaults;
+    if (config->interval_s == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    if (cal_mutex == NULL)
+    {
+#if DS3231_STATIC_ALLOCATION
+        cal_mutex = xSemaphoreCreateMutexStatic(&cal_mutex_buffer);
+#else
+        cal_mutex = xSemaphoreCreateMutex();
+#endif
+        if (cal_mutex == NULL)
+            return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t result = ds3231_regmap_read(DS3231_AGING_OFFSET_ADDRESS, &aging, 1);
+    if (result != ESP_OK)
+        return result;
+
+    xSemaphoreTake(cal_mutex, portMAX_DELAY);
+    cal_config = *config;
+    cal_aging = (int8_t)aging;
+    cal_count = 0;
+    cal_update_fit();
+    xSemaphoreGive(cal_mutex);
+
+    return ESP_OK;
+}
+
+static void cal_sample_task(void *pvParameters)
+{
+    TickType_t wake = xTaskGetTickCount();
+
+    while (1)
+    {
+        esp_err_t result = ds3231_cal_sample();
+        if (result != ESP_OK)
+            ESP_LOGW(DS3231_TAG, "Calibration sample failed: %d (%s)", result, esp_err_to_name(result));
+
+        vTaskDelayUntil(&wake, cal_config.interval_s * configTICK_RATE_HZ);
+    }
+}
+
+esp_err_t ds3231_cal_start(const ds3231_cal_config_t *config, UBaseType_t priority)
+{
+    if (cal_task != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    esp_err_t result = ds3231_cal_init(config);
+    if (result != ESP_OK)
+        return result;
+
+#if DS3231_STATIC_ALLOCATION
+    cal_task = xTaskCreateStatic(cal_sample_task, "DS3231 Cal Task", DS3231_CAL_STACK_SIZE, NULL, priority, cal_stack,
+                                 &cal_tcb);
+#else
+    if (xTaskCreate(cal_sample_task, "DS3231 Cal Task", DS3231_CAL_STACK_SIZE, NULL, priority, &cal_task) != pdPASS)
+        return ESP_ERR_NO_MEM;
+#endif
+
+    return ESP_OK;
+}
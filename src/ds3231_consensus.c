@@ -0,0 +1,393 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_consensus.h"
+#include "ds3231_epoch.h"
+
+#include <esp_timer.h>
+#include <stdlib.h>
+
+#define CONSENSUS_SECOND_US 1000000LL
+
+// Times a source allows at the common instant, [low_us, high_us)
+typedef struct
+{
+  int64_t low_us;
+  int64_t high_us;
+  uint8_t weight;
+  uint8_t source;
+} consensus_interval_t;
+
+// Edge of an interval for the Marzullo sweep: +weight where it opens, -weight where it closes
+typedef struct
+{
+  int64_t offset_us;
+  int8_t delta;
+} consensus_edge_t;
+
+static i2c_port_t consensus_reader_port(const ds3231_consensus_t *consensus)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    for (i2c_port_t port = 0; port < I2C_NUM_MAX; port++)
+        if (consensus->readers[port] == self)
+            return port;
+
+    return I2C_NUM_MAX;
+}
+
+// Reads the sources of one port back to back, the ports run in parallel
+static void consensus_reader_task(void *pvParameters)
+{
+    ds3231_consensus_t *consensus = pvParameters;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // The handles are only complete after ds3231_consensus_init(), before the first round
+        i2c_port_t port = consensus_reader_port(consensus);
+        for (size_t i = 0; i < consensus->count; i++)
+        {
+            ds3231_dev_t *dev = consensus->sources[i];
+
+            if (dev->port != port)
+                continue;
+
+            consensus->read_start_us[i] = esp_timer_get_time();
+            consensus->read_result[i] = ds3231_dev_read_data(dev, DS3231_TIME_ADDRESS, 1, consensus->registers[i],
+                                                             sizeof(consensus->registers[i]));
+            consensus->read_end_us[i] = esp_timer_get_time();
+        }
+
+        xSemaphoreGive(consensus->done);
+    }
+}
+
+// Undo a failed ds3231_consensus_init(), lock stays NULL so the consensus reads as not initialised
+static void consensus_release(ds3231_consensus_t *consensus)
+{
+    for (i2c_port_t port = 0; port < I2C_NUM_MAX; port++)
+    {
+        if (consensus->readers[port] != NULL)
+            vTaskDelete(consensus->readers[port]);
+        consensus->readers[port] = NULL;
+    }
+    if (consensus->done != NULL)
+        vSemaphoreDelete(consensus->done);
+    if (consensus->lock != NULL)
+        vSemaphoreDelete(consensus->lock);
+    consensus->done = NULL;
+    consensus->lock = NULL;
+}
+
+esp_err_t ds3231_consensus_init(ds3231_consensus_t *consensus, UBaseType_t priority)
+{
+    if (consensus == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(consensus, 0, sizeof(*consensus));
+    portMUX_INITIALIZE(&consensus->result_lock);
+
+    // The readers report to their own semaphore, the caller's task notifications stay untouched
+#if DS3231_STATIC_ALLOCATION
+    consensus->lock = xSemaphoreCreateMutexStatic(&consensus->lock_buffer);
+    consensus->done = xSemaphoreCreateCountingStatic(I2C_NUM_MAX, 0, &consensus->done_buffer);
+#else
+    consensus->lock = xSemaphoreCreateMutex();
+    consensus->done = xSemaphoreCreateCounting(I2C_NUM_MAX, 0);
+#endif
+    if (consensus->lock == NULL || consensus->done == NULL)
+    {
+        consensus_release(consensus);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (i2c_port_t port = 0; port < I2C_NUM_MAX; port++)
+    {
+#if DS3231_STATIC_ALLOCATION
+        consensus->readers[port] = xTaskCreateStatic(consensus_reader_task, "DS3231 Consensus", DS3231_CONSENSUS_STACK_SIZE,
+                                                     consensus, priority, consensus->reader_stack[port],
+                                                     &consensus->reader_tcb[port]);
+#else
+        if (xTaskCreate(consensus_reader_task, "DS3231 Consensus", DS3231_CONSENSUS_STACK_SIZE, consensus, priority,
+                        &consensus->readers[port]) != pdPASS)
+            consensus->readers[port] = NULL;
+#endif
+        if (consensus->readers[port] == NULL)
+        {
+            // The readers created so far are still waiting for their first round
+            consensus_release(consensus);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_consensus_set_sources(ds3231_consensus_t *consensus, ds3231_dev_t *const *sources, size_t count)
+{
+    if (consensus == NULL || sources == NULL || count == 0 || count > DS3231_CONSENSUS_MAX_SOURCES)
+        return ESP_ERR_INVALID_ARG;
+
+    for (size_t i = 0; i < count; i++)
+        if (sources[i] == NULL || sources[i]->lock == NULL || sources[i]->port < 0 || sources[i]->port >= I2C_NUM_MAX)
+            return ESP_ERR_INVALID_ARG;
+
+    if (consensus->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(consensus->lock, portMAX_DELAY);
+    memcpy(consensus->sources, sources, count * sizeof(sources[0]));
+    consensus->count = count;
+    xSemaphoreGive(consensus->lock);
+
+    return ESP_OK;
+}
+
+// Intersection of the overlapping intervals with the largest weight
+static void consensus_marzullo(const consensus_interval_t *intervals, size_t count, int64_t *low_us, int64_t *high_us)
+{
+    consensus_edge_t edges[2 * DS3231_CONSENSUS_MAX_SOURCES];
+    size_t edge_count = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        edges[edge_count++] = (consensus_edge_t){intervals[i].low_us, (int8_t)intervals[i].weight};
+        edges[edge_count++] = (consensus_edge_t){intervals[i].high_us, (int8_t)-intervals[i].weight};
+    }
+
+    // Insertion sort, a few dozen edges; a closing edge goes first, touching intervals do not overlap
+    for (size_t i = 1; i < edge_count; i++)
+    {
+        consensus_edge_t edge = edges[i];
+        size_t j = i;
+
+        while (j > 0 && (edges[j - 1].offset_us > edge.offset_us ||
+                         (edges[j - 1].offset_us == edge.offset_us && edges[j - 1].delta > edge.delta)))
+        {
+            edges[j] = edges[j - 1];
+            j--;
+        }
+        edges[j] = edge;
+    }
+
+    int32_t weight = 0;
+    int32_t best = 0;
+    for (size_t i = 0; i < edge_count; i++)
+    {
+        weight += edges[i].delta;
+        // Every opening edge is followed by at least its closing one
+        if (edges[i].delta > 0 && weight > best)
+        {
+            best = weight;
+            *low_us = edges[i].offset_us;
+            *high_us = edges[i + 1].offset_us;
+        }
+    }
+}
+
+// Weighted median of the interval centres, bounded by the agreeing interval furthest from it
+static void consensus_median(const consensus_interval_t *intervals, size_t count, int64_t *epoch_us, int64_t *bound_us)
+{
+    int64_t centres[DS3231_CONSENSUS_MAX_SOURCES];
+    uint8_t weights[DS3231_CONSENSUS_MAX_SOURCES];
+    uint32_t total = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int64_t centre = intervals[i].low_us + (intervals[i].high_us - intervals[i].low_us) / 2;
+        size_t j = i;
+
+        while (j > 0 && centres[j - 1] > centre)
+        {
+            centres[j] = centres[j - 1];
+            weights[j] = weights[j - 1];
+            j--;
+        }
+        centres[j] = centre;
+        weights[j] = intervals[i].weight;
+        total += intervals[i].weight;
+    }
+
+    uint32_t weight = 0;
+    size_t median = 0;
+    while (2 * (weight + weights[median]) < total)
+        weight += weights[median++];
+    *epoch_us = centres[median];
+
+    *bound_us = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        int64_t half_width = (intervals[i].high_us - intervals[i].low_us) / 2;
+        int64_t distance = llabs(intervals[i].low_us + half_width - *epoch_us);
+
+        if (distance <= DS3231_CONSENSUS_MEDIAN_LIMIT_US && distance + half_width > *bound_us)
+            *bound_us = distance + half_width;
+    }
+}
+
+esp_err_t ds3231_consensus_read(ds3231_consensus_t *consensus, ds3231_consensus_mode_t mode,
+                                ds3231_consensus_result_t *result)
+{
+    consensus_interval_t intervals[DS3231_CONSENSUS_MAX_SOURCES];
+    ds3231_consensus_result_t round = {0};
+    size_t count = 0;
+    uint32_t total = 0;
+
+    if (consensus == NULL || (mode != DS3231_CONSENSUS_MARZULLO && mode != DS3231_CONSENSUS_MEDIAN))
+        return ESP_ERR_INVALID_ARG;
+
+    if (consensus->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(consensus->lock, portMAX_DELAY);
+    if (consensus->count == 0)
+    {
+        xSemaphoreGive(consensus->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+
+    // Start the readers of the ports in use, each one gives done once
+    bool used[I2C_NUM_MAX] = {false};
+    uint32_t readers = 0;
+    for (size_t i = 0; i < consensus->count; i++)
+        used[consensus->sources[i]->port] = true;
+    for (i2c_port_t port = 0; port < I2C_NUM_MAX; port++)
+    {
+        if (used[port])
+        {
+            xTaskNotifyGive(consensus->readers[port]);
+            readers++;
+        }
+    }
+    while (readers-- > 0)
+        xSemaphoreTake(consensus->done, portMAX_DELAY);
+
+    // Common instant: the end of the last read
+    for (size_t i = 0; i < consensus->count; i++)
+        if (consensus->read_result[i] == ESP_OK && consensus->read_end_us[i] > round.mono_us)
+            round.mono_us = consensus->read_end_us[i];
+
+    for (size_t i = 0; i < consensus->count; i++)
+    {
+        const uint8_t *registers = consensus->registers[i];
+
+        if (consensus->read_result[i] != ESP_OK)
+        {
+            round.failed |= 1UL << i;
+            continue;
+        }
+
+        bool osf = registers[DS3231_STATUS_REGISTER_ADDRESS] & DS3231_STATUS_OSF;
+        int64_t seconds_us = ds3231_regs_to_epoch(registers) * CONSENSUS_SECOND_US;
+
+        // The registers were latched between the start and the end of the read, the second had begun
+        intervals[count] = (consensus_interval_t){
+            .low_us = seconds_us + (round.mono_us - consensus->read_end_us[i]),
+            .high_us = seconds_us + CONSENSUS_SECOND_US + (round.mono_us - consensus->read_start_us[i]),
+            .weight = osf ? DS3231_CONSENSUS_OSF_WEIGHT : DS3231_CONSENSUS_WEIGHT,
+            .source = (uint8_t)i};
+        total += intervals[count].weight;
+        count++;
+        if (osf)
+            round.osf |= 1UL << i;
+    }
+    xSemaphoreGive(consensus->lock);
+
+    round.sources = (uint8_t)count;
+    if (count == 0)
+    {
+        round.latency_us = (uint32_t)(esp_timer_get_time() - start_us);
+        if (result != NULL)
+            *result = round;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (mode == DS3231_CONSENSUS_MARZULLO)
+    {
+        int64_t low_us = 0, high_us = 0;
+
+        consensus_marzullo(intervals, count, &low_us, &high_us);
+        round.epoch_us = low_us + (high_us - low_us) / 2;
+        round.bound_us = (high_us - low_us + 1) / 2;
+    }
+    else
+    {
+        consensus_median(intervals, count, &round.epoch_us, &round.bound_us);
+    }
+
+    // Agreeing sources allow the result, the others are outliers
+    uint32_t weight = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        bool agrees = mode == DS3231_CONSENSUS_MARZULLO
+                          ? intervals[i].low_us <= round.epoch_us && round.epoch_us < intervals[i].high_us
+                          : llabs(intervals[i].low_us + (intervals[i].high_us - intervals[i].low_us) / 2 -
+                                  round.epoch_us) <= DS3231_CONSENSUS_MEDIAN_LIMIT_US;
+        if (agrees)
+        {
+            round.agreeing++;
+            weight += intervals[i].weight;
+        }
+        else
+        {
+            round.outliers |= 1UL << intervals[i].source;
+        }
+    }
+    round.latency_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    if (result != NULL)
+        *result = round;
+
+    if (2 * weight <= total)
+    {
+        ESP_LOGW(DS3231_TAG, "No consensus: %u of %u sources agree", round.agreeing, round.sources);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    portENTER_CRITICAL(&consensus->result_lock);
+    consensus->result = round;
+    consensus->published = true;
+    portEXIT_CRITICAL(&consensus->result_lock);
+
+    return ESP_OK;
+}
+
+bool ds3231_consensus_get(ds3231_consensus_t *consensus, ds3231_consensus_result_t *result)
+{
+    if (consensus == NULL || result == NULL)
+        return false;
+
+    portENTER_CRITICAL(&consensus->result_lock);
+    bool published = consensus->published;
+    *result = consensus->result;
+    portEXIT_CRITICAL(&consensus->result_lock);
+
+    return published;
+}
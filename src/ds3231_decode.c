@@ -0,0 +1,193 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_decode.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DECODE_LANES 4
+#define DECODE_IMPL "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DECODE_LANES 2
+#define DECODE_IMPL "sse2"
+#else
+#define DECODE_LANES 1
+#define DECODE_IMPL "swar"
+#endif
+
+// Everything but the time, the same for both decoders
+static inline void decode_status(const uint8_t *dump, size_t i, const ds3231_decode_out_t *out)
+{
+    out->temp_q[i] = (int16_t)((int8_t)dump[DS3231_ADDRESS_TEMPERATURE] * 4 + (dump[DS3231_ADDRESS_TEMPERATURE + 1] >> 6));
+    out->osf[i] = (dump[DS3231_STATUS_REGISTER_ADDRESS] & DS3231_STATUS_OSF) != 0;
+    out->alarm_flags[i] = dump[DS3231_STATUS_REGISTER_ADDRESS] & (DS3231_STATUS_A1F | DS3231_STATUS_A2F);
+}
+
+static bool decode_args_valid(const uint8_t *dumps, size_t count, const ds3231_decode_out_t *out)
+{
+    return out != NULL && (count == 0 || (dumps != NULL && out->epoch != NULL && out->temp_q != NULL &&
+                                          out->osf != NULL && out->alarm_flags != NULL));
+}
+
+#if DECODE_LANES > 1
+// Registers 0 - 7 of a dump, x86 is little endian like the masks
+static inline long long decode_load_time(const uint8_t *dump)
+{
+    uint64_t value;
+
+    memcpy(&value, dump, sizeof(value));
+
+    return (long long)value;
+}
+#endif
+
+#if defined(__AVX2__)
+// The 64 bit word of ds3231_bcd_unpack_time() for four dumps, one per lane
+static inline void decode_unpack(const uint8_t *dump, uint8_t digits[DECODE_LANES][8])
+{
+    const __m256i mask = _mm256_set1_epi64x((long long)DS3231_TIME_DIGIT_MASK);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i value = _mm256_set_epi64x(decode_load_time(dump + 3 * DS3231_REGISTER_COUNT),
+                                      decode_load_time(dump + 2 * DS3231_REGISTER_COUNT),
+                                      decode_load_time(dump + DS3231_REGISTER_COUNT), decode_load_time(dump));
+    value = _mm256_and_si256(value, mask);
+    // Tens digits are at most 0x0F, shifted left they stay within their byte
+    __m256i tens = _mm256_and_si256(_mm256_srli_epi16(value, 4), nibble);
+    value = _mm256_sub_epi8(value, _mm256_add_epi8(_mm256_slli_epi16(tens, 2), _mm256_slli_epi16(tens, 1)));
+    _mm256_storeu_si256((__m256i *)digits, value);
+}
+#elif defined(__SSE2__)
+// The 64 bit word of ds3231_bcd_unpack_time() for two dumps, one per lane
+static inline void decode_unpack(const uint8_t *dump, uint8_t digits[DECODE_LANES][8])
+{
+    const __m128i mask = _mm_set1_epi64x((long long)DS3231_TIME_DIGIT_MASK);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    __m128i value = _mm_set_epi64x(decode_load_time(dump + DS3231_REGISTER_COUNT), decode_load_time(dump));
+    value = _mm_and_si128(value, mask);
+    __m128i tens = _mm_and_si128(_mm_srli_epi16(value, 4), nibble);
+    value = _mm_sub_epi8(value, _mm_add_epi8(_mm_slli_epi16(tens, 2), _mm_slli_epi16(tens, 1)));
+    _mm_storeu_si128((__m128i *)digits, value);
+}
+#endif
+
+esp_err_t ds3231_decode_batch(const uint8_t *dumps, size_t count, const ds3231_decode_out_t *out)
+{
+    uint8_t digits[DECODE_LANES][8];
+    size_t i = 0;
+
+    if (!decode_args_valid(dumps, count, out))
+        return ESP_ERR_INVALID_ARG;
+
+#if DECODE_LANES > 1
+    for (; i + DECODE_LANES <= count; i += DECODE_LANES)
+    {
+        const uint8_t *dump = dumps + i * DS3231_REGISTER_COUNT;
+
+        decode_unpack(dump, digits);
+        for (int lane = 0; lane < DECODE_LANES; lane++, dump += DS3231_REGISTER_COUNT)
+        {
+            out->epoch[i + lane] = ds3231_time_to_epoch(dump, digits[lane]);
+            decode_status(dump, i + lane, out);
+        }
+    }
+#endif
+
+    // The rest of the lanes, everything without SIMD
+    for (; i < count; i++)
+    {
+        const uint8_t *dump = dumps + i * DS3231_REGISTER_COUNT;
+
+        ds3231_bcd_unpack_time(dump, digits[0]);
+        out->epoch[i] = ds3231_time_to_epoch(dump, digits[0]);
+        decode_status(dump, i, out);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_decode_batch_scalar(const uint8_t *dumps, size_t count, const ds3231_decode_out_t *out)
+{
+    uint8_t digits[7];
+
+    if (!decode_args_valid(dumps, count, out))
+        return ESP_ERR_INVALID_ARG;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t *dump = dumps + i * DS3231_REGISTER_COUNT;
+
+        digits[0] = bcd2dec(dump[0] & 0x7F);
+        digits[1] = bcd2dec(dump[1] & 0x7F);
+        digits[2] = bcd2dec(dump[2] & 0x3F);
+        digits[3] = bcd2dec(dump[3] & 0x07);
+        digits[4] = bcd2dec(dump[4] & 0x3F);
+        digits[5] = bcd2dec(dump[5] & DS3231_MONTH_MASK);
+        digits[6] = bcd2dec(dump[6]);
+        out->epoch[i] = ds3231_time_to_epoch(dump, digits);
+        decode_status(dump, i, out);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_decode_verify(const uint8_t *dumps, size_t count, size_t *mismatches)
+{
+    int64_t epoch[2][DS3231_DECODE_VERIFY_CHUNK];
+    int16_t temp_q[2][DS3231_DECODE_VERIFY_CHUNK];
+    uint8_t osf[2][DS3231_DECODE_VERIFY_CHUNK];
+    uint8_t alarm_flags[2][DS3231_DECODE_VERIFY_CHUNK];
+    ds3231_decode_out_t out[2];
+
+    if (mismatches == NULL || (dumps == NULL && count > 0))
+        return ESP_ERR_INVALID_ARG;
+
+    for (int k = 0; k < 2; k++)
+        out[k] = (ds3231_decode_out_t){.epoch = epoch[k], .temp_q = temp_q[k], .osf = osf[k], .alarm_flags = alarm_flags[k]};
+
+    *mismatches = 0;
+    for (size_t i = 0; i < count; i += DS3231_DECODE_VERIFY_CHUNK)
+    {
+        size_t chunk = count - i < DS3231_DECODE_VERIFY_CHUNK ? count - i : DS3231_DECODE_VERIFY_CHUNK;
+        const uint8_t *dump = dumps + i * DS3231_REGISTER_COUNT;
+
+        ds3231_decode_batch(dump, chunk, &out[0]);
+        ds3231_decode_batch_scalar(dump, chunk, &out[1]);
+        for (size_t j = 0; j < chunk; j++)
+            if (epoch[0][j] != epoch[1][j] || temp_q[0][j] != temp_q[1][j] || osf[0][j] != osf[1][j] ||
+                alarm_flags[0][j] != alarm_flags[1][j])
+                (*mismatches)++;
+    }
+
+    return ESP_OK;
+}
+
+const char *ds3231_decode_impl(void)
+{
+    return DECODE_IMPL;
+}
@@ -0,0 +1,160 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_epoch.h"
+
+#define EPOCH_DAY_SECONDS 86400
+
+// Days from 1970-01-01 to year-month-day of the proleptic Gregorian calendar
+// (H. Hinnant, "chrono-Compatible Low-Level Date Algorithms"). year >= 1970.
+static int64_t epoch_days_from_civil(int32_t year, uint32_t month, uint32_t day)
+{
+    year -= month <= 2;
+    const int32_t era = year / 400;
+    const uint32_t yoe = (uint32_t)(year - era * 400);                              // [0, 399]
+    const uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; // [0, 365]
+    const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                     // [0, 146096]
+
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+static void epoch_civil_from_days(int64_t days, int32_t *year, uint32_t *month, uint32_t *day)
+{
+    days += 719468;
+    const int32_t era = (int32_t)(days / 146097);
+    const uint32_t doe = (uint32_t)(days - (int64_t)era * 146097);               // [0, 146096]
+    const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                // [0, 365]
+    const uint32_t mp = (5 * doy + 2) / 153;                                     // [0, 11]
+
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (int32_t)yoe + era * 400 + (*month <= 2);
+}
+
+// bcd2dec() of every byte: value - 6 * tens digit, without a carry between the bytes
+void ds3231_bcd_unpack_time(const uint8_t *regs, uint8_t *digits)
+{
+    uint64_t value = 0;
+
+    for (int i = 0; i < 7; i++)
+        value |= (uint64_t)regs[i] << (8 * i);
+    value &= DS3231_TIME_DIGIT_MASK;
+
+    uint64_t tens = (value >> 4) & 0x0F0F0F0F0F0F0F0FULL;
+    value -= (tens << 2) + (tens << 1);
+
+    for (int i = 0; i < 7; i++)
+        digits[i] = (uint8_t)(value >> (8 * i));
+}
+
+int64_t ds3231_time_to_epoch(const uint8_t *regs, const uint8_t *digits)
+{
+    uint32_t hour = digits[2];
+
+    if (regs[2] & DS3231_12HOUR_FLAG)
+    {
+        // The PM flag is the 20 hours bit in 24 hour mode. 12 AM is hour 0, 12 PM is hour 12.
+        if (regs[2] & DS3231_PM_FLAG)
+            hour = (hour - 20) % 12 + 12;
+        else
+            hour %= 12;
+    }
+
+    int32_t year = 2000 + digits[6] + ((regs[5] & DS3231_CENTURY_FLAG) ? 100 : 0);
+    int64_t days = epoch_days_from_civil(year, digits[5], digits[4]);
+
+    return days * EPOCH_DAY_SECONDS + hour * 3600 + digits[1] * 60 + digits[0];
+}
+
+int64_t ds3231_regs_to_epoch(const uint8_t *regs)
+{
+    uint8_t digits[7];
+
+    ds3231_bcd_unpack_time(regs, digits);
+
+    return ds3231_time_to_epoch(regs, digits);
+}
+
+esp_err_t ds3231_epoch_to_regs(int64_t epoch, uint8_t *regs)
+{
+    if (epoch < DS3231_EPOCH_MIN || epoch > DS3231_EPOCH_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    int64_t days = epoch / EPOCH_DAY_SECONDS;
+    uint32_t seconds = (uint32_t)(epoch - days * EPOCH_DAY_SECONDS);
+    int32_t year;
+    uint32_t month;
+    uint32_t day;
+
+    epoch_civil_from_days(days, &year, &month, &day);
+
+    regs[0] = dec2bcd(seconds % 60);
+    regs[1] = dec2bcd((seconds / 60) % 60);
+    regs[2] = dec2bcd(seconds / 3600);
+    // 1970-01-01 was a Thursday, 1 - Sunday
+    regs[3] = (uint8_t)((days + 4) % 7 + 1);
+    regs[4] = dec2bcd(day);
+    regs[5] = dec2bcd(month) | (year >= 2100 ? DS3231_CENTURY_FLAG : 0);
+    regs[6] = dec2bcd(year % 100);
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_dev_get_epoch(ds3231_dev_t *dev, int64_t *epoch)
+{
+    uint8_t regs[7];
+
+    if (epoch == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t result = ds3231_dev_read_data(dev, DS3231_TIME_ADDRESS, 1, regs, 7);
+    if (result == ESP_OK)
+        *epoch = ds3231_regs_to_epoch(regs);
+
+    return result;
+}
+
+esp_err_t ds3231_get_epoch(int64_t *epoch)
+{
+    return ds3231_dev_get_epoch(&ds3231_default_dev, epoch);
+}
+
+esp_err_t ds3231_dev_set_epoch(ds3231_dev_t *dev, int64_t epoch)
+{
+    uint8_t regs[7];
+
+    esp_err_t result = ds3231_epoch_to_regs(epoch, regs);
+    if (result != ESP_OK)
+        return result;
+
+    return ds3231_dev_write_data(dev, DS3231_TIME_ADDRESS, 1, regs, 7);
+}
+
+esp_err_t ds3231_set_epoch(int64_t epoch)
+{
+    return ds3231_dev_set_epoch(&ds3231_default_dev, epoch);
+}
@@ -0,0 +1,253 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_format.h"
+
+#include <stdatomic.h>
+
+typedef enum
+{
+  FMT_OP_LITERAL, // arg: character
+  FMT_OP_BCD,     // arg: register index, two digits of the register
+  FMT_OP_CENTURY, // "20" or "21" from the century bit
+  FMT_OP_HOUR24,
+  FMT_OP_HOUR12,
+  FMT_OP_AMPM,
+  FMT_OP_WEEKDAY  // ISO day of the week from the day register (1 - Sunday)
+} fmt_op_t;
+
+// Register masks of the BCD fields
+static const uint8_t fmt_reg_mask[7] = {0x7F, 0x7F, 0x3F, 0x07, 0x3F, DS3231_MONTH_MASK, 0xFF};
+
+// 12 hour register (index: PM flag, hour 1-12) -> 24 hour BCD
+static const uint8_t fmt_hour12_to_24[2][13] = {
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x00},
+    {0x00, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x12}};
+
+// 24 hour (0-23) -> 12 hour BCD
+static const uint8_t fmt_hour24_to_12[24] = {
+    0x12, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11,
+    0x12, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11};
+
+// Day register (1 - Sunday ... 7 - Saturday) -> strftime %u (1 - Monday ... 7 - Sunday)
+static const char fmt_iso_weekday[8] = {'7', '7', '1', '2', '3', '4', '5', '6'};
+
+// Length of the output of every op
+static const uint8_t fmt_op_length[] = {1, 2, 2, 2, 2, 2, 1};
+
+// The built-in formats, compiled ahead so that reading them needs no lock
+#define FMT_LIT(c) FMT_OP_LITERAL, (c)
+#define FMT_DATE FMT_OP_CENTURY, 0, FMT_OP_BCD, 6, FMT_LIT('-'), FMT_OP_BCD, 5, FMT_LIT('-'), FMT_OP_BCD, 4
+#define FMT_TIME_24 FMT_OP_HOUR24, 2, FMT_LIT(':'), FMT_OP_BCD, 1, FMT_LIT(':'), FMT_OP_BCD, 0
+#define FMT_TIME_AM_PM \
+  FMT_OP_HOUR12, 2, FMT_LIT(':'), FMT_OP_BCD, 1, FMT_LIT(':'), FMT_OP_BCD, 0, FMT_LIT(' '), FMT_OP_AMPM, 2
+
+static const ds3231_format_t fmt_builtin[UNIX_TIMESTAMPS] = {
+    [DATE_AND_TIME_24] = {{FMT_DATE, FMT_LIT(' '), FMT_TIME_24}, 12, 19},        // "%Y-%m-%d %H:%M:%S"
+    [DATE_AND_TIME_AM_PM] = {{FMT_DATE, FMT_LIT(' '), FMT_TIME_AM_PM}, 14, 22},  // "%Y-%m-%d %I:%M:%S %p"
+    [ONLY_DATE] = {{FMT_DATE}, 6, 10},                                          // "%Y-%m-%d"
+    [ONLY_TIME_24] = {{FMT_TIME_24}, 5, 8},                                     // "%H:%M:%S"
+    [ONLY_TIME_AM_PM] = {{FMT_TIME_AM_PM}, 7, 11}};                             // "%I:%M:%S %p"
+
+// Registration writes a slot under fmt_lock and then publishes it with the count, readers take no lock
+static portMUX_TYPE fmt_lock = portMUX_INITIALIZER_UNLOCKED;
+static ds3231_format_t fmt_custom[DS3231_FORMAT_MAX_CUSTOM];
+static _Atomic uint8_t fmt_custom_count;
+
+static esp_err_t fmt_add_op(ds3231_format_t *format, fmt_op_t op, uint8_t arg)
+{
+    if (format->op_count >= DS3231_FORMAT_MAX_OPS || format->length + fmt_op_length[op] > UINT8_MAX - 1)
+        return ESP_ERR_INVALID_SIZE;
+
+    format->ops[format->op_count * 2] = op;
+    format->ops[format->op_count * 2 + 1] = arg;
+    format->op_count++;
+    format->length += fmt_op_length[op];
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_format_compile(const char *spec, ds3231_format_t *format)
+{
+    if (spec == NULL || format == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(format, 0, sizeof(*format));
+
+    for (const char *p = spec; *p != '\0'; p++)
+    {
+        esp_err_t result;
+
+        if (*p != '%')
+        {
+            result = fmt_add_op(format, FMT_OP_LITERAL, (uint8_t)*p);
+        }
+        else
+        {
+            switch (*++p)
+            {
+            case 'Y':
+                result = fmt_add_op(format, FMT_OP_CENTURY, 0);
+                if (result == ESP_OK)
+                    result = fmt_add_op(format, FMT_OP_BCD, 6);
+                break;
+            case 'y':
+                result = fmt_add_op(format, FMT_OP_BCD, 6);
+                break;
+            case 'm':
+                result = fmt_add_op(format, FMT_OP_BCD, 5);
+                break;
+            case 'd':
+                result = fmt_add_op(format, FMT_OP_BCD, 4);
+                break;
+            case 'u':
+                result = fmt_add_op(format, FMT_OP_WEEKDAY, 3);
+                break;
+            case 'H':
+                result = fmt_add_op(format, FMT_OP_HOUR24, 2);
+                break;
+            case 'I':
+                result = fmt_add_op(format, FMT_OP_HOUR12, 2);
+                break;
+            case 'M':
+                result = fmt_add_op(format, FMT_OP_BCD, 1);
+                break;
+            case 'S':
+                result = fmt_add_op(format, FMT_OP_BCD, 0);
+                break;
+            case 'p':
+                result = fmt_add_op(format, FMT_OP_AMPM, 2);
+                break;
+            case '%':
+                result = fmt_add_op(format, FMT_OP_LITERAL, '%');
+                break;
+            default:
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+
+        if (result != ESP_OK)
+            return result;
+    }
+
+    return ESP_OK;
+}
+
+static inline void fmt_put_bcd(char *out, uint8_t value)
+{
+    out[0] = '0' + (value >> 4);
+    out[1] = '0' + (value & 0x0F);
+}
+
+size_t ds3231_format_render(const ds3231_format_t *format, const uint8_t *regs, char *str_buffer, size_t buffer_size)
+{
+    if (buffer_size <= format->length)
+        return 0;
+
+    // Hour register in 24 hour BCD whichever mode the chip runs in
+    uint8_t hour24 = regs[2] & 0x3F;
+    if (regs[2] & DS3231_12HOUR_FLAG)
+        hour24 = fmt_hour12_to_24[(regs[2] & DS3231_PM_FLAG) != 0][bcd2dec(regs[2] & DS3231_12HOUR_MASK) % 13];
+
+    char *out = str_buffer;
+    const uint8_t *op = format->ops;
+    const uint8_t *end = op + format->op_count * 2;
+
+    for (; op < end; op += 2)
+    {
+        switch ((fmt_op_t)op[0])
+        {
+        case FMT_OP_LITERAL:
+            *out++ = (char)op[1];
+            break;
+        case FMT_OP_BCD:
+            fmt_put_bcd(out, regs[op[1]] & fmt_reg_mask[op[1]]);
+            out += 2;
+            break;
+        case FMT_OP_CENTURY:
+            *out++ = '2';
+            *out++ = (regs[5] & DS3231_CENTURY_FLAG) ? '1' : '0';
+            break;
+        case FMT_OP_HOUR24:
+            fmt_put_bcd(out, hour24);
+            out += 2;
+            break;
+        case FMT_OP_HOUR12:
+            fmt_put_bcd(out, fmt_hour24_to_12[bcd2dec(hour24) % 24]);
+            out += 2;
+            break;
+        case FMT_OP_AMPM:
+            *out++ = hour24 >= 0x12 ? 'P' : 'A';
+            *out++ = 'M';
+            break;
+        case FMT_OP_WEEKDAY:
+            *out++ = fmt_iso_weekday[regs[op[1]] & 0x07];
+            break;
+        }
+    }
+
+    *out = '\0';
+
+    return out - str_buffer;
+}
+
+const ds3231_format_t *ds3231_format_get(date_time_format dt_format)
+{
+    if (dt_format < UNIX_TIMESTAMPS)
+        return &fmt_builtin[dt_format];
+
+    uint8_t count = atomic_load_explicit(&fmt_custom_count, memory_order_acquire);
+    if ((int)dt_format >= DATE_TIME_CUSTOM && (int)dt_format < DATE_TIME_CUSTOM + count)
+        return &fmt_custom[dt_format - DATE_TIME_CUSTOM];
+
+    return NULL;
+}
+
+esp_err_t ds3231_format_register(const char *spec, date_time_format *dt_format)
+{
+    ds3231_format_t format;
+
+    if (dt_format == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t result = ds3231_format_compile(spec, &format);
+    if (result != ESP_OK)
+        return result;
+
+    portENTER_CRITICAL(&fmt_lock);
+    uint8_t count = atomic_load_explicit(&fmt_custom_count, memory_order_relaxed);
+    if (count >= DS3231_FORMAT_MAX_CUSTOM)
+    {
+        portEXIT_CRITICAL(&fmt_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    fmt_custom[count] = format;
+    *dt_format = (date_time_format)(DATE_TIME_CUSTOM + count);
+    atomic_store_explicit(&fmt_custom_count, count + 1, memory_order_release);
+    portEXIT_CRITICAL(&fmt_lock);
+
+    return ESP_OK;
+}
@@ -0,0 +1,423 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_log.h"
+#include "ds3231_proto.h"
+#include "ds3231_snapshot.h"
+#include "ds3231_time_service.h"
+
+#include <stdio.h>
+#include <esp_partition.h>
+
+#define LOG_CAPACITY (DS3231_LOG_PAGE_SIZE - DS3231_LOG_PAGE_HEADER_SIZE - DS3231_LOG_PAGE_CRC_SIZE)
+#define LOG_MAX_VARINT 10  // Bytes of a 64 bit varint
+#define LOG_MIN_RECORD 3   // Delta, event id and size
+#define LOG_MAX_RECORD (LOG_MAX_VARINT + 2 + DS3231_LOG_MAX_PAYLOAD)
+
+static void log_put_le(uint8_t *dst, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        dst[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t log_get_le(const uint8_t *src, size_t size)
+{
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < size; i++)
+        value |= (uint64_t)src[i] << (8 * i);
+
+    return value;
+}
+
+// Zigzag keeps small negative deltas (the clock was set back) short: 0, -1, 1, -2... -> 0, 1, 2, 3...
+static size_t log_put_varint(uint8_t *dst, int64_t value)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t size = 0;
+
+    while (zigzag >= 0x80)
+    {
+        dst[size++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    dst[size++] = (uint8_t)zigzag;
+
+    return size;
+}
+
+static size_t log_encode(uint8_t *dst, int64_t delta, uint8_t event, const void *data, size_t size)
+{
+    size_t length = log_put_varint(dst, delta);
+
+    dst[length++] = event;
+    dst[length++] = (uint8_t)size;
+    if (size > 0)
+        memcpy(dst + length, data, size);
+
+    return length + size;
+}
+
+// A page counts when its magic, size and CRC are right, sets *seq
+static bool log_page_valid(const uint8_t *page, uint32_t *seq)
+{
+    uint16_t used = (uint16_t)log_get_le(page + 2, 2);
+
+    if (log_get_le(page, 2) != DS3231_LOG_MAGIC || used > LOG_CAPACITY)
+        return false;
+    if (ds3231_proto_crc16(page, DS3231_LOG_PAGE_HEADER_SIZE + used) !=
+        log_get_le(page + DS3231_LOG_PAGE_HEADER_SIZE + used, DS3231_LOG_PAGE_CRC_SIZE))
+        return false;
+
+    *seq = (uint32_t)log_get_le(page + 4, 4);
+    return true;
+}
+
+static bool log_page_erased(const uint8_t *page)
+{
+    for (size_t i = 0; i < DS3231_LOG_PAGE_SIZE; i++)
+        if (page[i] != 0xFF)
+            return false;
+
+    return true;
+}
+
+static uint32_t log_next_sector(const ds3231_log_t *log, uint32_t offset)
+{
+    offset = (offset / DS3231_LOG_SECTOR_SIZE + 1) * DS3231_LOG_SECTOR_SIZE;
+
+    return offset < log->storage.size ? offset : 0;
+}
+
+// Called with the lock held. The page buffer is empty afterwards, also when the write failed.
+static esp_err_t log_write_page(ds3231_log_t *log)
+{
+    esp_err_t result = ESP_OK;
+    uint8_t *page = log->page;
+
+    if (log->used == 0)
+        return ESP_OK;
+
+    log_put_le(page, DS3231_LOG_MAGIC, 2);
+    log_put_le(page + 2, log->used, 2);
+    log_put_le(page + 4, log->stats.next_seq, 4);
+    // The base epoch was stored with the first record
+    uint16_t end = DS3231_LOG_PAGE_HEADER_SIZE + log->used;
+    log_put_le(page + end, ds3231_proto_crc16(page, end), DS3231_LOG_PAGE_CRC_SIZE);
+    memset(page + end + DS3231_LOG_PAGE_CRC_SIZE, 0xFF, DS3231_LOG_PAGE_SIZE - end - DS3231_LOG_PAGE_CRC_SIZE);
+
+    // Sectors are erased when the ring reaches them, the oldest pages go first
+    if (log->offset % DS3231_LOG_SECTOR_SIZE == 0)
+    {
+        result = log->storage.erase(log->storage.ctx, log->offset, DS3231_LOG_SECTOR_SIZE);
+        if (result == ESP_OK)
+            log->stats.erases++;
+    }
+    if (result == ESP_OK)
+    {
+        result = log->storage.write(log->storage.ctx, log->offset, page, DS3231_LOG_PAGE_SIZE);
+        log->stats.page_writes++;
+    }
+
+    if (result == ESP_OK)
+    {
+        log->offset = (log->offset + DS3231_LOG_PAGE_SIZE) % log->storage.size;
+    }
+    else
+    {
+        // The sector is in an unknown state now, continue in a freshly erased one
+        ESP_LOGE(DS3231_TAG, "Event log page %u lost: %d (%s)", log->stats.next_seq, result, esp_err_to_name(result));
+        log->stats.dropped += log->events;
+        log->offset = log_next_sector(log, log->offset);
+    }
+
+    log->stats.next_seq++;
+    log->used = 0;
+    log->events = 0;
+
+    return result;
+}
+
+esp_err_t ds3231_log_append_at(ds3231_log_t *log, int64_t epoch, uint8_t event, const void *data, size_t size)
+{
+    uint8_t record[LOG_MAX_RECORD];
+    esp_err_t result = ESP_OK;
+
+    if (log == NULL || (data == NULL && size > 0) || size > DS3231_LOG_MAX_PAYLOAD)
+        return ESP_ERR_INVALID_ARG;
+    if (log->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(log->lock, portMAX_DELAY);
+
+    size_t length = log_encode(record, log->used > 0 ? epoch - log->last_epoch : 0, event, data, size);
+    if (log->used + length > LOG_CAPACITY)
+    {
+        result = log_write_page(log);
+        length = log_encode(record, 0, event, data, size);
+    }
+
+    if (log->used == 0)
+        log_put_le(log->page + 8, (uint64_t)epoch, 8);
+    memcpy(log->page + DS3231_LOG_PAGE_HEADER_SIZE + log->used, record, length);
+    log->used += length;
+    log->events++;
+    log->last_epoch = epoch;
+    log->stats.events++;
+    log->stats.record_bytes += length;
+
+    // Full: not even an empty record fits any more
+    if (LOG_CAPACITY - log->used < LOG_MIN_RECORD)
+    {
+        esp_err_t write_result = log_write_page(log);
+        if (result == ESP_OK)
+            result = write_result;
+    }
+
+    xSemaphoreGive(log->lock);
+
+    return result;
+}
+
+esp_err_t ds3231_log_append(ds3231_log_t *log, uint8_t event, const void *data, size_t size)
+{
+    int64_t epoch_us;
+
+    // Lock free when the snapshot task runs, no bus access most of the time otherwise
+    esp_err_t result = ds3231_snapshot_get_time_us(&epoch_us);
+    if (result == ESP_ERR_INVALID_STATE)
+        result = ds3231_ts_get_time(&epoch_us);
+    if (result != ESP_OK)
+        return result;
+
+    return ds3231_log_append_at(log, epoch_us / 1000000, event, data, size);
+}
+
+esp_err_t ds3231_log_flush(ds3231_log_t *log)
+{
+    if (log == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (log->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(log->lock, portMAX_DELAY);
+    esp_err_t result = log_write_page(log);
+    xSemaphoreGive(log->lock);
+
+    return result;
+}
+
+esp_err_t ds3231_log_get_stats(ds3231_log_t *log, ds3231_log_stats_t *stats)
+{
+    if (log == NULL || stats == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (log->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(log->lock, portMAX_DELAY);
+    *stats = log->stats;
+    stats->buffered = log->used;
+    xSemaphoreGive(log->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_log_init(ds3231_log_t *log, const ds3231_log_storage_t *storage)
+{
+    uint32_t seq, last_seq = 0, last_offset = 0;
+    bool found = false;
+
+    if (log == NULL || storage == NULL || storage->read == NULL || storage->write == NULL || storage->erase == NULL ||
+        storage->size % DS3231_LOG_SECTOR_SIZE != 0 || storage->size < 2 * DS3231_LOG_SECTOR_SIZE)
+        return ESP_ERR_INVALID_ARG;
+
+    if (log->lock == NULL)
+    {
+#if DS3231_STATIC_ALLOCATION
+        log->lock = xSemaphoreCreateMutexStatic(&log->lock_buffer);
+#else
+        log->lock = xSemaphoreCreateMutex();
+#endif
+        if (log->lock == NULL)
+            return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(log->lock, portMAX_DELAY);
+
+    log->storage = *storage;
+    log->used = 0;
+    log->events = 0;
+    log->stats = (ds3231_log_stats_t){0};
+
+    // The newest page is the one with the highest sequence number, compared modulo 2^32
+    esp_err_t result = ESP_OK;
+    for (uint32_t offset = 0; result == ESP_OK && offset < storage->size; offset += DS3231_LOG_PAGE_SIZE)
+    {
+        // Only pages with the magic are read completely
+        result = storage->read(storage->ctx, offset, log->page, DS3231_LOG_PAGE_HEADER_SIZE);
+        if (result != ESP_OK || log_get_le(log->page, 2) != DS3231_LOG_MAGIC)
+            continue;
+        result = storage->read(storage->ctx, offset + DS3231_LOG_PAGE_HEADER_SIZE,
+                               log->page + DS3231_LOG_PAGE_HEADER_SIZE,
+                               DS3231_LOG_PAGE_SIZE - DS3231_LOG_PAGE_HEADER_SIZE);
+        if (result == ESP_OK && log_page_valid(log->page, &seq) && (!found || (int32_t)(seq - last_seq) > 0))
+        {
+            last_seq = seq;
+            last_offset = offset;
+            found = true;
+        }
+    }
+
+    if (result == ESP_OK)
+    {
+        log->offset = found ? (last_offset + DS3231_LOG_PAGE_SIZE) % storage->size : 0;
+        log->stats.next_seq = found ? last_seq + 1 : 1;
+
+        // Within a sector the next page has to be erased still, a write cut short by a reset is not
+        if (log->offset % DS3231_LOG_SECTOR_SIZE != 0)
+        {
+            result = storage->read(storage->ctx, log->offset, log->page, DS3231_LOG_PAGE_SIZE);
+            if (result == ESP_OK && !log_page_erased(log->page))
+                log->offset = log_next_sector(log, log->offset);
+        }
+    }
+
+    if (result == ESP_OK)
+        ESP_LOGI(DS3231_TAG, "Event log: %u bytes, continues with page %u at 0x%x", storage->size,
+                 log->stats.next_seq, log->offset);
+
+    xSemaphoreGive(log->lock);
+
+    return result;
+}
+
+static esp_err_t log_partition_read(void *ctx, uint32_t offset, void *buffer, size_t size)
+{
+    return esp_partition_read(ctx, offset, buffer, size);
+}
+
+static esp_err_t log_partition_write(void *ctx, uint32_t offset, const void *buffer, size_t size)
+{
+    return esp_partition_write(ctx, offset, buffer, size);
+}
+
+static esp_err_t log_partition_erase(void *ctx, uint32_t offset, size_t size)
+{
+    return esp_partition_erase_range(ctx, offset, size);
+}
+
+esp_err_t ds3231_log_partition_storage(ds3231_log_storage_t *storage, const char *label)
+{
+    if (storage == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    const esp_partition_t *partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label != NULL ? label : DS3231_LOG_PARTITION_LABEL);
+    if (partition == NULL)
+        return ESP_ERR_NOT_FOUND;
+
+    *storage = (ds3231_log_storage_t){
+        .read = log_partition_read,
+        .write = log_partition_write,
+        .erase = log_partition_erase,
+        .size = partition->size - partition->size % DS3231_LOG_SECTOR_SIZE,
+        .ctx = (void *)partition};
+
+    return ESP_OK;
+}
+
+static esp_err_t log_file_read(void *ctx, uint32_t offset, void *buffer, size_t size)
+{
+    if (fseek(ctx, offset, SEEK_SET) != 0 || fread(buffer, 1, size, ctx) != size)
+        return ESP_FAIL;
+
+    return ESP_OK;
+}
+
+static esp_err_t log_file_write(void *ctx, uint32_t offset, const void *buffer, size_t size)
+{
+    if (fseek(ctx, offset, SEEK_SET) != 0 || fwrite(buffer, 1, size, ctx) != size || fflush(ctx) != 0)
+        return ESP_FAIL;
+
+    return ESP_OK;
+}
+
+// Erased flash reads as 0xFF
+static esp_err_t log_file_fill(FILE *file, uint32_t offset, size_t size)
+{
+    uint8_t erased[64];
+
+    memset(erased, 0xFF, sizeof(erased));
+    if (fseek(file, offset, SEEK_SET) != 0)
+        return ESP_FAIL;
+    while (size > 0)
+    {
+        size_t chunk = size < sizeof(erased) ? size : sizeof(erased);
+        if (fwrite(erased, 1, chunk, file) != chunk)
+            return ESP_FAIL;
+        size -= chunk;
+    }
+
+    return fflush(file) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t log_file_erase(void *ctx, uint32_t offset, size_t size)
+{
+    return log_file_fill(ctx, offset, size);
+}
+
+esp_err_t ds3231_log_file_storage(ds3231_log_storage_t *storage, const char *path, uint32_t size)
+{
+    if (storage == NULL || path == NULL || size == 0 || size % DS3231_LOG_SECTOR_SIZE != 0)
+        return ESP_ERR_INVALID_ARG;
+
+    FILE *file = fopen(path, "r+b");
+    if (file == NULL)
+        file = fopen(path, "w+b");
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0)
+    {
+        ESP_LOGE(DS3231_TAG, "Cannot open the event log file %s", path);
+        if (file != NULL)
+            fclose(file);
+        return ESP_FAIL;
+    }
+
+    long length = ftell(file);
+    if (length < 0 || ((uint32_t)length < size && log_file_fill(file, length, size - length) != ESP_OK))
+    {
+        fclose(file);
+        return ESP_FAIL;
+    }
+
+    *storage = (ds3231_log_storage_t){
+        .read = log_file_read,
+        .write = log_file_write,
+        .erase = log_file_erase,
+        .size = size,
+        .ctx = file};
+
+    return ESP_OK;
+}
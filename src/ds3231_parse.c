@@ -0,0 +1,157 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_parse.h"
+#include "ds3231_epoch.h"
+
+#define ISO_8601_LENGTH 19 // YYYY-MM-DDTHH:MM:SS
+
+static bool parse_is_leap_year(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int parse_days_in_month(int month, int year)
+{
+    static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    return month == 2 && parse_is_leap_year(year) ? 29 : days[month - 1];
+}
+
+// Parse min_digits..max_digits decimal digits, *p is moved behind them
+static bool parse_number(const char **p, const char *end, int min_digits, int max_digits, int *value)
+{
+    int digits = 0;
+
+    *value = 0;
+    while (*p < end && digits < max_digits && **p >= '0' && **p <= '9')
+    {
+        *value = *value * 10 + (**p - '0');
+        (*p)++;
+        digits++;
+    }
+
+    return digits >= min_digits;
+}
+
+static bool parse_char(const char **p, const char *end, char c)
+{
+    if (*p >= end || **p != c)
+        return false;
+
+    (*p)++;
+    return true;
+}
+
+// Fields in register order: sec, min, hour, dow, date, month, year (full year)
+static esp_err_t parse_store(const int *field, bool calc_dow, uint8_t *regs)
+{
+    int year = field[6];
+
+    if (field[0] > 59 || field[1] > 59 || field[2] > 23 || field[5] < 1 || field[5] > 12 ||
+        year < 2000 || year > 2199 || field[4] < 1 || field[4] > parse_days_in_month(field[5], year))
+        return ESP_ERR_INVALID_ARG;
+
+    if (!calc_dow && (field[3] < 1 || field[3] > 7))
+        return ESP_ERR_INVALID_ARG;
+
+    regs[0] = dec2bcd(field[0]);
+    regs[1] = dec2bcd(field[1]);
+    regs[2] = dec2bcd(field[2]);
+    regs[4] = dec2bcd(field[4]);
+    regs[5] = dec2bcd(field[5]) | (year >= 2100 ? DS3231_CENTURY_FLAG : 0);
+    regs[6] = dec2bcd(year % 100);
+
+    if (calc_dow)
+    {
+        // 1970-01-01 was a Thursday, 1 - Sunday
+        regs[3] = 0x01;
+        regs[3] = (uint8_t)((ds3231_regs_to_epoch(regs) / 86400 + 4) % 7 + 1);
+    }
+    else
+    {
+        regs[3] = field[3];
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t parse_iso_8601(const char *p, const char *end, uint8_t *regs)
+{
+    int field[7] = {0};
+
+    if (!parse_number(&p, end, 4, 4, &field[6]) || !parse_char(&p, end, '-') ||
+        !parse_number(&p, end, 2, 2, &field[5]) || !parse_char(&p, end, '-') ||
+        !parse_number(&p, end, 2, 2, &field[4]))
+        return ESP_ERR_INVALID_ARG;
+
+    if (!parse_char(&p, end, 'T') && !parse_char(&p, end, ' '))
+        return ESP_ERR_INVALID_ARG;
+
+    if (!parse_number(&p, end, 2, 2, &field[2]) || !parse_char(&p, end, ':') ||
+        !parse_number(&p, end, 2, 2, &field[1]) || !parse_char(&p, end, ':') ||
+        !parse_number(&p, end, 2, 2, &field[0]))
+        return ESP_ERR_INVALID_ARG;
+
+    parse_char(&p, end, 'Z');
+    if (p != end)
+        return ESP_ERR_INVALID_ARG;
+
+    return parse_store(field, true, regs);
+}
+
+static esp_err_t parse_comma_list(const char *p, const char *end, uint8_t *regs)
+{
+    int field[7];
+
+    for (int i = 0; i < 7; i++)
+    {
+        if (!parse_number(&p, end, 1, 2, &field[i]))
+            return ESP_ERR_INVALID_ARG;
+
+        if (i < 6 && !parse_char(&p, end, ','))
+            return ESP_ERR_INVALID_ARG;
+    }
+
+    if (p != end)
+        return ESP_ERR_INVALID_ARG;
+
+    field[6] += 2000;
+
+    return parse_store(field, false, regs);
+}
+
+esp_err_t ds3231_parse_date_time(const char *str, size_t len, uint8_t *regs)
+{
+    if (str == NULL || regs == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    // "YYYY-" can not start a comma list, its first field has at most 2 digits
+    if (len >= ISO_8601_LENGTH && str[4] == '-')
+        return parse_iso_8601(str, str + len, regs);
+
+    return parse_comma_list(str, str + len, regs);
+}
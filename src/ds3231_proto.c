@@ -0,0 +1,333 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_proto.h"
+#include "ds3231_epoch.h"
+#include "ds3231_regmap.h"
+#include "ds3231_snapshot.h"
+#include "ds3231_temp.h"
+#include "ds3231_time_service.h"
+
+#include <math.h>
+
+#define PROTO_RESULT_HEADER 2 // Operation id and status in front of every result
+
+// CRC-16/CCITT-FALSE, one nibble at a time: a 32 byte table instead of 512
+static const uint16_t proto_crc_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+
+uint16_t ds3231_proto_crc16(const uint8_t *data, size_t size)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = (crc << 4) ^ proto_crc_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ proto_crc_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+
+    return crc;
+}
+
+static void proto_put_le(uint8_t *dst, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        dst[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t proto_get_le(const uint8_t *src, size_t size)
+{
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < size; i++)
+        value |= (uint64_t)src[i] << (8 * i);
+
+    return value;
+}
+
+static uint8_t proto_status(esp_err_t result)
+{
+    switch (result)
+    {
+    case ESP_OK:
+        return DS3231_PROTO_OK;
+    case ESP_ERR_TIMEOUT:
+        return DS3231_PROTO_ERR_TIMEOUT;
+    case ESP_ERR_INVALID_STATE:
+        return DS3231_PROTO_ERR_INVALID_STATE;
+    case ESP_ERR_INVALID_ARG:
+        return DS3231_PROTO_ERR_INVALID_ARG;
+    default:
+        return DS3231_PROTO_ERR_FAIL;
+    }
+}
+
+// Width of the argument and of the result data of an operation, false - unknown operation
+static bool proto_op_sizes(uint8_t op, size_t *arg_size, size_t *data_size)
+{
+    *arg_size = 0;
+    switch (op)
+    {
+    case DS3231_PROTO_OP_TIME:
+    case DS3231_PROTO_OP_TIME_US:
+        *data_size = 8;
+        return true;
+    case DS3231_PROTO_OP_TIME_REGS:
+        *data_size = 7;
+        return true;
+    case DS3231_PROTO_OP_TEMP:
+        *data_size = 2;
+        return true;
+    case DS3231_PROTO_OP_STATUS:
+        *data_size = 1;
+        return true;
+    case DS3231_PROTO_OP_SET_TIME:
+        *arg_size = 8;
+        *data_size = 0;
+        return true;
+    case DS3231_PROTO_OP_CLEAR_OSF:
+        *data_size = 0;
+        return true;
+    default:
+        *data_size = 0;
+        return false;
+    }
+}
+
+static esp_err_t proto_execute(uint8_t op, const uint8_t *arg, uint8_t *data)
+{
+    esp_err_t result;
+
+    switch (op)
+    {
+    case DS3231_PROTO_OP_TIME:
+    {
+        int64_t epoch;
+        result = ds3231_get_epoch(&epoch);
+        if (result == ESP_OK)
+            proto_put_le(data, (uint64_t)epoch, 8);
+        return result;
+    }
+    case DS3231_PROTO_OP_TIME_REGS:
+        return ds3231_read_data(DS3231_TIME_ADDRESS, 1, data, 7);
+    case DS3231_PROTO_OP_TIME_US:
+    {
+        int64_t epoch_us;
+        result = ds3231_snapshot_get_time_us(&epoch_us);
+        if (result == ESP_OK)
+            proto_put_le(data, (uint64_t)epoch_us, 8);
+        return result;
+    }
+    case DS3231_PROTO_OP_TEMP:
+    {
+        float temp;
+        result = ds3231_temp_get(&temp);
+        if (result == ESP_OK)
+            proto_put_le(data, (uint16_t)(int16_t)lroundf(temp * 4.0f), 2);
+        return result;
+    }
+    case DS3231_PROTO_OP_STATUS:
+    {
+        uint8_t osf;
+        return ds3231_power_lost(&osf, data);
+    }
+    case DS3231_PROTO_OP_SET_TIME:
+        result = ds3231_set_epoch((int64_t)proto_get_le(arg, 8));
+        if (result == ESP_OK)
+            ds3231_ts_invalidate();
+        return result;
+    case DS3231_PROTO_OP_CLEAR_OSF:
+        result = ds3231_regmap_update_bits(DS3231_STATUS_REGISTER_ADDRESS, DS3231_STATUS_OSF, 0);
+        if (result == ESP_OK)
+            result = ds3231_regmap_flush();
+        return result;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+// Validate the whole batch first, a malformed one is not executed at all
+static bool proto_check_batch(const uint8_t *payload, size_t size, size_t *reply_size)
+{
+    size_t ops = 0;
+
+    *reply_size = 0;
+    for (size_t pos = 0; pos < size; ops++)
+    {
+        size_t arg_size, data_size;
+
+        proto_op_sizes(payload[pos], &arg_size, &data_size);
+        if (ops == DS3231_PROTO_MAX_OPS || pos + 1 + arg_size > size)
+            return false;
+
+        pos += 1 + arg_size;
+        *reply_size += PROTO_RESULT_HEADER + data_size;
+    }
+
+    return *reply_size <= DS3231_PROTO_MAX_PAYLOAD;
+}
+
+static size_t proto_run_batch(const uint8_t *payload, size_t size, uint8_t *out)
+{
+    size_t out_pos = 0;
+
+    for (size_t pos = 0; pos < size;)
+    {
+        uint8_t op = payload[pos];
+        size_t arg_size, data_size;
+        bool known = proto_op_sizes(op, &arg_size, &data_size);
+
+        out[out_pos] = op;
+        if (known)
+        {
+            esp_err_t result = proto_execute(op, &payload[pos + 1], &out[out_pos + PROTO_RESULT_HEADER]);
+            out[out_pos + 1] = proto_status(result);
+            // Fixed layout: a failed read leaves no partial data behind
+            if (result != ESP_OK)
+                memset(&out[out_pos + PROTO_RESULT_HEADER], 0, data_size);
+        }
+        else
+        {
+            out[out_pos + 1] = DS3231_PROTO_ERR_UNKNOWN_OP;
+        }
+
+        pos += 1 + arg_size;
+        out_pos += PROTO_RESULT_HEADER + data_size;
+    }
+
+    return out_pos;
+}
+
+size_t ds3231_proto_encode(uint8_t cmd, uint8_t seq, const uint8_t *payload, size_t payload_size, uint8_t *frame,
+                           size_t frame_size)
+{
+    size_t size = DS3231_PROTO_HEADER_SIZE + payload_size + DS3231_PROTO_CRC_SIZE;
+
+    if (payload_size > DS3231_PROTO_MAX_PAYLOAD || frame_size < size)
+        return 0;
+
+    frame[0] = DS3231_PROTO_SYNC;
+    frame[1] = (uint8_t)payload_size;
+    frame[2] = cmd;
+    frame[3] = seq;
+    // The payload may already be in place
+    if (payload_size > 0 && payload != &frame[DS3231_PROTO_HEADER_SIZE])
+        memmove(&frame[DS3231_PROTO_HEADER_SIZE], payload, payload_size);
+    proto_put_le(&frame[DS3231_PROTO_HEADER_SIZE + payload_size],
+                 ds3231_proto_crc16(&frame[1], DS3231_PROTO_HEADER_SIZE - 1 + payload_size), DS3231_PROTO_CRC_SIZE);
+
+    return size;
+}
+
+void ds3231_proto_reset(ds3231_proto_parser_t *parser)
+{
+    parser->pos = 0;
+}
+
+ds3231_proto_feed_t ds3231_proto_feed(ds3231_proto_parser_t *parser, uint8_t byte)
+{
+    if (parser->pos == 0)
+    {
+        if (byte != DS3231_PROTO_SYNC)
+            return DS3231_PROTO_NOT_FRAME;
+
+        parser->frame[parser->pos++] = byte;
+        return DS3231_PROTO_PENDING;
+    }
+
+    // A length which cannot be right means the SYNC was noise, the byte goes back to the text console
+    if (parser->pos == 1 && byte > DS3231_PROTO_MAX_PAYLOAD)
+    {
+        ds3231_proto_reset(parser);
+        return DS3231_PROTO_NOT_FRAME;
+    }
+
+    parser->frame[parser->pos++] = byte;
+    if (parser->pos < DS3231_PROTO_HEADER_SIZE + parser->frame[1] + DS3231_PROTO_CRC_SIZE)
+        return DS3231_PROTO_PENDING;
+
+    return DS3231_PROTO_FRAME;
+}
+
+size_t ds3231_proto_missing(const ds3231_proto_parser_t *parser)
+{
+    if (parser->pos < 2)
+        return 1;
+
+    return DS3231_PROTO_HEADER_SIZE + parser->frame[1] + DS3231_PROTO_CRC_SIZE - parser->pos;
+}
+
+size_t ds3231_proto_handle(ds3231_proto_parser_t *parser, uint8_t *reply, size_t reply_size)
+{
+    const uint8_t *frame = parser->frame;
+    size_t payload_size = frame[1];
+    uint8_t cmd = frame[2];
+    uint8_t seq = frame[3];
+    const uint8_t *payload = &frame[DS3231_PROTO_HEADER_SIZE];
+    size_t result_size = 0;
+    uint8_t nak = 0;
+
+    ds3231_proto_reset(parser);
+
+    if (reply_size < DS3231_PROTO_HEADER_SIZE + DS3231_PROTO_CRC_SIZE + 1)
+        return 0;
+
+    uint8_t *out = &reply[DS3231_PROTO_HEADER_SIZE];
+    size_t out_size = reply_size - DS3231_PROTO_HEADER_SIZE - DS3231_PROTO_CRC_SIZE;
+
+    if (ds3231_proto_crc16(&frame[1], DS3231_PROTO_HEADER_SIZE - 1 + payload_size) !=
+        proto_get_le(&payload[payload_size], DS3231_PROTO_CRC_SIZE))
+    {
+        nak = DS3231_PROTO_NAK_CRC;
+    }
+    else if (cmd == DS3231_PROTO_CMD_PING)
+    {
+        out[0] = DS3231_PROTO_VERSION;
+        result_size = 1;
+    }
+    else if (cmd == DS3231_PROTO_CMD_BATCH)
+    {
+        if (!proto_check_batch(payload, payload_size, &result_size))
+            nak = DS3231_PROTO_NAK_MALFORMED;
+        else if (result_size > out_size)
+            return 0;
+        else
+            result_size = proto_run_batch(payload, payload_size, out);
+    }
+    else
+    {
+        nak = DS3231_PROTO_NAK_COMMAND;
+    }
+
+    if (nak != 0)
+    {
+        out[0] = nak;
+        return ds3231_proto_encode(DS3231_PROTO_CMD_NAK | DS3231_PROTO_REPLY, seq, out, 1, reply, reply_size);
+    }
+
+    return ds3231_proto_encode(cmd | DS3231_PROTO_REPLY, seq, out, result_size, reply, reply_size);
+}
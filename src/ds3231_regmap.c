@@ -0,0 +1,395 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_regmap.h"
+
+#include <esp_timer.h>
+
+#define REGMAP_BIT(reg) (1UL << (reg))
+#define REGMAP_STATUS_FLAGS (DS3231_STATUS_OSF | DS3231_STATUS_A2F | DS3231_STATUS_A1F)
+
+static SemaphoreHandle_t regmap_mutex;
+#if DS3231_STATIC_ALLOCATION
+static StaticSemaphore_t regmap_mutex_buffer;
+#endif
+static uint8_t regmap_shadow[DS3231_REGISTER_COUNT];
+static int64_t regmap_read_us[DS3231_REGISTER_COUNT];
+static int64_t regmap_max_age_us[DS3231_REGISTER_COUNT];
+static uint32_t regmap_valid;
+static uint32_t regmap_dirty;
+// Clear-only status flags the pending status write should clear
+static uint8_t regmap_status_clear;
+static ds3231_regmap_stats_t regmap_stats;
+static portMUX_TYPE regmap_init_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t ds3231_regmap_init(void)
+{
+    if (regmap_mutex == NULL)
+    {
+#if DS3231_STATIC_ALLOCATION
+        static bool mutex_claimed;
+
+        // Only the first caller constructs the mutex in the buffer, the others wait for it
+        portENTER_CRITICAL(&regmap_init_lock);
+        bool claimed = !mutex_claimed;
+        mutex_claimed = true;
+        portEXIT_CRITICAL(&regmap_init_lock);
+
+        if (claimed)
+            regmap_mutex = xSemaphoreCreateMutexStatic(&regmap_mutex_buffer);
+        while (regmap_mutex == NULL)
+            vTaskDelay(1);
+#else
+        SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+        if (mutex == NULL)
+        {
+            ESP_LOGE(DS3231_TAG, "Could not create register map mutex");
+            return ESP_FAIL;
+        }
+
+        portENTER_CRITICAL(&regmap_init_lock);
+        if (regmap_mutex == NULL)
+        {
+            regmap_mutex = mutex;
+            mutex = NULL;
+        }
+        portEXIT_CRITICAL(&regmap_init_lock);
+
+        if (mutex != NULL)
+            vSemaphoreDelete(mutex);
+#endif
+    }
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+
+    for (uint8_t reg = 0; reg < DS3231_REGISTER_COUNT; reg++)
+        regmap_max_age_us[reg] = DS3231_REGMAP_AGE_NEVER;
+
+    for (uint8_t reg = DS3231_TIME_ADDRESS; reg < DS3231_ALARM1_ADDRESS; reg++)
+        regmap_max_age_us[reg] = DS3231_REGMAP_AGE_ALWAYS;
+
+    regmap_max_age_us[DS3231_STATUS_REGISTER_ADDRESS] = DS3231_REGMAP_AGE_ALWAYS;
+    regmap_max_age_us[DS3231_ADDRESS_TEMPERATURE] = DS3231_REGMAP_TEMPERATURE_AGE_US;
+    regmap_max_age_us[DS3231_ADDRESS_TEMPERATURE + 1] = DS3231_REGMAP_TEMPERATURE_AGE_US;
+
+    regmap_valid = 0;
+    regmap_dirty = 0;
+    regmap_status_clear = 0;
+
+    xSemaphoreGive(regmap_mutex);
+
+    return ESP_OK;
+}
+
+static bool regmap_is_stale(uint8_t reg, int64_t now)
+{
+    if (regmap_dirty & REGMAP_BIT(reg))
+        return false;
+
+    if (!(regmap_valid & REGMAP_BIT(reg)))
+        return true;
+
+    return regmap_max_age_us[reg] != DS3231_REGMAP_AGE_NEVER && now - regmap_read_us[reg] >= regmap_max_age_us[reg];
+}
+
+// Read the stale registers of [reg, reg + count) in one burst, the mutex is held by the caller
+static esp_err_t regmap_fetch(uint8_t reg, size_t count)
+{
+    int64_t now = esp_timer_get_time();
+    int first = -1;
+    int last = -1;
+
+    for (uint8_t r = reg; r < reg + count; r++)
+    {
+        if (regmap_is_stale(r, now))
+        {
+            if (first < 0)
+                first = r;
+            last = r;
+        }
+    }
+
+    if (first < 0)
+        return ESP_OK;
+
+    uint8_t buffer[DS3231_REGISTER_COUNT];
+    size_t length = last - first + 1;
+
+    esp_err_t result = ds3231_read_data(first, 1, buffer, length);
+    if (result != ESP_OK)
+        return result;
+
+    regmap_stats.read_transactions++;
+    regmap_stats.bytes_read += length;
+
+    for (int r = first; r <= last; r++)
+    {
+        // Pending writes win over what the chip reports
+        if (regmap_dirty & REGMAP_BIT(r))
+            continue;
+
+        regmap_shadow[r] = buffer[r - first];
+        regmap_read_us[r] = now;
+        regmap_valid |= REGMAP_BIT(r);
+    }
+
+    return ESP_OK;
+}
+
+// Store a value in the shadow, the mutex is held by the caller
+static void regmap_store(uint8_t reg, uint8_t value, uint8_t flag_mask)
+{
+    if (reg == DS3231_STATUS_REGISTER_ADDRESS)
+        regmap_status_clear |= ~value & flag_mask & REGMAP_STATUS_FLAGS;
+
+    regmap_shadow[reg] = value;
+    regmap_dirty |= REGMAP_BIT(reg);
+}
+
+static bool regmap_range_valid(uint8_t reg, size_t count)
+{
+    return regmap_mutex != NULL && reg < DS3231_REGISTER_COUNT && count > 0 && count <= (size_t)(DS3231_REGISTER_COUNT - reg);
+}
+
+esp_err_t ds3231_regmap_refresh(void)
+{
+    uint8_t buffer[DS3231_REGISTER_COUNT];
+
+    if (regmap_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+
+    esp_err_t result = ds3231_read_data(DS3231_TIME_ADDRESS, 1, buffer, DS3231_REGISTER_COUNT);
+    if (result == ESP_OK)
+    {
+        int64_t now = esp_timer_get_time();
+
+        memcpy(regmap_shadow, buffer, DS3231_REGISTER_COUNT);
+        for (uint8_t reg = 0; reg < DS3231_REGISTER_COUNT; reg++)
+            regmap_read_us[reg] = now;
+
+        regmap_valid = REGMAP_BIT(DS3231_REGISTER_COUNT) - 1;
+        regmap_dirty = 0;
+        regmap_status_clear = 0;
+        regmap_stats.read_transactions++;
+        regmap_stats.bytes_read += DS3231_REGISTER_COUNT;
+    }
+
+    xSemaphoreGive(regmap_mutex);
+
+    return result;
+}
+
+esp_err_t ds3231_regmap_read(uint8_t reg, uint8_t *values, size_t count)
+{
+    if (regmap_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    if (values == NULL || !regmap_range_valid(reg, count))
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+
+    esp_err_t result = regmap_fetch(reg, count);
+    if (result == ESP_OK)
+        memcpy(values, &regmap_shadow[reg], count);
+
+    xSemaphoreGive(regmap_mutex);
+
+    return result;
+}
+
+esp_err_t ds3231_regmap_write(uint8_t reg, const uint8_t *values, size_t count)
+{
+    if (regmap_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    if (values == NULL || !regmap_range_valid(reg, count))
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+
+    for (size_t i = 0; i < count; i++)
+        regmap_store(reg + i, values[i], REGMAP_STATUS_FLAGS);
+
+    xSemaphoreGive(regmap_mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_regmap_update_bits(uint8_t reg, uint8_t mask, uint8_t value)
+{
+    if (regmap_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    if (!regmap_range_valid(reg, 1))
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+
+    esp_err_t result = regmap_fetch(reg, 1);
+    if (result == ESP_OK)
+        regmap_store(reg, (regmap_shadow[reg] & ~mask) | (value & mask), mask);
+
+    xSemaphoreGive(regmap_mutex);
+
+    return result;
+}
+
+// A clean register can be re-written with its shadow value to bridge two dirty runs
+static bool regmap_can_bridge(uint8_t reg)
+{
+    return reg != DS3231_STATUS_REGISTER_ADDRESS && (regmap_valid & REGMAP_BIT(reg)) &&
+           regmap_max_age_us[reg] == DS3231_REGMAP_AGE_NEVER;
+}
+
+esp_err_t ds3231_regmap_flush(void)
+{
+    esp_err_t result = ESP_OK;
+    uint8_t buffer[DS3231_REGISTER_COUNT];
+
+    if (regmap_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+
+    uint8_t reg = 0;
+    while (reg < DS3231_REGISTER_COUNT && result == ESP_OK)
+    {
+        if (!(regmap_dirty & REGMAP_BIT(reg)))
+        {
+            reg++;
+            continue;
+        }
+
+        uint8_t first = reg;
+        uint8_t last = reg;
+        uint8_t next = reg + 1;
+
+        while (next < DS3231_REGISTER_COUNT)
+        {
+            if (regmap_dirty & REGMAP_BIT(next))
+            {
+                last = next++;
+                continue;
+            }
+
+            // Look for the next dirty register behind a short bridgeable gap
+            uint8_t gap = next;
+            while (gap < DS3231_REGISTER_COUNT && gap - next < DS3231_REGMAP_MERGE_GAP &&
+                   !(regmap_dirty & REGMAP_BIT(gap)) && regmap_can_bridge(gap))
+                gap++;
+
+            if (gap < DS3231_REGISTER_COUNT && (regmap_dirty & REGMAP_BIT(gap)))
+            {
+                last = gap;
+                next = gap + 1;
+                continue;
+            }
+
+            break;
+        }
+
+        size_t length = last - first + 1;
+        memcpy(buffer, &regmap_shadow[first], length);
+
+        bool status = first <= DS3231_STATUS_REGISTER_ADDRESS && DS3231_STATUS_REGISTER_ADDRESS <= last;
+        if (status)
+        {
+            // Writing 1 leaves a clear-only flag untouched on the chip
+            uint8_t *value = &buffer[DS3231_STATUS_REGISTER_ADDRESS - first];
+            *value = (*value & ~REGMAP_STATUS_FLAGS) | (REGMAP_STATUS_FLAGS & ~regmap_status_clear);
+        }
+
+        result = ds3231_write_data(first, 1, buffer, length);
+        if (result == ESP_OK)
+        {
+            int64_t now = esp_timer_get_time();
+
+            for (uint8_t r = first; r <= last; r++)
+            {
+                regmap_dirty &= ~REGMAP_BIT(r);
+                regmap_valid |= REGMAP_BIT(r);
+                regmap_read_us[r] = now;
+            }
+
+            if (status)
+            {
+                regmap_shadow[DS3231_STATUS_REGISTER_ADDRESS] &= ~regmap_status_clear;
+                regmap_status_clear = 0;
+            }
+
+            regmap_stats.write_transactions++;
+            regmap_stats.bytes_written += length;
+        }
+
+        reg = last + 1;
+    }
+
+    xSemaphoreGive(regmap_mutex);
+
+    return result;
+}
+
+esp_err_t ds3231_regmap_set_max_age(uint8_t reg, int64_t max_age_us)
+{
+    if (regmap_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    if (reg >= DS3231_REGISTER_COUNT || max_age_us < 0)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+    regmap_max_age_us[reg] = max_age_us;
+    xSemaphoreGive(regmap_mutex);
+
+    return ESP_OK;
+}
+
+void ds3231_regmap_invalidate(uint8_t reg, size_t count)
+{
+    if (!regmap_range_valid(reg, count))
+        return;
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < count; i++)
+        regmap_valid &= ~REGMAP_BIT(reg + i);
+    xSemaphoreGive(regmap_mutex);
+}
+
+void ds3231_regmap_get_stats(ds3231_regmap_stats_t *stats)
+{
+    if (regmap_mutex == NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    xSemaphoreTake(regmap_mutex, portMAX_DELAY);
+    *stats = regmap_stats;
+    xSemaphoreGive(regmap_mutex);
+}
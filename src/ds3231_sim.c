@@ -0,0 +1,553 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_sim.h"
+#include "ds3231_epoch.h"
+
+#include <esp_timer.h>
+#include <esp_rom_sys.h>
+#include <math.h>
+
+#define SIM_SECOND_US 1000000LL
+
+#define SIM_ALARM_MASK_BIT 0x80
+#define SIM_ALARM_DYDT_FLAG 0x40
+
+// Writable bits of every register, the status register has its own rules
+static const uint8_t sim_write_mask[DS3231_REGISTER_COUNT] = {
+    0x7F, 0x7F, 0x7F, 0x07, 0x3F, 0x9F, 0xFF,       // time
+    0xFF, 0xFF, 0xFF, 0xFF,                         // alarm 1
+    0xFF, 0xFF, 0xFF,                               // alarm 2
+    0xFF, 0x00, 0xFF,                               // control, status, aging offset
+    0x00, 0x00};                                    // temperature
+
+static uint8_t sim_days_in_month(uint8_t month, uint8_t year)
+{
+    static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    // The DS3231 treats every year divisible by 4 as a leap year
+    if (month == 2 && (year % 4) == 0)
+        return 29;
+
+    return days[month - 1];
+}
+
+static bool sim_alarm_day_matches(const uint8_t *r, uint8_t alarm_day)
+{
+    if (alarm_day & SIM_ALARM_DYDT_FLAG)
+        return (r[3] & 0x0F) == (alarm_day & 0x0F);
+
+    return (r[4] & 0x3F) == (alarm_day & 0x3F);
+}
+
+// INT is low while INTCN is set and an alarm flag is set together with its interrupt enable
+static bool sim_int_asserted(const uint8_t *r)
+{
+    return (r[0x0E] & DS3231_CONTROL_INTCN) &&
+           (r[0x0E] & r[0x0F] & (DS3231_CONTROL_A2IE | DS3231_CONTROL_A1IE));
+}
+
+static void sim_check_alarms(ds3231_sim_t *sim)
+{
+    uint8_t *r = sim->registers;
+    bool asserted = sim_int_asserted(r);
+
+    // Alarm 1: seconds, minutes, hours, day/date, each field can be masked out
+    if (((r[0x07] & SIM_ALARM_MASK_BIT) || (r[0x07] & 0x7F) == r[0]) &&
+        ((r[0x08] & SIM_ALARM_MASK_BIT) || (r[0x08] & 0x7F) == r[1]) &&
+        ((r[0x09] & SIM_ALARM_MASK_BIT) || (r[0x09] & 0x7F) == r[2]) &&
+        ((r[0x0A] & SIM_ALARM_MASK_BIT) || sim_alarm_day_matches(r, r[0x0A])))
+        r[0x0F] |= DS3231_STATUS_A1F;
+
+    // Alarm 2 has no seconds register and fires at 00 seconds
+    if (r[0] == 0 &&
+        ((r[0x0B] & SIM_ALARM_MASK_BIT) || (r[0x0B] & 0x7F) == r[1]) &&
+        ((r[0x0C] & SIM_ALARM_MASK_BIT) || (r[0x0C] & 0x7F) == r[2]) &&
+        ((r[0x0D] & SIM_ALARM_MASK_BIT) || sim_alarm_day_matches(r, r[0x0D])))
+        r[0x0F] |= DS3231_STATUS_A2F;
+
+    if (sim->int_edge != NULL && !asserted && sim_int_asserted(r))
+        sim->int_edge();
+}
+
+static void sim_advance_day(ds3231_sim_t *sim)
+{
+    uint8_t *r = sim->registers;
+
+    r[3] = (r[3] & 0x07) % 7 + 1;
+
+    uint8_t date = bcd2dec(r[4] & 0x3F) + 1;
+    uint8_t month = bcd2dec(r[5] & DS3231_MONTH_MASK);
+    uint8_t year = bcd2dec(r[6]);
+
+    if (date <= sim_days_in_month(month, year))
+    {
+        r[4] = dec2bcd(date);
+        return;
+    }
+
+    r[4] = 0x01;
+    if (++month <= 12)
+    {
+        r[5] = (r[5] & DS3231_CENTURY_FLAG) | dec2bcd(month);
+        return;
+    }
+
+    r[5] = (r[5] & DS3231_CENTURY_FLAG) | 0x01;
+    if (++year <= 99)
+    {
+        r[6] = dec2bcd(year);
+        return;
+    }
+
+    // Year 99 -> 00 toggles the century bit
+    r[6] = 0x00;
+    r[5] ^= DS3231_CENTURY_FLAG;
+}
+
+static void sim_advance_second(ds3231_sim_t *sim)
+{
+    uint8_t *r = sim->registers;
+    uint8_t sec = bcd2dec(r[0]) + 1;
+    uint8_t min;
+
+    if (sec < 60)
+    {
+        r[0] = dec2bcd(sec);
+        sim_check_alarms(sim);
+        return;
+    }
+
+    r[0] = 0x00;
+    min = bcd2dec(r[1]) + 1;
+    if (min < 60)
+    {
+        r[1] = dec2bcd(min);
+        sim_check_alarms(sim);
+        return;
+    }
+
+    r[1] = 0x00;
+    if (r[2] & DS3231_12HOUR_FLAG)
+    {
+        uint8_t hour = bcd2dec(r[2] & DS3231_12HOUR_MASK);
+        uint8_t pm = r[2] & DS3231_PM_FLAG;
+
+        // 11 -> 12 flips AM/PM, 12 -> 1 keeps it; 11 PM -> 12 AM starts a new day
+        if (hour == 11)
+        {
+            r[2] = DS3231_12HOUR_FLAG | (pm ^ DS3231_PM_FLAG) | 0x12;
+            if (pm)
+                sim_advance_day(sim);
+        }
+        else
+        {
+            r[2] = DS3231_12HOUR_FLAG | pm | dec2bcd(hour == 12 ? 1 : hour + 1);
+        }
+    }
+    else
+    {
+        uint8_t hour = bcd2dec(r[2] & 0x3F) + 1;
+        if (hour < 24)
+        {
+            r[2] = dec2bcd(hour);
+        }
+        else
+        {
+            r[2] = 0x00;
+            sim_advance_day(sim);
+        }
+    }
+
+    sim_check_alarms(sim);
+}
+
+// Length of the coming second in ns, shortened by a positive drift
+static int64_t sim_second_ns(const ds3231_sim_t *sim)
+{
+    const uint8_t *r = sim->registers;
+    float temp = ((int16_t)(int8_t)r[DS3231_ADDRESS_TEMPERATURE] << 2 | r[DS3231_ADDRESS_TEMPERATURE + 1] >> 6) * 0.25f;
+    double ppm = sim->drift_ppm + sim->temp_coeff_ppm * (temp - 25.0f) -
+                 DS3231_AGING_PPM_PER_LSB * (int8_t)r[DS3231_AGING_OFFSET_ADDRESS];
+
+    return llround(SIM_SECOND_US * 1000.0 / (1.0 + ppm * 1e-6));
+}
+
+// Schedule the next seconds increment after the one due at next_tick_us
+static void sim_schedule_tick(ds3231_sim_t *sim)
+{
+    int64_t ns = sim_second_ns(sim) + sim->tick_frac_ns;
+
+    sim->next_tick_us += ns / 1000;
+    sim->tick_frac_ns = ns % 1000;
+}
+
+static void sim_write_register(ds3231_sim_t *sim, uint8_t reg, uint8_t value)
+{
+    uint8_t *r = sim->registers;
+
+    if (reg == DS3231_STATUS_REGISTER_ADDRESS)
+    {
+        // OSF, A2F and A1F can only be cleared, BSY is read-only
+        r[reg] = (r[reg] & value & (DS3231_STATUS_OSF | DS3231_STATUS_A2F | DS3231_STATUS_A1F)) |
+                 (value & DS3231_STATUS_EN32KHZ) | (r[reg] & DS3231_STATUS_BSY);
+        return;
+    }
+
+    r[reg] = (r[reg] & ~sim_write_mask[reg]) | (value & sim_write_mask[reg]);
+
+    if (reg == DS3231_TIME_ADDRESS)
+    {
+        // Writing the seconds register resets the countdown chain
+        sim->next_tick_us = esp_timer_get_time();
+        sim->tick_frac_ns = 0;
+        sim_schedule_tick(sim);
+    }
+    else if (reg == DS3231_CONTROL_REGISTER_ADDRESS && (value & DS3231_CONTROL_CONV))
+    {
+        // The conversion result is the configured temperature, it completes instantly
+        r[reg] &= ~DS3231_CONTROL_CONV;
+    }
+}
+
+static void sim_bus_delay(const ds3231_sim_t *sim, size_t bytes, size_t starts)
+{
+    uint32_t ns = ds3231_sim_transfer_time_ns(sim, bytes, starts);
+
+    if (ns != 0)
+        esp_rom_delay_us((ns + 500) / 1000);
+}
+
+// Injected faults, ESP_OK when the transaction goes ahead
+static esp_err_t sim_fault(ds3231_sim_t *sim, TickType_t ticks_to_wait)
+{
+    if (sim->fault_stuck)
+    {
+        // The controller cannot generate a START and gives up after the timeout
+        vTaskDelay(ticks_to_wait);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    if (sim->fault_nack > 0)
+    {
+        sim->fault_nack--;
+        sim_bus_delay(sim, 1, 1);
+        return ESP_FAIL;
+    }
+
+    if (sim->fault_delay_us > 0)
+    {
+        if (sim->fault_delay_us >= (uint64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000)
+        {
+            vTaskDelay(ticks_to_wait);
+            return ESP_ERR_TIMEOUT;
+        }
+
+        // Sleep the whole ticks, spin for the rest
+        vTaskDelay(pdMS_TO_TICKS(sim->fault_delay_us / 1000));
+        esp_rom_delay_us(sim->fault_delay_us % (portTICK_PERIOD_MS * 1000));
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t sim_recover(void *ctx)
+{
+    ds3231_sim_t *sim = (ds3231_sim_t *)ctx;
+
+    // 9 clocks and a STOP, the model lets go of SDA
+    sim->recoveries++;
+    sim->fault_stuck = false;
+    sim_bus_delay(sim, 1, 1);
+
+    return ESP_OK;
+}
+
+static esp_err_t sim_write_read(void *ctx, uint8_t device_address, const uint8_t *write_buffer, size_t write_size,
+                                uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
+{
+    ds3231_sim_t *sim = (ds3231_sim_t *)ctx;
+
+    esp_err_t fault = sim_fault(sim, ticks_to_wait);
+    if (fault != ESP_OK)
+        return fault;
+
+    if (device_address != sim->address)
+    {
+        // Only the address byte goes out before the NACK
+        sim_bus_delay(sim, 1, 1);
+        return ESP_FAIL;
+    }
+
+    ds3231_sim_tick(sim);
+
+    if (write_size > 0)
+        sim->pointer = write_buffer[0] % DS3231_REGISTER_COUNT;
+
+    for (size_t i = 1; i < write_size; i++)
+    {
+        sim_write_register(sim, sim->pointer, write_buffer[i]);
+        sim->pointer = (sim->pointer + 1) % DS3231_REGISTER_COUNT;
+    }
+
+    for (size_t i = 0; i < read_size; i++)
+    {
+        read_buffer[i] = sim->registers[sim->pointer];
+        sim->pointer = (sim->pointer + 1) % DS3231_REGISTER_COUNT;
+    }
+
+    sim->transactions++;
+    sim_bus_delay(sim, 2 + write_size + read_size, 2);
+
+    return ESP_OK;
+}
+
+static esp_err_t sim_write(void *ctx, uint8_t device_address, const uint8_t *address, size_t address_size,
+                           const uint8_t *tx_buffer, size_t tx_buffer_size, TickType_t ticks_to_wait)
+{
+    ds3231_sim_t *sim = (ds3231_sim_t *)ctx;
+
+    esp_err_t fault = sim_fault(sim, ticks_to_wait);
+    if (fault != ESP_OK)
+        return fault;
+
+    if (device_address != sim->address)
+    {
+        sim_bus_delay(sim, 1, 1);
+        return ESP_FAIL;
+    }
+
+    ds3231_sim_tick(sim);
+
+    if (address_size > 0)
+        sim->pointer = address[0] % DS3231_REGISTER_COUNT;
+
+    for (size_t i = 0; i < tx_buffer_size; i++)
+    {
+        sim_write_register(sim, sim->pointer, tx_buffer[i]);
+        sim->pointer = (sim->pointer + 1) % DS3231_REGISTER_COUNT;
+    }
+
+    sim->transactions++;
+    sim_bus_delay(sim, 1 + address_size + tx_buffer_size, 1);
+
+    return ESP_OK;
+}
+
+void ds3231_sim_init(ds3231_sim_t *sim, uint32_t bus_freq_hz)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->address = DS3231_ADDRESS;
+    sim->registers[DS3231_CONTROL_REGISTER_ADDRESS] = DS3231_SIM_CONTROL_DEFAULT;
+    sim->registers[DS3231_STATUS_REGISTER_ADDRESS] = DS3231_SIM_STATUS_DEFAULT;
+    ds3231_sim_power_loss(sim);
+    ds3231_sim_set_temperature(sim, 25.0f);
+    ds3231_sim_set_bus_freq(sim, bus_freq_hz);
+}
+
+void ds3231_sim_set_bus_freq(ds3231_sim_t *sim, uint32_t bus_freq_hz)
+{
+    sim->bus_freq_hz = bus_freq_hz;
+    sim->byte_time_ns = bus_freq_hz ? (uint32_t)(9ULL * 1000000000ULL / bus_freq_hz) : 0;
+}
+
+void ds3231_sim_get_backend(ds3231_sim_t *sim, ds3231_bus_backend_t *backend)
+{
+    backend->write_read = sim_write_read;
+    backend->write = sim_write;
+    backend->recover = sim_recover;
+    backend->ctx = sim;
+}
+
+void ds3231_sim_inject_nack(ds3231_sim_t *sim, uint32_t count)
+{
+    sim->fault_nack = count;
+}
+
+void ds3231_sim_inject_stuck(ds3231_sim_t *sim, bool stuck)
+{
+    sim->fault_stuck = stuck;
+}
+
+void ds3231_sim_set_response_delay(ds3231_sim_t *sim, uint32_t delay_us)
+{
+    sim->fault_delay_us = delay_us;
+}
+
+void ds3231_sim_tick(ds3231_sim_t *sim)
+{
+    int64_t now = esp_timer_get_time();
+
+    while (now >= sim->next_tick_us)
+    {
+        sim_advance_second(sim);
+        sim_schedule_tick(sim);
+
+        // INTCN = 0 and RS2 = RS1 = 0: 1 Hz square wave, the falling edge comes with the seconds update
+        uint8_t control = sim->registers[DS3231_CONTROL_REGISTER_ADDRESS];
+        if (sim->sqw_edge != NULL &&
+            (control & (DS3231_CONTROL_INTCN | DS3231_CONTROL_RS2 | DS3231_CONTROL_RS1)) == 0)
+            sim->sqw_edge();
+    }
+}
+
+void ds3231_sim_set_temperature(ds3231_sim_t *sim, float temp)
+{
+    int16_t quarters = (int16_t)floorf(temp * 4.0f);
+
+    sim->registers[DS3231_ADDRESS_TEMPERATURE] = (uint8_t)(int8_t)(quarters >> 2);
+    sim->registers[DS3231_ADDRESS_TEMPERATURE + 1] = (uint8_t)((quarters & 0x03) << 6);
+}
+
+void ds3231_sim_set_drift(ds3231_sim_t *sim, float drift_ppm, float temp_coeff_ppm)
+{
+    sim->drift_ppm = drift_ppm;
+    sim->temp_coeff_ppm = temp_coeff_ppm;
+}
+
+void ds3231_sim_power_loss(ds3231_sim_t *sim)
+{
+    uint8_t *r = sim->registers;
+
+    // 2000-01-01 00:00:00, Saturday (1 - Sunday)
+    r[0] = 0x00;
+    r[1] = 0x00;
+    r[2] = 0x00;
+    r[3] = 0x07;
+    r[4] = 0x01;
+    r[5] = 0x01;
+    r[6] = 0x00;
+    r[DS3231_STATUS_REGISTER_ADDRESS] |= DS3231_STATUS_OSF;
+    sim->next_tick_us = esp_timer_get_time();
+    sim->tick_frac_ns = 0;
+    sim_schedule_tick(sim);
+}
+
+uint32_t ds3231_sim_transfer_time_ns(const ds3231_sim_t *sim, size_t bytes, size_t starts)
+{
+    if (sim->bus_freq_hz == 0)
+        return 0;
+
+    // 9 SCL periods per byte (8 data bits + ACK), one period per START and for the STOP
+    uint64_t periods = 9ULL * bytes + starts + 1;
+
+    return (uint32_t)(periods * 1000000000ULL / sim->bus_freq_hz);
+}
+
+esp_err_t ds3231_sim_set_time(ds3231_sim_t *sim, int64_t epoch_us)
+{
+    int64_t seconds = epoch_us / SIM_SECOND_US;
+    int64_t fraction_us = epoch_us % SIM_SECOND_US;
+
+    if (fraction_us < 0)
+    {
+        seconds--;
+        fraction_us += SIM_SECOND_US;
+    }
+
+    esp_err_t result = ds3231_epoch_to_regs(seconds, sim->registers);
+    if (result != ESP_OK)
+        return result;
+
+    sim->next_tick_us = esp_timer_get_time() - fraction_us;
+    sim->tick_frac_ns = 0;
+    sim_schedule_tick(sim);
+
+    return ESP_OK;
+}
+
+void ds3231_sim_bus_init(ds3231_sim_bus_t *bus)
+{
+    memset(bus, 0, sizeof(*bus));
+}
+
+esp_err_t ds3231_sim_bus_attach(ds3231_sim_bus_t *bus, ds3231_sim_t *sim, uint8_t address)
+{
+    if (address > 0x7F)
+        return ESP_ERR_INVALID_ARG;
+
+    for (size_t i = 0; i < bus->count; i++)
+        if (bus->chips[i]->address == address)
+            return ESP_ERR_INVALID_ARG;
+
+    if (bus->count == DS3231_SIM_BUS_MAX_CHIPS)
+        return ESP_ERR_NO_MEM;
+
+    sim->address = address;
+    bus->chips[bus->count++] = sim;
+
+    return ESP_OK;
+}
+
+// Model answering to device_address, the first one when nobody does (it NACKs the address)
+static ds3231_sim_t *sim_bus_route(ds3231_sim_bus_t *bus, uint8_t device_address)
+{
+    for (size_t i = 0; i < bus->count; i++)
+        if (bus->chips[i]->address == device_address)
+            return bus->chips[i];
+
+    return bus->count > 0 ? bus->chips[0] : NULL;
+}
+
+static esp_err_t sim_bus_write_read(void *ctx, uint8_t device_address, const uint8_t *write_buffer, size_t write_size,
+                                    uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
+{
+    ds3231_sim_t *sim = sim_bus_route((ds3231_sim_bus_t *)ctx, device_address);
+
+    if (sim == NULL)
+        return ESP_FAIL;
+
+    return sim_write_read(sim, device_address, write_buffer, write_size, read_buffer, read_size, ticks_to_wait);
+}
+
+static esp_err_t sim_bus_write(void *ctx, uint8_t device_address, const uint8_t *address, size_t address_size,
+                               const uint8_t *tx_buffer, size_t tx_buffer_size, TickType_t ticks_to_wait)
+{
+    ds3231_sim_t *sim = sim_bus_route((ds3231_sim_bus_t *)ctx, device_address);
+
+    if (sim == NULL)
+        return ESP_FAIL;
+
+    return sim_write(sim, device_address, address, address_size, tx_buffer, tx_buffer_size, ticks_to_wait);
+}
+
+static esp_err_t sim_bus_recover(void *ctx)
+{
+    ds3231_sim_bus_t *bus = (ds3231_sim_bus_t *)ctx;
+
+    for (size_t i = 0; i < bus->count; i++)
+        sim_recover(bus->chips[i]);
+
+    return ESP_OK;
+}
+
+void ds3231_sim_bus_get_backend(ds3231_sim_bus_t *bus, ds3231_bus_backend_t *backend)
+{
+    backend->write_read = sim_bus_write_read;
+    backend->write = sim_bus_write;
+    backend->recover = sim_bus_recover;
+    backend->ctx = bus;
+}
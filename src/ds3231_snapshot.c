@@ -0,0 +1,158 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_snapshot.h"
+#include "ds3231_time_service.h"
+
+#include <esp_timer.h>
+
+static ds3231_snapshot_cell_t snapshot_cell = DS3231_SNAPSHOT_CELL_INIT();
+static TaskHandle_t snapshot_task;
+#if DS3231_STATIC_ALLOCATION
+static StaticTask_t snapshot_tcb;
+static StackType_t snapshot_stack[DS3231_SNAPSHOT_STACK_SIZE];
+#endif
+static uint32_t snapshot_period_ms;
+
+void ds3231_snapshot_store(ds3231_snapshot_cell_t *cell, const ds3231_snapshot_t *snapshot)
+{
+    portENTER_CRITICAL(&cell->writer);
+    unsigned int seq = atomic_load_explicit(&cell->seq, memory_order_relaxed);
+
+    // Odd: readers which see it, or see it change, retry
+    atomic_store_explicit(&cell->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    cell->data = *snapshot;
+
+    atomic_store_explicit(&cell->seq, seq + 2, memory_order_release);
+    portEXIT_CRITICAL(&cell->writer);
+}
+
+bool ds3231_snapshot_load(ds3231_snapshot_cell_t *cell, ds3231_snapshot_t *snapshot)
+{
+    unsigned int before;
+    unsigned int after;
+
+    do
+    {
+        before = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (before == 0)
+            return false;
+        if (before & 1)
+            continue;
+
+        *snapshot = *(volatile ds3231_snapshot_t *)&cell->data;
+
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&cell->seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    return true;
+}
+
+static void snapshot_update_task(void *pvParameters)
+{
+    ds3231_ts_stats_t stats;
+    uint32_t resyncs = UINT32_MAX;
+    ds3231_snapshot_t snapshot = {0};
+    TickType_t wake = xTaskGetTickCount();
+
+    while (1)
+    {
+        int64_t epoch_us;
+
+        esp_err_t result = ds3231_ts_get_time(&epoch_us);
+        int64_t mono_us = esp_timer_get_time();
+
+        if (result == ESP_OK)
+        {
+            ds3231_ts_get_stats(&stats);
+            if (stats.resyncs != resyncs)
+            {
+                // The time registers were just read, refresh OSF at the same pace
+                uint8_t osf = 0;
+                uint8_t status;
+
+                resyncs = stats.resyncs;
+                if (ds3231_power_lost(&osf, &status) == ESP_OK)
+                    snapshot.osf = osf;
+                snapshot.last_sync_us = mono_us;
+            }
+
+            snapshot.epoch_us = epoch_us;
+            snapshot.mono_us = mono_us;
+            ds3231_snapshot_store(&snapshot_cell, &snapshot);
+        }
+        else
+        {
+            ESP_LOGW(DS3231_TAG, "Snapshot update failed: %s", esp_err_to_name(result));
+        }
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(snapshot_period_ms));
+    }
+}
+
+esp_err_t ds3231_snapshot_start(uint32_t period_ms, UBaseType_t priority)
+{
+    if (snapshot_task != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    snapshot_period_ms = period_ms != 0 ? period_ms : DS3231_SNAPSHOT_PERIOD_MS;
+#if DS3231_STATIC_ALLOCATION
+    snapshot_task = xTaskCreateStatic(snapshot_update_task, "DS3231 Snapshot Task", DS3231_SNAPSHOT_STACK_SIZE, NULL,
+                                      priority, snapshot_stack, &snapshot_tcb);
+#else
+    if (xTaskCreate(snapshot_update_task, "DS3231 Snapshot Task", DS3231_SNAPSHOT_STACK_SIZE, NULL, priority,
+                    &snapshot_task) != pdPASS)
+        return ESP_ERR_NO_MEM;
+#endif
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_snapshot_get(ds3231_snapshot_t *snapshot)
+{
+    if (snapshot == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    return ds3231_snapshot_load(&snapshot_cell, snapshot) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t ds3231_snapshot_get_time_us(int64_t *epoch_us)
+{
+    ds3231_snapshot_t snapshot;
+
+    if (epoch_us == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    if (!ds3231_snapshot_load(&snapshot_cell, &snapshot))
+        return ESP_ERR_INVALID_STATE;
+
+    *epoch_us = snapshot.epoch_us + (esp_timer_get_time() - snapshot.mono_us);
+
+    return ESP_OK;
+}
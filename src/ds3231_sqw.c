@@ -0,0 +1,356 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_sqw.h"
+#include "ds3231_epoch.h"
+#include "ds3231_regmap.h"
+
+#include <esp_timer.h>
+
+#define SQW_SYNC_TIMEOUT_MS 2000
+
+static portMUX_TYPE sqw_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool sqw_synced;
+static volatile int64_t sqw_epoch;
+static volatile int64_t sqw_edge_us;
+// Semaphores of the waiting tasks, each lives on the stack of its ds3231_sqw_wait_tick()
+static SemaphoreHandle_t sqw_waiters[DS3231_SQW_MAX_WAITERS];
+static SemaphoreHandle_t sqw_edge_sem;
+#if DS3231_STATIC_ALLOCATION
+static StaticSemaphore_t sqw_edge_sem_buffer;
+static StaticTask_t sqw_verify_tcb;
+static StackType_t sqw_verify_stack[DS3231_SQW_VERIFY_STACK_SIZE];
+#endif
+static bool sqw_running;
+static uint32_t sqw_verify_interval_s;
+static ds3231_sqw_stats_t sqw_stats;
+
+// Count an edge and take the waiters out of their slots, sqw_lock is held by the caller
+static int IRAM_ATTR sqw_count_edge(int64_t now, SemaphoreHandle_t *waiters)
+{
+    int count = 0;
+
+    if (sqw_synced)
+        sqw_epoch++;
+    sqw_edge_us = now;
+    sqw_stats.edges++;
+
+    for (int i = 0; i < DS3231_SQW_MAX_WAITERS; i++)
+    {
+        if (sqw_waiters[i] != NULL)
+        {
+            waiters[count++] = sqw_waiters[i];
+            sqw_waiters[i] = NULL;
+        }
+    }
+
+    return count;
+}
+
+static void IRAM_ATTR sqw_isr_handler(void *arg)
+{
+    SemaphoreHandle_t waiters[DS3231_SQW_MAX_WAITERS];
+    BaseType_t woken = pdFALSE;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&sqw_lock);
+    int count = sqw_count_edge(now, waiters);
+    portEXIT_CRITICAL_ISR(&sqw_lock);
+
+    for (int i = 0; i < count; i++)
+        xSemaphoreGiveFromISR(waiters[i], &woken);
+    if (sqw_edge_sem != NULL)
+        xSemaphoreGiveFromISR(sqw_edge_sem, &woken);
+
+    if (woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Task context: the simulator's tick task stands in for the interrupt
+void ds3231_sqw_inject_edge(void)
+{
+    SemaphoreHandle_t waiters[DS3231_SQW_MAX_WAITERS];
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&sqw_lock);
+    int count = sqw_count_edge(now, waiters);
+    portEXIT_CRITICAL(&sqw_lock);
+
+    for (int i = 0; i < count; i++)
+        xSemaphoreGive(waiters[i]);
+    if (sqw_edge_sem != NULL)
+        xSemaphoreGive(sqw_edge_sem);
+}
+
+// Wait for an edge and read the time registers right behind it
+static esp_err_t sqw_read_after_edge(int64_t *epoch)
+{
+    // Only an edge which comes after this point counts
+    xSemaphoreTake(sqw_edge_sem, 0);
+    if (xSemaphoreTake(sqw_edge_sem, pdMS_TO_TICKS(SQW_SYNC_TIMEOUT_MS)) != pdTRUE)
+        return ESP_ERR_TIMEOUT;
+
+    return ds3231_get_epoch(epoch);
+}
+
+esp_err_t ds3231_sqw_verify(void)
+{
+    int64_t epoch;
+
+    if (!sqw_synced)
+        return ESP_ERR_INVALID_STATE;
+
+    esp_err_t result = sqw_read_after_edge(&epoch);
+    if (result != ESP_OK)
+        return result;
+
+    portENTER_CRITICAL(&sqw_lock);
+    sqw_stats.verifications++;
+    if (sqw_epoch != epoch)
+    {
+        sqw_stats.corrections++;
+        sqw_epoch = epoch;
+    }
+    portEXIT_CRITICAL(&sqw_lock);
+
+    return ESP_OK;
+}
+
+static void sqw_verify_task(void *pvParameters)
+{
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(sqw_verify_interval_s * 1000));
+
+        esp_err_t result = ds3231_sqw_verify();
+        if (result != ESP_OK)
+            ESP_LOGW(DS3231_TAG, "SQW time verification failed: %s", esp_err_to_name(result));
+    }
+}
+
+// Undo a failed ds3231_sqw_start(), only what it set up itself
+static void sqw_release(gpio_num_t sqw_io, bool handler_added, bool service_installed)
+{
+    if (handler_added)
+        gpio_isr_handler_remove(sqw_io);
+    if (service_installed)
+        gpio_uninstall_isr_service();
+
+    portENTER_CRITICAL(&sqw_lock);
+    SemaphoreHandle_t sem = sqw_edge_sem;
+    sqw_edge_sem = NULL;
+    sqw_synced = false;
+    portEXIT_CRITICAL(&sqw_lock);
+
+    if (sem != NULL)
+        vSemaphoreDelete(sem);
+}
+
+esp_err_t ds3231_sqw_start(gpio_num_t sqw_io, uint32_t verify_interval_s)
+{
+    bool handler_added = false;
+    bool service_installed = false;
+    int64_t epoch;
+
+    if (sqw_running)
+        return ESP_ERR_INVALID_STATE;
+
+#if DS3231_STATIC_ALLOCATION
+    sqw_edge_sem = xSemaphoreCreateBinaryStatic(&sqw_edge_sem_buffer);
+#else
+    sqw_edge_sem = xSemaphoreCreateBinary();
+#endif
+    if (sqw_edge_sem == NULL)
+        return ESP_ERR_NO_MEM;
+
+    if (sqw_io != GPIO_NUM_NC)
+    {
+        gpio_config_t conf = {
+            .pin_bit_mask = 1ULL << sqw_io,
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_ENABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_NEGEDGE};
+
+        esp_err_t result = gpio_config(&conf);
+        if (result == ESP_OK)
+        {
+            // Somebody else may have installed the ISR service already, then it stays
+            result = gpio_install_isr_service(0);
+            service_installed = result == ESP_OK;
+            if (result == ESP_ERR_INVALID_STATE)
+                result = ESP_OK;
+        }
+        if (result == ESP_OK)
+        {
+            result = gpio_isr_handler_add(sqw_io, sqw_isr_handler, NULL);
+            handler_added = result == ESP_OK;
+        }
+        if (result != ESP_OK)
+        {
+            sqw_release(sqw_io, handler_added, service_installed);
+            return result;
+        }
+    }
+
+    // INTCN = 0, RS2 = RS1 = 0: 1 Hz square wave on INT/SQW
+    esp_err_t result = ds3231_regmap_update_bits(DS3231_CONTROL_REGISTER_ADDRESS,
+                                                 DS3231_CONTROL_INTCN | DS3231_CONTROL_RS2 | DS3231_CONTROL_RS1, 0);
+    if (result == ESP_OK)
+        result = ds3231_regmap_flush();
+    if (result == ESP_OK)
+        result = sqw_read_after_edge(&epoch);
+
+    if (result != ESP_OK)
+    {
+        sqw_release(sqw_io, handler_added, service_installed);
+        return result;
+    }
+
+    portENTER_CRITICAL(&sqw_lock);
+    sqw_epoch = epoch;
+    sqw_synced = true;
+    portEXIT_CRITICAL(&sqw_lock);
+
+    if (verify_interval_s > 0)
+    {
+        sqw_verify_interval_s = verify_interval_s;
+#if DS3231_STATIC_ALLOCATION
+        xTaskCreateStatic(sqw_verify_task, "SQW Verify Task", DS3231_SQW_VERIFY_STACK_SIZE, NULL, 1, sqw_verify_stack,
+                          &sqw_verify_tcb);
+#else
+        if (xTaskCreate(sqw_verify_task, "SQW Verify Task", DS3231_SQW_VERIFY_STACK_SIZE, NULL, 1, NULL) != pdPASS)
+        {
+            sqw_release(sqw_io, handler_added, service_installed);
+            return ESP_ERR_NO_MEM;
+        }
+#endif
+    }
+
+    sqw_running = true;
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_sqw_get_time(int64_t *epoch, int64_t *edge_us)
+{
+    if (epoch == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&sqw_lock);
+    bool synced = sqw_synced;
+    *epoch = sqw_epoch;
+    if (edge_us != NULL)
+        *edge_us = sqw_edge_us;
+    portEXIT_CRITICAL(&sqw_lock);
+
+    return synced ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t ds3231_sqw_get_time_us(int64_t *epoch_us)
+{
+    int64_t epoch;
+    int64_t edge_us;
+
+    if (epoch_us == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t result = ds3231_sqw_get_time(&epoch, &edge_us);
+    if (result != ESP_OK)
+        return result;
+
+    // A late edge must not make the time jump past the next second
+    int64_t offset = esp_timer_get_time() - edge_us;
+    if (offset > 999999)
+        offset = 999999;
+
+    *epoch_us = epoch * 1000000 + offset;
+
+    return ESP_OK;
+}
+
+// The task notifications of the caller stay untouched, it may use them for something else
+esp_err_t ds3231_sqw_wait_tick(TickType_t ticks_to_wait, int64_t *epoch, int64_t *edge_us)
+{
+    StaticSemaphore_t edge_buffer;
+    SemaphoreHandle_t edge;
+    int slot = -1;
+
+    if (!sqw_synced)
+        return ESP_ERR_INVALID_STATE;
+
+    edge = xSemaphoreCreateBinaryStatic(&edge_buffer);
+
+    portENTER_CRITICAL(&sqw_lock);
+    for (int i = 0; i < DS3231_SQW_MAX_WAITERS; i++)
+    {
+        if (sqw_waiters[i] == NULL)
+        {
+            sqw_waiters[i] = edge;
+            slot = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&sqw_lock);
+
+    if (slot < 0)
+    {
+        vSemaphoreDelete(edge);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t result = ESP_OK;
+    if (xSemaphoreTake(edge, ticks_to_wait) != pdTRUE)
+    {
+        portENTER_CRITICAL(&sqw_lock);
+        bool missed = sqw_waiters[slot] == edge;
+        if (missed)
+            sqw_waiters[slot] = NULL;
+        portEXIT_CRITICAL(&sqw_lock);
+
+        // An edge which came between the timeout and the lock has taken the semaphore out of its slot
+        // and is about to give it, wait for that before it goes off the stack
+        if (missed)
+            result = ESP_ERR_TIMEOUT;
+        else
+            xSemaphoreTake(edge, portMAX_DELAY);
+    }
+    vSemaphoreDelete(edge);
+
+    if (result == ESP_OK && epoch != NULL)
+        return ds3231_sqw_get_time(epoch, edge_us);
+
+    return result;
+}
+
+void ds3231_sqw_get_stats(ds3231_sqw_stats_t *stats)
+{
+    portENTER_CRITICAL(&sqw_lock);
+    *stats = sqw_stats;
+    portEXIT_CRITICAL(&sqw_lock);
+}
@@ -0,0 +1,213 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_stats.h"
+
+#include <stdatomic.h>
+
+static const char *const stats_op_names[DS3231_STATS_OP_COUNT] = {"read", "write"};
+static const char *const stats_err_names[DS3231_STATS_ERR_COUNT] = {
+    "ok", "fail", "timeout", "invalid_state", "invalid_arg", "other"};
+
+#if DS3231_STATS_ENABLE
+
+// Same layout as ds3231_stats_t, every counter updated with relaxed atomics
+typedef struct
+{
+  atomic_uint lock_wait[DS3231_STATS_OP_COUNT][DS3231_STATS_BUCKETS];
+  atomic_uint bus_time[DS3231_STATS_OP_COUNT][DS3231_STATS_BUCKETS];
+  atomic_uint registers[DS3231_STATS_OP_COUNT][DS3231_REGISTER_COUNT];
+  atomic_uint errors[DS3231_STATS_OP_COUNT][DS3231_STATS_ERR_COUNT];
+  atomic_uint lock_timeouts[DS3231_STATS_OP_COUNT];
+  atomic_uint max_lock_wait_us[DS3231_STATS_OP_COUNT];
+  atomic_uint max_bus_time_us[DS3231_STATS_OP_COUNT];
+} stats_counters_t;
+
+_Static_assert(sizeof(stats_counters_t) == sizeof(ds3231_stats_t), "counter layouts differ");
+
+static stats_counters_t stats_counters;
+
+static inline void stats_inc(atomic_uint *counter)
+{
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+static inline void stats_max(atomic_uint *counter, uint32_t value)
+{
+    unsigned int current = atomic_load_explicit(counter, memory_order_relaxed);
+
+    while (value > current &&
+           !atomic_compare_exchange_weak_explicit(counter, &current, value, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+static inline uint32_t stats_bucket(uint32_t us)
+{
+    uint32_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+
+    return bucket < DS3231_STATS_BUCKETS ? bucket : DS3231_STATS_BUCKETS - 1;
+}
+
+static ds3231_stats_err_t stats_err(esp_err_t result)
+{
+    switch (result)
+    {
+    case ESP_OK:
+        return DS3231_STATS_ERR_OK;
+    case ESP_FAIL:
+        return DS3231_STATS_ERR_FAIL;
+    case ESP_ERR_TIMEOUT:
+        return DS3231_STATS_ERR_TIMEOUT;
+    case ESP_ERR_INVALID_STATE:
+        return DS3231_STATS_ERR_INVALID_STATE;
+    case ESP_ERR_INVALID_ARG:
+        return DS3231_STATS_ERR_INVALID_ARG;
+    default:
+        return DS3231_STATS_ERR_OTHER;
+    }
+}
+
+void ds3231_stats_record(ds3231_stats_op_t op, uint8_t reg, uint32_t lock_wait_us, uint32_t bus_time_us,
+                         bool lock_timeout, esp_err_t result)
+{
+    stats_inc(&stats_counters.lock_wait[op][stats_bucket(lock_wait_us)]);
+    stats_max(&stats_counters.max_lock_wait_us[op], lock_wait_us);
+
+    if (lock_timeout)
+    {
+        stats_inc(&stats_counters.lock_timeouts[op]);
+    }
+    else
+    {
+        stats_inc(&stats_counters.bus_time[op][stats_bucket(bus_time_us)]);
+        stats_max(&stats_counters.max_bus_time_us[op], bus_time_us);
+    }
+
+    if (reg < DS3231_REGISTER_COUNT)
+        stats_inc(&stats_counters.registers[op][reg]);
+    stats_inc(&stats_counters.errors[op][stats_err(result)]);
+}
+
+void ds3231_stats_get(ds3231_stats_t *stats)
+{
+    const atomic_uint *src = (const atomic_uint *)&stats_counters;
+    uint32_t *dst = (uint32_t *)stats;
+
+    for (size_t i = 0; i < sizeof(*stats) / sizeof(uint32_t); i++)
+        dst[i] = atomic_load_explicit(&src[i], memory_order_relaxed);
+}
+
+void ds3231_stats_reset(void)
+{
+    atomic_uint *counters = (atomic_uint *)&stats_counters;
+
+    for (size_t i = 0; i < sizeof(stats_counters) / sizeof(atomic_uint); i++)
+        atomic_store_explicit(&counters[i], 0, memory_order_relaxed);
+}
+
+#else
+
+void ds3231_stats_get(ds3231_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void ds3231_stats_reset(void)
+{
+}
+
+#endif
+
+// Upper bound of a histogram bucket in us, 0 for the open-ended last bucket
+static uint32_t stats_bucket_limit(int bucket)
+{
+    return bucket < DS3231_STATS_BUCKETS - 1 ? 1UL << bucket : 0;
+}
+
+void ds3231_stats_print(void)
+{
+    ds3231_stats_t stats;
+
+#if !DS3231_STATS_ENABLE
+    printf("Statistics are disabled (DS3231_STATS_ENABLE 0)\n");
+    return;
+#endif
+
+    ds3231_stats_get(&stats);
+
+    for (int op = 0; op < DS3231_STATS_OP_COUNT; op++)
+    {
+        printf("%s: lock timeouts %u, max lock wait %u us, max bus time %u us\n", stats_op_names[op],
+               stats.lock_timeouts[op], stats.max_lock_wait_us[op], stats.max_bus_time_us[op]);
+
+        printf("  results:");
+        for (int e = 0; e < DS3231_STATS_ERR_COUNT; e++)
+            printf(" %s %u", stats_err_names[e], stats.errors[op][e]);
+        printf("\n");
+
+        printf("  registers:");
+        for (int r = 0; r < DS3231_REGISTER_COUNT; r++)
+            if (stats.registers[op][r] != 0)
+                printf(" 0x%02X %u", r, stats.registers[op][r]);
+        printf("\n");
+
+        printf("  < us      lock wait   bus time\n");
+        for (int b = 0; b < DS3231_STATS_BUCKETS; b++)
+        {
+            if (stats.lock_wait[op][b] == 0 && stats.bus_time[op][b] == 0)
+                continue;
+            if (stats_bucket_limit(b) != 0)
+                printf("  %-8u  %-10u  %u\n", stats_bucket_limit(b), stats.lock_wait[op][b], stats.bus_time[op][b]);
+            else
+                printf("  more      %-10u  %u\n", stats.lock_wait[op][b], stats.bus_time[op][b]);
+        }
+    }
+}
+
+void ds3231_stats_write_csv(FILE *out)
+{
+    ds3231_stats_t stats;
+
+    ds3231_stats_get(&stats);
+
+    fprintf(out, "section,op,key,value\n");
+    for (int op = 0; op < DS3231_STATS_OP_COUNT; op++)
+    {
+        const char *name = stats_op_names[op];
+
+        for (int b = 0; b < DS3231_STATS_BUCKETS; b++)
+            fprintf(out, "lock_wait_us,%s,%u,%u\n", name, stats_bucket_limit(b), stats.lock_wait[op][b]);
+        for (int b = 0; b < DS3231_STATS_BUCKETS; b++)
+            fprintf(out, "bus_time_us,%s,%u,%u\n", name, stats_bucket_limit(b), stats.bus_time[op][b]);
+        for (int r = 0; r < DS3231_REGISTER_COUNT; r++)
+            fprintf(out, "register,%s,0x%02X,%u\n", name, r, stats.registers[op][r]);
+        for (int e = 0; e < DS3231_STATS_ERR_COUNT; e++)
+            fprintf(out, "result,%s,%s,%u\n", name, stats_err_names[e], stats.errors[op][e]);
+        fprintf(out, "lock_timeouts,%s,,%u\n", name, stats.lock_timeouts[op]);
+        fprintf(out, "max_lock_wait_us,%s,,%u\n", name, stats.max_lock_wait_us[op]);
+        fprintf(out, "max_bus_time_us,%s,,%u\n", name, stats.max_bus_time_us[op]);
+    }
+}
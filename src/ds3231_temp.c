@@ -0,0 +1,281 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_temp.h"
+#include "ds3231_regmap.h"
+
+#include <esp_timer.h>
+
+#define TEMP_POLL_MS 10
+#define TEMP_FROM_QUARTERS(q) ((q) * 0.25f)
+
+static SemaphoreHandle_t temp_mutex;
+#if DS3231_STATIC_ALLOCATION
+static StaticSemaphore_t temp_mutex_buffer;
+#endif
+
+static ds3231_temp_config_t temp_config = {
+    .max_age_ms = DS3231_TEMP_MAX_AGE_MS,
+    .force_conversion = false,
+    .ewma_alpha = DS3231_TEMP_EWMA_ALPHA};
+
+static ds3231_temp_stats_t temp_stats;
+
+// History ring, temp_head is the next slot to write
+static ds3231_temp_sample_t temp_ring[DS3231_TEMP_HISTORY_SIZE];
+static uint32_t temp_head;
+static uint32_t temp_count;
+static float temp_ewma;
+
+esp_err_t ds3231_temp_init(const ds3231_temp_config_t *config)
+{
+    if (config != NULL && (config->max_age_ms == 0 || !(config->ewma_alpha > 0.0f && config->ewma_alpha <= 1.0f)))
+        return ESP_ERR_INVALID_ARG;
+
+    if (temp_mutex == NULL)
+    {
+#if DS3231_STATIC_ALLOCATION
+        temp_mutex = xSemaphoreCreateMutexStatic(&temp_mutex_buffer);
+#else
+        temp_mutex = xSemaphoreCreateMutex();
+#endif
+        if (temp_mutex == NULL)
+            return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(temp_mutex, portMAX_DELAY);
+    if (config != NULL)
+        temp_config = *config;
+    temp_head = 0;
+    temp_count = 0;
+    memset(&temp_stats, 0, sizeof(temp_stats));
+    xSemaphoreGive(temp_mutex);
+
+    return ESP_OK;
+}
+
+static void temp_record(int16_t quarters)
+{
+    float temp = TEMP_FROM_QUARTERS(quarters);
+
+    temp_ewma = temp_count == 0 ? temp : temp_ewma + temp_config.ewma_alpha * (temp - temp_ewma);
+
+    temp_ring[temp_head].quarters = quarters;
+    temp_ring[temp_head].read_us = esp_timer_get_time();
+    temp_head = (temp_head + 1) % DS3231_TEMP_HISTORY_SIZE;
+    if (temp_count < DS3231_TEMP_HISTORY_SIZE)
+        temp_count++;
+}
+
+static const ds3231_temp_sample_t *temp_last(void)
+{
+    return &temp_ring[(temp_head + DS3231_TEMP_HISTORY_SIZE - 1) % DS3231_TEMP_HISTORY_SIZE];
+}
+
+static esp_err_t temp_read(int16_t *quarters)
+{
+    uint8_t data[2];
+
+    // The shadow would hand out its own copy, this read is meant to reach the chip
+    ds3231_regmap_invalidate(DS3231_ADDRESS_TEMPERATURE, 2);
+    esp_err_t result = ds3231_regmap_read(DS3231_ADDRESS_TEMPERATURE, data, 2);
+    if (result == ESP_OK)
+        *quarters = (int16_t)(int8_t)data[0] << 2 | data[1] >> 6;
+
+    return result;
+}
+
+// Poll reg until the bits in mask are clear
+static esp_err_t temp_wait_clear(uint8_t reg, uint8_t mask, int64_t deadline_us)
+{
+    uint8_t value;
+
+    while (1)
+    {
+        ds3231_regmap_invalidate(reg, 1);
+        esp_err_t result = ds3231_regmap_read(reg, &value, 1);
+        if (result != ESP_OK)
+            return result;
+        if ((value & mask) == 0)
+            return ESP_OK;
+        if (esp_timer_get_time() >= deadline_us)
+            return ESP_ERR_TIMEOUT;
+        vTaskDelay(pdMS_TO_TICKS(TEMP_POLL_MS));
+    }
+}
+
+static esp_err_t temp_convert(int16_t *quarters)
+{
+    int64_t deadline = esp_timer_get_time() + DS3231_TEMP_CONVERSION_TIMEOUT_MS * 1000LL;
+
+    // A conversion started by the chip itself has to finish first, BSY tells about it
+    esp_err_t result = temp_wait_clear(DS3231_STATUS_REGISTER_ADDRESS, DS3231_STATUS_BSY, deadline);
+    if (result == ESP_OK)
+        result = ds3231_regmap_update_bits(DS3231_CONTROL_REGISTER_ADDRESS, DS3231_CONTROL_CONV, DS3231_CONTROL_CONV);
+    if (result == ESP_OK)
+        result = ds3231_regmap_flush();
+    // CONV stays set until the conversion is complete
+    if (result == ESP_OK)
+        result = temp_wait_clear(DS3231_CONTROL_REGISTER_ADDRESS, DS3231_CONTROL_CONV, deadline);
+    if (result == ESP_OK)
+        result = temp_read(quarters);
+
+    if (result == ESP_OK)
+        temp_stats.conversions++;
+
+    return result;
+}
+
+esp_err_t ds3231_temp_get(float *temp)
+{
+    int16_t quarters;
+    esp_err_t result;
+
+    if (temp == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (temp_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(temp_mutex, portMAX_DELAY);
+
+    // The cached sample is served for max_age_ms after its read. The chip may have converted since then, the
+    // default of half the conversion period bounds how far behind the cache gets.
+    if (temp_count > 0 && esp_timer_get_time() - temp_last()->read_us < temp_config.max_age_ms * 1000LL)
+    {
+        *temp = TEMP_FROM_QUARTERS(temp_last()->quarters);
+        temp_stats.hits++;
+        xSemaphoreGive(temp_mutex);
+        return ESP_OK;
+    }
+
+    result = temp_config.force_conversion ? temp_convert(&quarters) : temp_read(&quarters);
+    if (result == ESP_OK)
+    {
+        temp_stats.reads++;
+        temp_record(quarters);
+        *temp = TEMP_FROM_QUARTERS(quarters);
+    }
+    else
+    {
+        temp_stats.errors++;
+    }
+
+    xSemaphoreGive(temp_mutex);
+
+    return result;
+}
+
+esp_err_t ds3231_temp_convert(float *temp)
+{
+    int16_t quarters;
+
+    if (temp_mutex == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(temp_mutex, portMAX_DELAY);
+
+    esp_err_t result = temp_convert(&quarters);
+    if (result == ESP_OK)
+    {
+        temp_record(quarters);
+        if (temp != NULL)
+            *temp = TEMP_FROM_QUARTERS(quarters);
+    }
+    else
+    {
+        temp_stats.errors++;
+    }
+
+    xSemaphoreGive(temp_mutex);
+
+    return result;
+}
+
+void ds3231_temp_get_history(ds3231_temp_history_t *history)
+{
+    int32_t sum = 0;
+    int16_t min = INT16_MAX;
+    int16_t max = INT16_MIN;
+
+    memset(history, 0, sizeof(*history));
+    if (temp_mutex == NULL)
+        return;
+
+    xSemaphoreTake(temp_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; i < temp_count; i++)
+    {
+        int16_t q = temp_ring[i].quarters;
+        sum += q;
+        if (q < min)
+            min = q;
+        if (q > max)
+            max = q;
+    }
+
+    history->count = temp_count;
+    if (temp_count > 0)
+    {
+        history->last = TEMP_FROM_QUARTERS(temp_last()->quarters);
+        history->min = TEMP_FROM_QUARTERS(min);
+        history->max = TEMP_FROM_QUARTERS(max);
+        history->mean = TEMP_FROM_QUARTERS((float)sum / temp_count);
+        history->ewma = temp_ewma;
+    }
+    xSemaphoreGive(temp_mutex);
+}
+
+size_t ds3231_temp_get_samples(ds3231_temp_sample_t *samples, size_t max_count)
+{
+    if (temp_mutex == NULL)
+        return 0;
+
+    xSemaphoreTake(temp_mutex, portMAX_DELAY);
+    size_t count = temp_count < max_count ? temp_count : max_count;
+    // The oldest of the requested samples
+    uint32_t index = (temp_head + DS3231_TEMP_HISTORY_SIZE - count) % DS3231_TEMP_HISTORY_SIZE;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        samples[i] = temp_ring[index];
+        index = (index + 1) % DS3231_TEMP_HISTORY_SIZE;
+    }
+    xSemaphoreGive(temp_mutex);
+
+    return count;
+}
+
+void ds3231_temp_get_stats(ds3231_temp_stats_t *stats)
+{
+    if (temp_mutex == NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    xSemaphoreTake(temp_mutex, portMAX_DELAY);
+    *stats = temp_stats;
+    xSemaphoreGive(temp_mutex);
+}
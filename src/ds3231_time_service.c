@@ -0,0 +1,195 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_time_service.h"
+#include "ds3231_epoch.h"
+
+#include <esp_timer.h>
+
+#define TS_SECOND_US 1000000LL
+
+static portMUX_TYPE ts_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static ds3231_ts_config_t ts_config = {
+    .resync_interval_ms = DS3231_TS_RESYNC_INTERVAL_MS,
+    .min_resync_interval_ms = DS3231_TS_MIN_RESYNC_INTERVAL_MS,
+    .drift_threshold_ms = DS3231_TS_DRIFT_THRESHOLD_MS};
+
+static ds3231_ts_stats_t ts_stats;
+
+// Cached time line: epoch = base_epoch_us + (esp_timer - base_mono_us)
+static bool ts_valid;
+static int64_t ts_base_epoch_us;
+static int64_t ts_base_mono_us;
+static int64_t ts_next_resync_us;
+static uint32_t ts_interval_ms = DS3231_TS_RESYNC_INTERVAL_MS;
+
+esp_err_t ds3231_ts_init(const ds3231_ts_config_t *config)
+{
+    if (config != NULL && (config->resync_interval_ms == 0 || config->min_resync_interval_ms == 0 ||
+                           config->min_resync_interval_ms > config->resync_interval_ms))
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&ts_lock);
+    if (config != NULL)
+        ts_config = *config;
+    ts_interval_ms = ts_config.resync_interval_ms;
+    ts_valid = false;
+    memset(&ts_stats, 0, sizeof(ts_stats));
+    portEXIT_CRITICAL(&ts_lock);
+
+    return ESP_OK;
+}
+
+// Reads the RTC, *deviation_us (optional) is how far the extrapolated time line was outside the RTC's second
+static esp_err_t ts_resync(int64_t *epoch_us, int64_t *deviation_us)
+{
+    uint8_t regs[7];
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t result = ds3231_read_data(DS3231_TIME_ADDRESS, 1, regs, 7);
+    int64_t end = esp_timer_get_time();
+
+    if (result != ESP_OK)
+    {
+        portENTER_CRITICAL(&ts_lock);
+        ts_stats.errors++;
+        portEXIT_CRITICAL(&ts_lock);
+        return result;
+    }
+
+    // The registers were latched somewhere during the transfer, take the middle of it
+    int64_t mono_us = start + (end - start) / 2;
+    int64_t rtc_us = ds3231_regs_to_epoch(regs) * TS_SECOND_US;
+
+    int64_t deviation = 0;
+
+    portENTER_CRITICAL(&ts_lock);
+    ts_stats.resyncs++;
+
+    if (!ts_valid)
+    {
+        ts_base_epoch_us = rtc_us;
+    }
+    else
+    {
+        // The RTC only says the time is somewhere within [rtc_us, rtc_us + 1 s). Keep the extrapolated
+        // time line while it is inside that window, otherwise move it to the nearest edge.
+        int64_t predicted = ts_base_epoch_us + (mono_us - ts_base_mono_us);
+
+        if (predicted < rtc_us)
+            deviation = predicted - rtc_us;
+        else if (predicted >= rtc_us + TS_SECOND_US)
+            deviation = predicted - (rtc_us + TS_SECOND_US - 1);
+
+        ts_base_epoch_us = predicted - deviation;
+
+        if (llabs(deviation) > (int64_t)ts_config.drift_threshold_ms * 1000)
+        {
+            // Drifting: resync more often until the deviation settles
+            ts_stats.drift_events++;
+            ts_interval_ms /= 2;
+            if (ts_interval_ms < ts_config.min_resync_interval_ms)
+                ts_interval_ms = ts_config.min_resync_interval_ms;
+        }
+        else
+        {
+            ts_interval_ms = ts_config.resync_interval_ms;
+        }
+    }
+
+    ts_base_mono_us = mono_us;
+    ts_next_resync_us = mono_us + (int64_t)ts_interval_ms * 1000;
+    ts_valid = true;
+    *epoch_us = ts_base_epoch_us + (esp_timer_get_time() - ts_base_mono_us);
+    portEXIT_CRITICAL(&ts_lock);
+
+    if (deviation_us != NULL)
+        *deviation_us = deviation;
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_ts_get_time(int64_t *epoch_us)
+{
+    if (epoch_us == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&ts_lock);
+    if (ts_valid && now < ts_next_resync_us)
+    {
+        *epoch_us = ts_base_epoch_us + (now - ts_base_mono_us);
+        ts_stats.hits++;
+        portEXIT_CRITICAL(&ts_lock);
+        return ESP_OK;
+    }
+    portEXIT_CRITICAL(&ts_lock);
+
+    return ts_resync(epoch_us, NULL);
+}
+
+esp_err_t ds3231_ts_seed(int64_t epoch_us, uint32_t valid_ms)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (valid_ms == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&ts_lock);
+    ts_base_epoch_us = epoch_us;
+    ts_base_mono_us = now;
+    ts_next_resync_us = now + (int64_t)valid_ms * 1000;
+    ts_interval_ms = ts_config.resync_interval_ms;
+    ts_valid = true;
+    portEXIT_CRITICAL(&ts_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_ts_resync(int64_t *epoch_us, int64_t *deviation_us)
+{
+    if (epoch_us == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    return ts_resync(epoch_us, deviation_us);
+}
+
+void ds3231_ts_invalidate(void)
+{
+    portENTER_CRITICAL(&ts_lock);
+    ts_valid = false;
+    ts_interval_ms = ts_config.resync_interval_ms;
+    portEXIT_CRITICAL(&ts_lock);
+}
+
+void ds3231_ts_get_stats(ds3231_ts_stats_t *stats)
+{
+    portENTER_CRITICAL(&ts_lock);
+    *stats = ts_stats;
+    portEXIT_CRITICAL(&ts_lock);
+}
@@ -0,0 +1,309 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ds3231_warm.h"
+#include "ds3231_proto.h"
+#include "ds3231_time_service.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+
+#define WARM_MAGIC 0x57524D31 // "WRM1"
+
+typedef struct
+{
+  uint32_t magic;
+  bool time_valid;               // epoch_us and sys_us were saved for the next boot
+  int64_t epoch_us;              // RTC time at the save
+  int64_t sys_us;                // gettimeofday() at the save
+  uint8_t osf;
+  uint8_t status;
+  uint32_t cold_boots;
+  uint32_t warm_boots;
+  uint32_t corrections;
+  int64_t cold_first_time_sum_us;
+  int64_t warm_first_time_sum_us;
+  uint16_t crc;                  // CRC-16 of everything in front of it
+} warm_state_t;
+
+// Kept across deep sleep and software resets, random after power-on: the magic and the CRC tell
+static RTC_NOINIT_ATTR warm_state_t warm_state;
+static const char *warm_state_file;
+static portMUX_TYPE warm_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// This boot
+static bool warm_boot;
+static int64_t warm_first_time_us;
+static int64_t warm_verified_us;
+static int64_t warm_correction_us;
+
+static TaskHandle_t warm_task;
+#if DS3231_STATIC_ALLOCATION
+static StaticTask_t warm_tcb;
+static StackType_t warm_stack[DS3231_WARM_STACK_SIZE];
+#endif
+
+static uint16_t warm_crc(const warm_state_t *state)
+{
+    return ds3231_proto_crc16((const uint8_t *)state, offsetof(warm_state_t, crc));
+}
+
+static int64_t warm_system_time_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void warm_set_system_time(int64_t epoch_us)
+{
+    struct timeval tv = {.tv_sec = epoch_us / 1000000, .tv_usec = epoch_us % 1000000};
+
+    settimeofday(&tv, NULL);
+}
+
+// Seal the state after a change and write the state file if there is one
+static esp_err_t warm_commit(void)
+{
+    warm_state_t copy;
+
+    portENTER_CRITICAL(&warm_lock);
+    warm_state.crc = warm_crc(&warm_state);
+    copy = warm_state;
+    portEXIT_CRITICAL(&warm_lock);
+
+    if (warm_state_file == NULL)
+        return ESP_OK;
+
+    FILE *file = fopen(warm_state_file, "wb");
+    if (file == NULL)
+        return ESP_FAIL;
+    size_t written = fwrite(&copy, sizeof(copy), 1, file);
+
+    return fclose(file) == 0 && written == 1 ? ESP_OK : ESP_FAIL;
+}
+
+// false - no valid state, the counters start again
+static bool warm_load(void)
+{
+    if (warm_state_file != NULL)
+    {
+        FILE *file = fopen(warm_state_file, "rb");
+        bool loaded = file != NULL && fread(&warm_state, sizeof(warm_state), 1, file) == 1;
+        if (file != NULL)
+            fclose(file);
+        if (!loaded)
+            warm_state.magic = 0;
+    }
+
+    if (warm_state.magic == WARM_MAGIC && warm_state.crc == warm_crc(&warm_state))
+        return true;
+
+    memset(&warm_state, 0, sizeof(warm_state));
+    warm_state.magic = WARM_MAGIC;
+    return false;
+}
+
+bool ds3231_warm_restore(void)
+{
+    bool valid = warm_load();
+    bool woke = warm_state_file != NULL || esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED;
+    int64_t elapsed_us = warm_system_time_us() - warm_state.sys_us;
+
+    bool warm = valid && woke && warm_state.time_valid && elapsed_us >= 0 &&
+                elapsed_us <= DS3231_WARM_MAX_SLEEP_S * 1000000LL;
+    // A saved time is good for one boot
+    warm_state.time_valid = false;
+
+    if (warm)
+    {
+        int64_t epoch_us = warm_state.epoch_us + elapsed_us;
+
+        warm_set_system_time(epoch_us);
+        // The check task resyncs first, the time service would do it lazily as well
+        ds3231_ts_seed(epoch_us, 2 * DS3231_WARM_VERIFY_DELAY_MS);
+
+        warm_boot = true;
+        warm_first_time_us = esp_timer_get_time();
+        warm_state.warm_boots++;
+        warm_state.warm_first_time_sum_us += warm_first_time_us;
+        ESP_LOGI(DS3231_TAG, "Warm boot after %lld ms asleep, time restored", (long long)(elapsed_us / 1000));
+    }
+    warm_commit();
+
+    return warm;
+}
+
+esp_err_t ds3231_warm_cold_boot(uint8_t *osf, uint8_t *status)
+{
+    uint8_t osf_value, status_value;
+    int64_t epoch_us;
+
+    esp_err_t result = ds3231_power_lost(&osf_value, &status_value);
+    if (result == ESP_OK)
+        result = ds3231_ts_resync(&epoch_us, NULL);
+    if (result != ESP_OK)
+        return result;
+
+    warm_set_system_time(epoch_us);
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&warm_lock);
+    warm_boot = false;
+    warm_first_time_us = now;
+    warm_state.osf = osf_value;
+    warm_state.status = status_value;
+    warm_state.cold_boots++;
+    warm_state.cold_first_time_sum_us += now;
+    portEXIT_CRITICAL(&warm_lock);
+    warm_commit();
+
+    if (osf != NULL)
+        *osf = osf_value;
+    if (status != NULL)
+        *status = status_value;
+
+    return ESP_OK;
+}
+
+static void warm_verify_task(void *pvParameters)
+{
+    uint8_t osf, status;
+    int64_t epoch_us, deviation_us = 0;
+
+    vTaskDelay(pdMS_TO_TICKS(DS3231_WARM_VERIFY_DELAY_MS));
+
+    esp_err_t result = ds3231_power_lost(&osf, &status);
+    if (result == ESP_OK)
+        result = ds3231_ts_resync(&epoch_us, &deviation_us);
+
+    if (result == ESP_OK)
+    {
+        bool corrected = llabs(deviation_us) > DS3231_WARM_MAX_ERROR_MS * 1000LL;
+        if (corrected)
+        {
+            warm_set_system_time(epoch_us);
+            ESP_LOGW(DS3231_TAG, "Restored time was %lld ms off, corrected", (long long)(deviation_us / 1000));
+        }
+        if (osf && !warm_state.osf)
+            ESP_LOGW(DS3231_TAG, "Oscillator stopped during the sleep, the time needs to be confirmed or set");
+
+        portENTER_CRITICAL(&warm_lock);
+        warm_verified_us = esp_timer_get_time();
+        warm_correction_us = deviation_us;
+        warm_state.osf = osf;
+        warm_state.status = status;
+        if (corrected)
+            warm_state.corrections++;
+        portEXIT_CRITICAL(&warm_lock);
+        warm_commit();
+    }
+    else
+    {
+        ESP_LOGW(DS3231_TAG, "Check of the restored time failed: %d (%s)", result, esp_err_to_name(result));
+    }
+
+    vTaskDelete(NULL);
+}
+
+esp_err_t ds3231_warm_verify_start(UBaseType_t priority)
+{
+    if (!warm_boot)
+        return ESP_OK;
+    if (warm_task != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+#if DS3231_STATIC_ALLOCATION
+    warm_task = xTaskCreateStatic(warm_verify_task, "DS3231 Warm Check", DS3231_WARM_STACK_SIZE, NULL, priority,
+                                  warm_stack, &warm_tcb);
+#else
+    if (xTaskCreate(warm_verify_task, "DS3231 Warm Check", DS3231_WARM_STACK_SIZE, NULL, priority, &warm_task) !=
+        pdPASS)
+        return ESP_ERR_NO_MEM;
+#endif
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_warm_save(void)
+{
+    int64_t epoch_us;
+
+    esp_err_t result = ds3231_ts_get_time(&epoch_us);
+    if (result != ESP_OK)
+        return result;
+
+    portENTER_CRITICAL(&warm_lock);
+    warm_state.epoch_us = epoch_us;
+    warm_state.sys_us = warm_system_time_us();
+    warm_state.time_valid = true;
+    portEXIT_CRITICAL(&warm_lock);
+
+    return warm_commit();
+}
+
+void ds3231_warm_set_status(uint8_t osf, uint8_t status)
+{
+    portENTER_CRITICAL(&warm_lock);
+    warm_state.osf = osf;
+    warm_state.status = status;
+    portEXIT_CRITICAL(&warm_lock);
+    warm_commit();
+}
+
+static int64_t warm_average(int64_t sum, uint32_t count)
+{
+    return count > 0 ? sum / count : 0;
+}
+
+void ds3231_warm_get_stats(ds3231_warm_stats_t *stats)
+{
+    portENTER_CRITICAL(&warm_lock);
+    *stats = (ds3231_warm_stats_t){
+        .warm = warm_boot,
+        .first_time_us = warm_first_time_us,
+        .verified_us = warm_verified_us,
+        .correction_us = warm_correction_us,
+        .osf = warm_state.osf,
+        .status = warm_state.status,
+        .cold_boots = warm_state.cold_boots,
+        .warm_boots = warm_state.warm_boots,
+        .corrections = warm_state.corrections,
+        .cold_first_time_avg_us = warm_average(warm_state.cold_first_time_sum_us, warm_state.cold_boots),
+        .warm_first_time_avg_us = warm_average(warm_state.warm_first_time_sum_us, warm_state.warm_boots)};
+    portEXIT_CRITICAL(&warm_lock);
+}
+
+void ds3231_warm_set_state_file(const char *path)
+{
+    warm_state_file = path;
+}
@@ -25,289 +25,689 @@
  */
 
 #include "i2c_ds3231.h"
+#include "ds3231_format.h"
+#include "ds3231_epoch.h"
+#include "ds3231_parse.h"
+#include "ds3231_stats.h"
 
-esp_err_t i2c_ds3231_init(void)
+#include <esp_timer.h>
+#include <esp_rom_sys.h>
+#include <stdatomic.h>
+
+// One lock and backend per I2C port, shared by every device on that bus
+typedef struct
+{
+    SemaphoreHandle_t lock;
+    const ds3231_bus_backend_t *backend;
+    ds3231_bus_backend_t esp_backend; // ESP-IDF backend bound to this port
+    gpio_num_t sda_io;
+    gpio_num_t scl_io;
+    uint32_t clk_speed;
+    ds3231_bus_health_t health;   // Updated with the lock held
+    int32_t read_window_us;       // Single flight: freshness window, DS3231_READ_WINDOW_OFF - off
+    volatile uint32_t reads_done; // Completed reads, tells a caller which transfers finished after it arrived
+    struct
+    {
+        bool valid;
+        uint32_t seq;    // Value of reads_done right after this read
+        uint8_t device_address;
+        uint8_t reg;
+        uint8_t size;
+        int64_t done_us; // Completion of the transaction
+        uint8_t data[DS3231_REGISTER_COUNT];
+    } last_read; // Bytes of the last read, handed to callers which waited for it
+#if DS3231_STATIC_ALLOCATION
+    StaticSemaphore_t lock_buffer;
+    uint8_t cmd_buffer[DS3231_CMD_LINK_SIZE]; // Command link of esp_bus_write(), used with the lock held
+#endif
+} ds3231_bus_t;
+
+static ds3231_bus_t buses[I2C_NUM_MAX];
+static portMUX_TYPE buses_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_err_t esp_bus_write_read(void *ctx, uint8_t device_address, const uint8_t *write_buffer, size_t write_size,
+                                    uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
+{
+    // i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    // i2c_master_start(cmd);
+    // i2c_master_write_byte(cmd, (DS3231_ADDRESS << 1), true);
+    // i2c_master_write(cmd, &address, address_size, true);
+    // i2c_master_start(cmd);
+    // i2c_master_write_byte(cmd, (DS3231_ADDRESS << 1) | I2C_MASTER_READ, true);
+    // i2c_master_read(cmd, rx_buffer, rx_buffer_size, I2C_MASTER_LAST_NACK);
+    // i2c_master_stop(cmd);
+
+    // esp_err_t result = i2c_master_cmd_begin(I2C_MASTER_PORT, cmd, pdMS_TO_TICKS(1000));
+
+    // i2c_cmd_link_delete(cmd);
+
+    // Or we can use
+    // esp_err_t i2c_master_write_read_device(i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer,
+    //                              size_t write_size, uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
+    // Perform a write followed by a read to a device on the I2C bus. A repeated start signal is used between the write
+    // and read, thus, the bus is not released until the two transactions are finished. This function is a wrapper
+    // to i2c_master_start(), i2c_master_write(), i2c_master_read(), etc… It shall only be called in I2C master mode.
+    //
+    return i2c_master_write_read_device((i2c_port_t)(intptr_t)ctx, device_address, write_buffer, write_size,
+                                        read_buffer, read_size, ticks_to_wait);
+}
+
+static esp_err_t esp_bus_write(void *ctx, uint8_t device_address, const uint8_t *address, size_t address_size,
+                               const uint8_t *tx_buffer, size_t tx_buffer_size, TickType_t ticks_to_wait)
+{
+#if DS3231_STATIC_ALLOCATION
+    ds3231_bus_t *bus = &buses[(i2c_port_t)(intptr_t)ctx];
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(bus->cmd_buffer, sizeof(bus->cmd_buffer));
+#else
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+#endif
+    if (cmd == NULL)
+        return ESP_ERR_NO_MEM;
+
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, device_address << 1, true);
+    i2c_master_write(cmd, address, address_size, true);
+
+    i2c_master_write(cmd, tx_buffer, tx_buffer_size, true);
+    i2c_master_stop(cmd);
+    esp_err_t result = i2c_master_cmd_begin((i2c_port_t)(intptr_t)ctx, cmd, ticks_to_wait);
+
+#if DS3231_STATIC_ALLOCATION
+    i2c_cmd_link_delete_static(cmd);
+#else
+    i2c_cmd_link_delete(cmd);
+#endif
+
+    return result;
+}
+
+static esp_err_t esp_bus_install(i2c_port_t port, gpio_num_t sda_io, gpio_num_t scl_io, uint32_t clk_speed)
 {
     i2c_config_t conf = {
         .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA_IO,
+        .sda_io_num = sda_io,
         .sda_pullup_en = GPIO_PULLUP_DISABLE,
-        .scl_io_num = I2C_MASTER_SCL_IO,
+        .scl_io_num = scl_io,
         .scl_pullup_en = GPIO_PULLUP_DISABLE,
-        .master.clk_speed = I2C_MASTER_FREQ_HZ};
+        .master.clk_speed = clk_speed};
+
+    esp_err_t result = i2c_param_config(port, &conf);
+    if (result == ESP_OK)
+        result = i2c_driver_install(port, I2C_MODE_MASTER, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
+
+    return result;
+}
 
-    mutex = xSemaphoreCreateMutex();
-    if (!mutex)
+static esp_err_t esp_bus_recover(void *ctx)
+{
+    i2c_port_t port = (i2c_port_t)(intptr_t)ctx;
+    ds3231_bus_t *bus = &buses[port];
+
+    i2c_driver_delete(port);
+
+    // Bit-bang the lines, a slave in the middle of a read lets go of SDA within 9 clocks
+    gpio_config_t conf = {
+        .pin_bit_mask = (1ULL << bus->sda_io) | (1ULL << bus->scl_io),
+        .mode = GPIO_MODE_INPUT_OUTPUT_OD,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE};
+    gpio_config(&conf);
+    gpio_set_level(bus->sda_io, 1);
+    gpio_set_level(bus->scl_io, 1);
+    esp_rom_delay_us(5);
+
+    for (int i = 0; i < 9 && gpio_get_level(bus->sda_io) == 0; i++)
     {
-        ESP_LOGE(DS3231_TAG, "Could not create device mutex");
-        return ESP_FAIL;
+        gpio_set_level(bus->scl_io, 0);
+        esp_rom_delay_us(5);
+        gpio_set_level(bus->scl_io, 1);
+        esp_rom_delay_us(5);
     }
 
-    esp_err_t result = i2c_param_config(I2C_MASTER_PORT, &conf);
+    // STOP: SDA rises while SCL is high
+    gpio_set_level(bus->scl_io, 0);
+    gpio_set_level(bus->sda_io, 0);
+    esp_rom_delay_us(5);
+    gpio_set_level(bus->scl_io, 1);
+    esp_rom_delay_us(5);
+    gpio_set_level(bus->sda_io, 1);
+    esp_rom_delay_us(5);
+
+    bool released = gpio_get_level(bus->sda_io) == 1;
+
+    esp_err_t result = esp_bus_install(port, bus->sda_io, bus->scl_io, bus->clk_speed);
     if (result != ESP_OK)
+        return result;
+
+    return released ? ESP_OK : ESP_FAIL;
+}
+
+const ds3231_bus_backend_t ds3231_esp_bus_backend = {
+    .write_read = esp_bus_write_read,
+    .write = esp_bus_write,
+    .recover = esp_bus_recover,
+    .ctx = (void *)(intptr_t)I2C_MASTER_PORT};
+
+// Device behind the handle-less API
+ds3231_dev_t ds3231_default_dev;
+
+static esp_err_t bus_init(ds3231_bus_t *bus, const ds3231_dev_config_t *config)
+{
+    if (bus->lock != NULL)
+    {
+        // The bus is already up, the new device has to agree on its setup
+        if (config->backend != NULL ? bus->backend != config->backend
+                                    : (bus->backend != &bus->esp_backend || bus->sda_io != config->sda_io ||
+                                       bus->scl_io != config->scl_io || bus->clk_speed != config->clk_speed))
+            return ESP_ERR_INVALID_STATE;
+
+        return ESP_OK;
+    }
+
+#if DS3231_STATIC_ALLOCATION
+    SemaphoreHandle_t lock = xSemaphoreCreateMutexStatic(&bus->lock_buffer);
+#else
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+#endif
+    if (!lock)
+    {
+        ESP_LOGE(DS3231_TAG, "Could not create bus mutex");
+        return ESP_FAIL;
+    }
+
+    if (config->backend == NULL)
+    {
+        esp_err_t result = esp_bus_install(config->port, config->sda_io, config->scl_io, config->clk_speed);
+        if (result != ESP_OK)
+        {
+            vSemaphoreDelete(lock);
+            return result;
+        }
+
+        bus->esp_backend = ds3231_esp_bus_backend;
+        bus->esp_backend.ctx = (void *)(intptr_t)config->port;
+        bus->backend = &bus->esp_backend;
+    }
+    else
+    {
+        bus->backend = config->backend;
+    }
+
+    bus->sda_io = config->sda_io;
+    bus->scl_io = config->scl_io;
+    bus->clk_speed = config->clk_speed;
+    bus->read_window_us = DS3231_READ_WINDOW_US;
+    bus->lock = lock;
+
+    return ESP_OK;
+}
+
+esp_err_t ds3231_dev_init(ds3231_dev_t *dev, const ds3231_dev_config_t *config)
+{
+    // Published once with release, every reader loads it with acquire
+    static _Atomic(SemaphoreHandle_t) init_lock;
+
+    if (dev == NULL || config == NULL || config->port < 0 || config->port >= I2C_NUM_MAX || config->address > 0x7F)
+        return ESP_ERR_INVALID_ARG;
+
+    if (config->backend != NULL && (config->backend->write_read == NULL || config->backend->write == NULL))
+        return ESP_ERR_INVALID_ARG;
+
+    // Serialise bus set-up, the bus mutexes do not exist yet
+    SemaphoreHandle_t lock = atomic_load_explicit(&init_lock, memory_order_acquire);
+    if (lock == NULL)
     {
+#if DS3231_STATIC_ALLOCATION
+        static StaticSemaphore_t init_lock_buffer;
+        static atomic_flag init_lock_claimed = ATOMIC_FLAG_INIT;
+
+        // Only the first caller constructs the mutex in the buffer, the others wait until it is published
+        if (!atomic_flag_test_and_set(&init_lock_claimed))
+            atomic_store_explicit(&init_lock, xSemaphoreCreateMutexStatic(&init_lock_buffer), memory_order_release);
+        while ((lock = atomic_load_explicit(&init_lock, memory_order_acquire)) == NULL)
+            vTaskDelay(1);
+#else
+        SemaphoreHandle_t created = xSemaphoreCreateMutex();
+        if (created == NULL)
+            return ESP_FAIL;
+
+        // The first mutex published wins, a loser deletes its own and takes the winner's
+        lock = NULL;
+        if (atomic_compare_exchange_strong_explicit(&init_lock, &lock, created, memory_order_acq_rel,
+                                                    memory_order_acquire))
+            lock = created;
+        else
+            vSemaphoreDelete(created);
+#endif
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    ds3231_bus_t *bus = &buses[config->port];
+    esp_err_t result = bus_init(bus, config);
+    xSemaphoreGive(lock);
+
+    if (result != ESP_OK)
         return result;
+
+    dev->port = config->port;
+    dev->address = config->address;
+    dev->sda_io = config->sda_io;
+    dev->scl_io = config->scl_io;
+    dev->clk_speed = config->clk_speed;
+    dev->backend = bus->backend;
+    dev->lock = bus->lock;
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_ds3231_init_backend(const ds3231_bus_backend_t *backend)
+{
+    if (backend == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    ds3231_dev_config_t config = DS3231_DEV_CONFIG_DEFAULT();
+    config.backend = backend;
+
+    return ds3231_dev_init(&ds3231_default_dev, &config);
+}
+
+esp_err_t i2c_ds3231_init(void)
+{
+    ds3231_dev_config_t config = DS3231_DEV_CONFIG_DEFAULT();
+
+    return ds3231_dev_init(&ds3231_default_dev, &config);
+}
+
+// Timeout of one attempt: a multiple of the average transaction time, the upper bound until one was measured
+static TickType_t bus_timeout_ticks(const ds3231_bus_t *bus)
+{
+    uint32_t timeout_ms = I2CDEV_TIMEOUT;
+
+    if (bus->health.avg_transfer_us != 0)
+    {
+        timeout_ms = bus->health.avg_transfer_us * DS3231_TIMEOUT_FACTOR / 1000 + DS3231_TIMEOUT_MIN_MS;
+        if (timeout_ms > I2CDEV_TIMEOUT)
+            timeout_ms = I2CDEV_TIMEOUT;
     }
-    return i2c_driver_install(I2C_MASTER_PORT, I2C_MODE_MASTER, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
+
+    // Round up, a timeout shorter than a tick could expire right away
+    return (timeout_ms * configTICK_RATE_HZ + 999) / 1000;
 }
 
-esp_err_t ds3231_read_data(const uint8_t address, const size_t address_size, uint8_t *rx_buffer, size_t rx_buffer_size)
+static TickType_t bus_backoff_ticks(int attempt)
+{
+    TickType_t ticks = pdMS_TO_TICKS(DS3231_RETRY_BACKOFF_MS << attempt);
+
+    return ticks > 0 ? ticks : 1;
+}
+
+// Longest time the lock can be held by one transaction with all its retries
+static TickType_t bus_lock_ticks(const ds3231_bus_t *bus)
+{
+    TickType_t ticks = (DS3231_RETRY_COUNT + 1) * bus_timeout_ticks(bus);
+
+    for (int attempt = 0; attempt < DS3231_RETRY_COUNT; attempt++)
+        ticks += bus_backoff_ticks(attempt);
+
+    return 2 * ticks;
+}
+
+// One transaction with retries, called with the bus lock held
+static esp_err_t bus_transfer(ds3231_bus_t *bus, const ds3231_dev_t *dev, bool write, const uint8_t *address,
+                              size_t address_size, uint8_t *buffer, size_t buffer_size)
 {
-    esp_err_t result = ESP_OK;
+    const ds3231_bus_backend_t *backend = dev->backend;
+    esp_err_t result;
 
-    if (mutex != NULL)
+    for (int attempt = 0;; attempt++)
     {
-        if (xSemaphoreTake(mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
+        TickType_t timeout = bus_timeout_ticks(bus);
+        int64_t start = esp_timer_get_time();
+
+        if (write)
+            result = backend->write(backend->ctx, dev->address, address, address_size, buffer, buffer_size, timeout);
+        else
+            result = backend->write_read(backend->ctx, dev->address, address, address_size, buffer, buffer_size, timeout);
+
+        if (result == ESP_OK)
+        {
+            uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+            uint32_t avg = bus->health.avg_transfer_us;
+
+            bus->health.avg_transfer_us = avg == 0 ? elapsed : avg - avg / 8 + elapsed / 8;
+            break;
+        }
+
+        // NACKs and timeouts can be glitches, anything else will not go away by trying again
+        if (result != ESP_FAIL && result != ESP_ERR_TIMEOUT)
+            break;
+
+        if (result == ESP_ERR_TIMEOUT && backend->recover != NULL)
         {
-            // i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-            // i2c_master_start(cmd);
-            // i2c_master_write_byte(cmd, (DS3231_ADDRESS << 1), true);
-            // i2c_master_write(cmd, &address, address_size, true);
-            // i2c_master_start(cmd);
-            // i2c_master_write_byte(cmd, (DS3231_ADDRESS << 1) | I2C_MASTER_READ, true);
-            // i2c_master_read(cmd, rx_buffer, rx_buffer_size, I2C_MASTER_LAST_NACK);
-            // i2c_master_stop(cmd);
-
-            // esp_err_t result = i2c_master_cmd_begin(I2C_MASTER_PORT, cmd, pdMS_TO_TICKS(1000));
-
-            // i2c_cmd_link_delete(cmd);
-
-            // Or we can use
-            // esp_err_t i2c_master_write_read_device(i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer,
-            //                              size_t write_size, uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
-            // Perform a write followed by a read to a device on the I2C bus. A repeated start signal is used between the write
-            // and read, thus, the bus is not released until the two transactions are finished. This function is a wrapper
-            // to i2c_master_start(), i2c_master_write(), i2c_master_read(), etc… It shall only be called in I2C master mode.
-            //
-            result = i2c_master_write_read_device(I2C_MASTER_PORT, DS3231_ADDRESS, &address, address_size,
-                                                  rx_buffer, rx_buffer_size, pdMS_TO_TICKS(I2CDEV_TIMEOUT));
+            int64_t recovery_start = esp_timer_get_time();
+            esp_err_t recovered = backend->recover(backend->ctx);
+
+            bus->health.recoveries++;
+            bus->health.last_recovery_us = (uint32_t)(esp_timer_get_time() - recovery_start);
+            if (recovered != ESP_OK)
+            {
+                bus->health.recovery_failures++;
+                ESP_LOGE(DS3231_TAG, "Bus clear at %d failed: %s", dev->port, esp_err_to_name(recovered));
+            }
         }
 
-        xSemaphoreGive(mutex);
+        if (attempt == DS3231_RETRY_COUNT)
+            break;
+
+        bus->health.retries++;
+        vTaskDelay(bus_backoff_ticks(attempt));
     }
 
     return result;
 }
 
-esp_err_t ds3231_write_data(const uint8_t address, const size_t address_size, uint8_t *tx_buffer, size_t tx_buffer_size)
+// Single flight: reuse the last read when it completed after the caller arrived, or within the window before
+static bool bus_shared_read(ds3231_bus_t *bus, const ds3231_dev_t *dev, uint8_t reg, uint8_t *rx_buffer,
+                            size_t rx_buffer_size, uint32_t done_at_arrival, int64_t arrival_us)
+{
+    if (bus->read_window_us == DS3231_READ_WINDOW_OFF || !bus->last_read.valid ||
+        bus->last_read.device_address != dev->address || bus->last_read.reg != reg ||
+        bus->last_read.size != rx_buffer_size)
+        return false;
+
+    // The counter and not the time decides about in flight, esp_timer cannot order events within a microsecond
+    bool in_flight = (int32_t)(bus->last_read.seq - done_at_arrival) > 0;
+    if (!in_flight && (bus->read_window_us == 0 || bus->last_read.done_us < arrival_us - bus->read_window_us))
+        return false;
+
+    memcpy(rx_buffer, bus->last_read.data, rx_buffer_size);
+    bus->health.coalesced_reads++;
+
+    return true;
+}
+
+static void bus_remember_read(ds3231_bus_t *bus, const ds3231_dev_t *dev, uint8_t reg, const uint8_t *rx_buffer,
+                              size_t rx_buffer_size)
+{
+    bus->reads_done++;
+    if (bus->read_window_us == DS3231_READ_WINDOW_OFF || rx_buffer_size > DS3231_REGISTER_COUNT)
+        return;
+
+    bus->last_read.valid = true;
+    bus->last_read.seq = bus->reads_done;
+    bus->last_read.device_address = dev->address;
+    bus->last_read.reg = reg;
+    bus->last_read.size = rx_buffer_size;
+    bus->last_read.done_us = esp_timer_get_time();
+    memcpy(bus->last_read.data, rx_buffer, rx_buffer_size);
+}
+
+esp_err_t ds3231_dev_read_data(ds3231_dev_t *dev, const uint8_t address, const size_t address_size, uint8_t *rx_buffer, size_t rx_buffer_size)
 {
-    esp_err_t result = ESP_OK;
+    esp_err_t result = ESP_ERR_TIMEOUT;
+
+    if (dev->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    ds3231_bus_t *bus = &buses[dev->port];
+    uint32_t done_at_arrival = bus->reads_done;
+    int64_t arrival_us = esp_timer_get_time();
+
+    uint32_t start = DS3231_STATS_TIMESTAMP();
+    bool locked = xSemaphoreTake(dev->lock, bus_lock_ticks(bus)) == pdTRUE;
+    uint32_t acquired = DS3231_STATS_TIMESTAMP();
 
-    if (mutex != NULL)
+    if (locked)
     {
-        if (xSemaphoreTake(mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
+        // Callers queued behind a transaction for the same registers take its bytes
+        if (address_size == 1 && bus_shared_read(bus, dev, address, rx_buffer, rx_buffer_size, done_at_arrival, arrival_us))
         {
-            i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-            i2c_master_start(cmd);
-            i2c_master_write_byte(cmd, DS3231_ADDRESS << 1, true);
-            i2c_master_write(cmd, &address, address_size, true);
-
-            i2c_master_write(cmd, tx_buffer, tx_buffer_size, true);
-            i2c_master_stop(cmd);
-            result = i2c_master_cmd_begin(I2C_MASTER_PORT, cmd, pdMS_TO_TICKS(I2CDEV_TIMEOUT));
-            if (result != ESP_OK)
-                ESP_LOGE(DS3231_TAG, "Could not write to device [0x%02x at %d]: %d (%s)", address, I2C_MASTER_PORT, result, esp_err_to_name(result));
-
-            i2c_cmd_link_delete(cmd);
+            result = ESP_OK;
+        }
+        else
+        {
+            result = bus_transfer(bus, dev, false, &address, address_size, rx_buffer, rx_buffer_size);
+            if (result == ESP_OK && address_size == 1)
+                bus_remember_read(bus, dev, address, rx_buffer, rx_buffer_size);
         }
 
-        xSemaphoreGive(mutex);
+        xSemaphoreGive(dev->lock);
     }
+    else
+    {
+        ESP_LOGE(DS3231_TAG, "Bus lock timeout, read of 0x%02x at %d not done", address, dev->port);
+    }
+
+    ds3231_stats_record(DS3231_STATS_OP_READ, address, DS3231_STATS_ELAPSED_US(start, acquired),
+                        DS3231_STATS_ELAPSED_US(acquired, DS3231_STATS_TIMESTAMP()), !locked, result);
 
     return result;
 }
 
-esp_err_t ds3231_power_lost(uint8_t *status, uint8_t *status_register)
+esp_err_t ds3231_dev_write_data(ds3231_dev_t *dev, const uint8_t address, const size_t address_size, uint8_t *tx_buffer, size_t tx_buffer_size)
 {
-    esp_err_t result = ds3231_read_data(DS3231_STATUS_REGISTER_ADDRESS, 1, status_register, 1);
-    if (result == ESP_OK)
+    esp_err_t result = ESP_ERR_TIMEOUT;
+
+    if (dev->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    ds3231_bus_t *bus = &buses[dev->port];
+
+    uint32_t start = DS3231_STATS_TIMESTAMP();
+    bool locked = xSemaphoreTake(dev->lock, bus_lock_ticks(bus)) == pdTRUE;
+    uint32_t acquired = DS3231_STATS_TIMESTAMP();
+
+    if (locked)
     {
-        *status = *status_register >> 7;
-        // *status = buffer & 0x80;
+        // The shared bytes may now be out of date
+        if (bus->last_read.device_address == dev->address)
+            bus->last_read.valid = false;
+
+        result = bus_transfer(bus, dev, true, &address, address_size, tx_buffer, tx_buffer_size);
+        if (result != ESP_OK)
+            ESP_LOGE(DS3231_TAG, "Could not write to device [0x%02x at %d]: %d (%s)", address, dev->port, result, esp_err_to_name(result));
+
+        xSemaphoreGive(dev->lock);
     }
+    else
+    {
+        ESP_LOGE(DS3231_TAG, "Bus lock timeout, write of 0x%02x at %d not done", address, dev->port);
+    }
+
+    ds3231_stats_record(DS3231_STATS_OP_WRITE, address, DS3231_STATS_ELAPSED_US(start, acquired),
+                        DS3231_STATS_ELAPSED_US(acquired, DS3231_STATS_TIMESTAMP()), !locked, result);
 
     return result;
 }
 
-uint8_t bcd2dec(uint8_t value)
+esp_err_t ds3231_dev_set_read_window(ds3231_dev_t *dev, int32_t window_us)
 {
-    return value - 6 * (value >> 4);
-}
+    if (dev == NULL || window_us < DS3231_READ_WINDOW_OFF)
+        return ESP_ERR_INVALID_ARG;
+    if (dev->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
 
-uint8_t dec2bcd(uint8_t value)
-{
-    return value + 6 * (value / 10);
+    ds3231_bus_t *bus = &buses[dev->port];
+
+    xSemaphoreTake(dev->lock, portMAX_DELAY);
+    bus->read_window_us = window_us;
+    bus->last_read.valid = false;
+    xSemaphoreGive(dev->lock);
+
+    return ESP_OK;
 }
 
-esp_err_t ds3231_get_date_time(char **str_buffer, date_time_format dt_format)
+esp_err_t ds3231_dev_get_bus_health(ds3231_dev_t *dev, ds3231_bus_health_t *health)
 {
-    if (dt_format != DATE_AND_TIME_24 && dt_format != DATE_AND_TIME_AM_PM && dt_format != ONLY_DATE &&
-        dt_format != ONLY_TIME_24 && dt_format != ONLY_TIME_AM_PM && dt_format != UNIX_TIMESTAMPS)
+    if (dev == NULL || health == NULL)
         return ESP_ERR_INVALID_ARG;
+    if (dev->lock == NULL)
+        return ESP_ERR_INVALID_STATE;
 
-    uint8_t buffer_size = 30;
-    // Allocate memory for *str_buffer
-    *str_buffer = (char *)malloc(buffer_size * sizeof(char));
+    ds3231_bus_t *bus = &buses[dev->port];
 
-    if (str_buffer == NULL)
-        return ESP_ERR_NO_MEM;
+    xSemaphoreTake(dev->lock, portMAX_DELAY);
+    *health = bus->health;
+    health->timeout_ms = bus_timeout_ticks(bus) * 1000 / configTICK_RATE_HZ;
+    xSemaphoreGive(dev->lock);
 
-    // Allocate memory for rx_result
-    uint8_t *rx_result = (uint8_t *)malloc(7 * sizeof(uint8_t));
+    return ESP_OK;
+}
 
-    if (rx_result == NULL)
-        return ESP_ERR_NO_MEM;
+esp_err_t ds3231_read_data(const uint8_t address, const size_t address_size, uint8_t *rx_buffer, size_t rx_buffer_size)
+{
+    return ds3231_dev_read_data(&ds3231_default_dev, address, address_size, rx_buffer, rx_buffer_size);
+}
 
-    esp_err_t result = ESP_OK;
+esp_err_t ds3231_write_data(const uint8_t address, const size_t address_size, uint8_t *tx_buffer, size_t tx_buffer_size)
+{
+    return ds3231_dev_write_data(&ds3231_default_dev, address, address_size, tx_buffer, tx_buffer_size);
+}
 
-    result = ds3231_read_data(DS3231_TIME_ADDRESS, 1, rx_result, 7);
+esp_err_t ds3231_dev_power_lost(ds3231_dev_t *dev, uint8_t *status, uint8_t *status_register)
+{
+    esp_err_t result = ds3231_dev_read_data(dev, DS3231_STATUS_REGISTER_ADDRESS, 1, status_register, 1);
+    if (result == ESP_OK)
+    {
+        *status = *status_register >> 7;
+        // *status = buffer & 0x80;
+    }
 
-    if (result != ESP_OK)
-        return result;
+    return result;
+}
 
-    // Allocate memory for time
-    struct tm *time = malloc(1 * sizeof(struct tm));
+esp_err_t ds3231_power_lost(uint8_t *status, uint8_t *status_register)
+{
+    return ds3231_dev_power_lost(&ds3231_default_dev, status, status_register);
+}
 
-    if (time == NULL)
-        return ESP_ERR_NO_MEM;
+uint8_t bcd2dec(uint8_t value)
+{
+    return value - 6 * (value >> 4);
+}
+
+uint8_t dec2bcd(uint8_t value)
+{
+    return value + 6 * (value / 10);
+}
 
-    time->tm_sec = bcd2dec(rx_result[0]);
-    time->tm_min = bcd2dec(rx_result[1]);
+void ds3231_regs_to_tm(const uint8_t *regs, struct tm *time)
+{
+    time->tm_sec = bcd2dec(regs[0]);
+    time->tm_min = bcd2dec(regs[1]);
 
-    if (rx_result[2] & DS3231_12HOUR_FLAG)
+    if (regs[2] & DS3231_12HOUR_FLAG)
     {
-        /* 12H */
-        time->tm_hour = bcd2dec(rx_result[2] & DS3231_12HOUR_MASK) - 1;
+        /* 12H: 12 AM is hour 0, 12 PM is hour 12, as in ds3231_time_to_epoch() */
+        time->tm_hour = bcd2dec(regs[2] & DS3231_12HOUR_MASK) % 12;
         /* AM/PM? */
-        if (rx_result[2] & DS3231_PM_FLAG)
+        if (regs[2] & DS3231_PM_FLAG)
             time->tm_hour += 12;
     }
     else
     {
-        time->tm_hour = bcd2dec(rx_result[2]); /* 24H */
+        time->tm_hour = bcd2dec(regs[2]); /* 24H */
     }
-    time->tm_wday = bcd2dec(rx_result[3]) - 1;
-    time->tm_mday = bcd2dec(rx_result[4]);
-    time->tm_mon = bcd2dec(rx_result[5] & DS3231_MONTH_MASK) - 1;
-    time->tm_year = bcd2dec(rx_result[6]) + 100;
+    time->tm_wday = bcd2dec(regs[3]) - 1;
+    time->tm_mday = bcd2dec(regs[4]);
+    time->tm_mon = bcd2dec(regs[5] & DS3231_MONTH_MASK) - 1;
+    time->tm_year = bcd2dec(regs[6]) + ((regs[5] & DS3231_CENTURY_FLAG) ? 200 : 100);
     time->tm_isdst = 0;
+}
+
+esp_err_t ds3231_dev_get_date_time_r(ds3231_dev_t *dev, char *str_buffer, size_t buffer_size, date_time_format dt_format)
+{
+    const ds3231_format_t *format = ds3231_format_get(dt_format);
+
+    if (format == NULL && dt_format != UNIX_TIMESTAMPS)
+        return ESP_ERR_INVALID_ARG;
+
+    if (str_buffer == NULL || buffer_size == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    uint8_t rx_result[7];
 
-    size_t res = 0;
-
-    if (dt_format == DATE_AND_TIME_24)
-        res = strftime(*str_buffer, buffer_size, "%Y-%m-%d %H:%M:%S", time);
-    else if (dt_format == DATE_AND_TIME_AM_PM)
-        res = strftime(*str_buffer, buffer_size, "%Y-%m-%d %I:%M:%S %p", time);
-    else if (dt_format == ONLY_DATE)
-        res = strftime(*str_buffer, buffer_size, "%Y-%m-%d", time);
-    else if (dt_format == ONLY_TIME_24)
-        res = strftime(*str_buffer, buffer_size, "%H:%M:%S", time);
-    else if (dt_format == ONLY_TIME_AM_PM)
-        res = strftime(*str_buffer, buffer_size, "%I:%M:%S %p", time);
-    else if (dt_format == UNIX_TIMESTAMPS)
+    esp_err_t result = ds3231_dev_read_data(dev, DS3231_TIME_ADDRESS, 1, rx_result, 7);
+
+    if (result != ESP_OK)
+        return result;
+
+    if (format != NULL)
     {
-        time_t t_of_day = mktime(time);
-        int i = sprintf(*str_buffer, "%ld", (long)t_of_day);
-        if (i < 0)
+        // Rendered straight from the BCD registers, no struct tm and no strftime
+        if (ds3231_format_render(format, rx_result, str_buffer, buffer_size) == 0)
             result = ESP_ERR_INVALID_ARG;
     }
-
-    if (res == 0 && dt_format != UNIX_TIMESTAMPS)
+    else
     {
-        result = ESP_ERR_INVALID_ARG;
+        // UNIX_TIMESTAMPS, use ds3231_get_epoch() to get the number itself
+        int i = snprintf(str_buffer, buffer_size, "%lld", (long long)ds3231_regs_to_epoch(rx_result));
+        if (i < 0 || (size_t)i >= buffer_size)
+            result = ESP_ERR_INVALID_ARG;
     }
 
-    // Freeing allocated memory
-    if (rx_result != NULL)
-        free(rx_result);
-
-    // Freeing allocated memory
-    if (time != NULL)
-        free(time);
-
     return result;
 }
 
-esp_err_t ds3231_set_date_time(char *date_time_str)
+esp_err_t ds3231_get_date_time_r(char *str_buffer, size_t buffer_size, date_time_format dt_format)
 {
-    // esp_err_t result = ESP_OK;
-
-    uint8_t str_len = strlen(date_time_str);
-    char delim[] = ",";
-    uint8_t num_of_delimiters = 0;
-    uint8_t position = 0;
-
-    int sec = 0;
-    int min = 0;
-    int hour = 0;
-    int dow = 0;
-    int day = 0;
-    int month = 0;
-    int year = 0;
+    return ds3231_dev_get_date_time_r(&ds3231_default_dev, str_buffer, buffer_size, dt_format);
+}
 
-    // check number of delimiters in the string
-    for (uint8_t i = 0; i < str_len; i++)
-    {
-        if (date_time_str[i] == ',')
-            num_of_delimiters++;
-    }
+esp_err_t ds3231_dev_get_date_time(ds3231_dev_t *dev, char **str_buffer, date_time_format dt_format)
+{
+#if DS3231_STATIC_ALLOCATION
+    *str_buffer = NULL;
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    // Allocate memory for *str_buffer
+    *str_buffer = (char *)malloc(DS3231_DATE_TIME_STR_SIZE * sizeof(char));
 
-    if (num_of_delimiters != 6)
-        return ESP_ERR_INVALID_ARG;
+    if (*str_buffer == NULL)
+        return ESP_ERR_NO_MEM;
 
-    // split string by delimiter and convert the result into integer
-    char *ptr = strtok(date_time_str, delim);
-    sec = atoi(ptr);
+    esp_err_t result = ds3231_dev_get_date_time_r(dev, *str_buffer, DS3231_DATE_TIME_STR_SIZE, dt_format);
 
-    while (ptr != NULL)
+    // Nothing to hand over to the caller on error
+    if (result != ESP_OK)
     {
-        ptr = strtok(NULL, delim);
-
-        if (position == 0)
-            min = atoi(ptr);
-        else if (position == 1)
-            hour = atoi(ptr);
-        else if (position == 2)
-            dow = atoi(ptr);
-        else if (position == 3)
-            day = atoi(ptr);
-        else if (position == 4)
-            month = atoi(ptr);
-        else if (position == 5)
-            year = atoi(ptr);
-
-        position++;
+        free(*str_buffer);
+        *str_buffer = NULL;
     }
 
-    // check input values
-    if (sec < 0 || sec > 59 || min < 0 || min > 59 || hour < 0 || hour > 23 || dow < 1 || dow > 7 || day < 1 || day > 31 || month < 1 || month > 12 || year < 0 || year > 99)
-        return ESP_ERR_INVALID_ARG;
+    return result;
+#endif
+}
 
-    if ((year % 4) == 0 && month == 2 && (day < 1 || day > 29))
-        return ESP_ERR_INVALID_ARG;
+esp_err_t ds3231_get_date_time(char **str_buffer, date_time_format dt_format)
+{
+    return ds3231_dev_get_date_time(&ds3231_default_dev, str_buffer, dt_format);
+}
 
-    if ((year % 4) != 0 && month == 2 && (day < 1 || day > 28))
-        return ESP_ERR_INVALID_ARG;
+esp_err_t ds3231_dev_set_date_time(ds3231_dev_t *dev, const char *date_time_str)
+{
+    uint8_t data[7];
 
-    if (day == 31 && month != 1 && month != 3 && month != 5 && month != 7 && month != 8 && month != 10 && month != 12)
+    if (date_time_str == NULL)
         return ESP_ERR_INVALID_ARG;
 
-    uint8_t data[7];
-    data[0] = dec2bcd(sec);
-    data[1] = dec2bcd(min);
-    data[2] = dec2bcd(hour);
-    data[3] = dec2bcd(dow);
-    data[4] = dec2bcd(day);
-    data[5] = dec2bcd(month);
-    data[6] = dec2bcd(year);
+    esp_err_t result = ds3231_parse_date_time(date_time_str, strlen(date_time_str), data);
+    if (result != ESP_OK)
+        return result;
 
-    return ds3231_write_data(DS3231_TIME_ADDRESS, 1, data, 7);
+    return ds3231_dev_write_data(dev, DS3231_TIME_ADDRESS, 1, data, 7);
 }
 
-esp_err_t ds3231_get_temperature(float *temp)
+esp_err_t ds3231_set_date_time(const char *date_time_str)
+{
+    return ds3231_dev_set_date_time(&ds3231_default_dev, date_time_str);
+}
+
+esp_err_t ds3231_dev_get_temperature(ds3231_dev_t *dev, float *temp)
 {
     uint8_t data[2];
-    esp_err_t result = ds3231_read_data(DS3231_ADDRESS_TEMPERATURE, 1, data, 2);
+    esp_err_t result = ds3231_dev_read_data(dev, DS3231_ADDRESS_TEMPERATURE, 1, data, 2);
     if (result == ESP_OK)
     {
         *temp = ((int16_t)(int8_t)data[0] << 2 | data[1] >> 6) * 0.25;
@@ -315,3 +715,8 @@ esp_err_t ds3231_get_temperature(float *temp)
 
     return result;
 }
+
+esp_err_t ds3231_get_temperature(float *temp)
+{
+    return ds3231_dev_get_temperature(&ds3231_default_dev, temp);
+}
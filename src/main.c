@@ -25,7 +25,323 @@
  */
 
 #include "i2c_ds3231.h"
-#include "rom/uart.h"
+#include "ds3231_time_service.h"
+#include "ds3231_regmap.h"
+#include "ds3231_temp.h"
+#include "ds3231_stats.h"
+#include "ds3231_bench.h"
+#include "ds3231_snapshot.h"
+#include "ds3231_proto.h"
+#include "driver/uart.h"
+#include "esp_heap_caps.h"
+
+#define CONSOLE_UART_NUM UART_NUM_0     // UART of the console
+#define CONSOLE_RX_BUF_SIZE 256         // RX ring buffer of the UART driver
+#define CONSOLE_EVENT_QUEUE_SIZE 16     // UART events and pending line positions
+#define CONSOLE_FRAME_TIMEOUT_MS 100    // Longest gap within a binary frame
+#define CONSOLE_TASK_STACK_SIZE 3072
+#define SIM_CLOCK_STACK_SIZE 2048
+#define SIM_DRIFT_PPM 5.0f              // Crystal error of the simulated DS3231 with DS3231_USE_CAL
+#define SIM_TEMP_COEFF_PPM 0.04f        // and its change per degree
+
+#if DS3231_STATIC_ALLOCATION
+static StaticTask_t console_tcb;
+static StackType_t console_stack[CONSOLE_TASK_STACK_SIZE];
+#endif
+
+#if DS3231_USE_SIMULATOR
+#include "ds3231_sim.h"
+
+static ds3231_sim_t ds3231_sim;
+static ds3231_bus_backend_t ds3231_sim_backend;
+#endif
+
+#if DS3231_USE_SQW
+#include "ds3231_sqw.h"
+#endif
+
+#if DS3231_USE_CAL
+#include "ds3231_cal.h"
+#endif
+
+#if DS3231_USE_LOG
+#include "ds3231_log.h"
+#include "ds3231_epoch.h"
+#include "esp_system.h"
+
+// Event ids of the event log, names in tools/ds3231_log_decode.py
+#define MAIN_EVENT_BOOT 1        // Payload: esp_reset_reason()
+#define MAIN_EVENT_TIME_SET 2
+#define MAIN_EVENT_OSF_CLEARED 3
+#define MAIN_EVENT_NOTE 4        // Payload: text of the LOG command
+
+static ds3231_log_t event_log;
+#endif
+
+#if DS3231_USE_WARM_BOOT
+#include "ds3231_warm.h"
+#include "esp_sleep.h"
+#endif
+
+#if DS3231_USE_SIMULATOR && DS3231_USE_SQW
+#if DS3231_STATIC_ALLOCATION
+static StaticTask_t sim_clock_tcb;
+static StackType_t sim_clock_stack[SIM_CLOCK_STACK_SIZE];
+#endif
+
+// Stands in for the SQW interrupt: advances the model so it delivers its edges on time
+static void sim_clock_task(void *pvParameters)
+{
+    while (1)
+    {
+        if (xSemaphoreTake(ds3231_default_dev.lock, portMAX_DELAY) == pdTRUE)
+        {
+            ds3231_sim_tick(&ds3231_sim);
+            xSemaphoreGive(ds3231_default_dev.lock);
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+#endif
+
+// OSF bit global value
+uint8_t osf_bit_value;
+// Control/Status register global value
+uint8_t status_reg_value;
+
+// Failures are logged and the console keeps going, the next command simply tries again
+static bool report_error(esp_err_t result, const char *what)
+{
+    if (result != ESP_OK)
+        ESP_LOGE(MAIN_TAG, "%s failed: %d (%s)", what, result, esp_err_to_name(result));
+
+    return result == ESP_OK;
+}
+
+// Peak use is derived from the lowest free size the heap ever had
+static void report_heap(const char *when)
+{
+    size_t total = heap_caps_get_total_size(MALLOC_CAP_8BIT);
+
+    ESP_LOGI(MAIN_TAG, "Heap %s: %zu bytes used, peak %zu bytes, largest free block %zu bytes", when,
+             total - heap_caps_get_free_size(MALLOC_CAP_8BIT), total - heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+             heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+#if DS3231_USE_LOG
+static void log_event(uint8_t event, const void *data, size_t size)
+{
+    report_error(ds3231_log_append(&event_log, event, data, size), "Logging the event");
+}
+#endif
+
+#if DS3231_USE_WARM_BOOT
+// esp_timer starts after the ROM and the second stage bootloader, their time is not included
+static void report_boot(void)
+{
+    ds3231_warm_stats_t stats;
+
+    ds3231_warm_get_stats(&stats);
+    ESP_LOGI(MAIN_TAG, "%s boot, first timestamp after %lld us, checked against the RTC after %lld us (moved %lld us)",
+             stats.warm ? "Warm" : "Cold", (long long)stats.first_time_us, (long long)stats.verified_us,
+             (long long)stats.correction_us);
+    ESP_LOGI(MAIN_TAG, "First timestamp: cold boots %lld us on average (%u), warm boots %lld us (%u, %u corrected)",
+             (long long)stats.cold_first_time_avg_us, stats.cold_boots, (long long)stats.warm_first_time_avg_us,
+             stats.warm_boots, stats.corrections);
+}
+#endif
+
+static void handle_command(char *buf)
+{
+    char date_time[DS3231_DATE_TIME_STR_SIZE];
+
+    if (buf[0] == 'D' && buf[1] == 'T')
+    {
+        if (report_error(ds3231_get_date_time_r(date_time, sizeof(date_time), DATE_AND_TIME_24), "Reading date and time"))
+            ESP_LOGI(MAIN_TAG, "Current date and time: %s", date_time);
+    }
+    else if (strcmp(buf, "BUS") == 0)
+    {
+        ds3231_bus_health_t health;
+        if (report_error(ds3231_dev_get_bus_health(&ds3231_default_dev, &health), "Reading bus health"))
+            ESP_LOGI(MAIN_TAG,
+                     "Bus: retries %u, recoveries %u (failed %u, last %u us), avg transfer %u us, timeout %u ms, "
+                     "coalesced reads %u",
+                     health.retries, health.recoveries, health.recovery_failures, health.last_recovery_us,
+                     health.avg_transfer_us, health.timeout_ms, health.coalesced_reads);
+    }
+#if DS3231_USE_SIMULATOR
+    else if (strncmp(buf, "FAULT ", 6) == 0)
+    {
+        // FAULT NACK <count>, FAULT STUCK, FAULT DELAY <us>, FAULT OFF
+        if (strncmp(buf + 6, "NACK ", 5) == 0)
+            ds3231_sim_inject_nack(&ds3231_sim, strtoul(buf + 11, NULL, 10));
+        else if (strcmp(buf + 6, "STUCK") == 0)
+            ds3231_sim_inject_stuck(&ds3231_sim, true);
+        else if (strncmp(buf + 6, "DELAY ", 6) == 0)
+            ds3231_sim_set_response_delay(&ds3231_sim, strtoul(buf + 12, NULL, 10));
+        else if (strcmp(buf + 6, "OFF") == 0)
+        {
+            ds3231_sim_inject_nack(&ds3231_sim, 0);
+            ds3231_sim_inject_stuck(&ds3231_sim, false);
+            ds3231_sim_set_response_delay(&ds3231_sim, 0);
+        }
+        else
+            ESP_LOGW(MAIN_TAG, "Unknown fault: %s", buf + 6);
+    }
+#endif
+#if DS3231_USE_CAL
+    else if (strcmp(buf, "CAL TRIM") == 0)
+    {
+        report_error(ds3231_cal_trim(), "Aging offset trim");
+    }
+    else if (strcmp(buf, "CAL") == 0)
+    {
+        ds3231_cal_status_t status;
+        if (report_error(ds3231_cal_get_status(&status), "Reading the calibration"))
+        {
+            ESP_LOGI(MAIN_TAG, "Drift %.3f +- %.3f ppm at %.2f degrees (%.3f ppm/degree), %u samples over %.0f s, "
+                               "RMS error %.0f us",
+                     status.drift_ppm, status.drift_stderr_ppm, status.mean_temp, status.temp_coeff_ppm,
+                     status.samples, status.span_s, status.rms_error_us);
+            ESP_LOGI(MAIN_TAG, "Aging offset %d, %u trims, drift before the first trim %.3f ppm, resync every %u s",
+                     status.aging_offset, status.trims, status.initial_drift_ppm, status.resync_interval_s);
+        }
+    }
+#endif
+#if DS3231_USE_LOG
+    else if (strcmp(buf, "LOG FLUSH") == 0)
+    {
+        report_error(ds3231_log_flush(&event_log), "Writing the event log");
+    }
+    else if (strcmp(buf, "LOG") == 0)
+    {
+        ds3231_log_stats_t stats;
+        if (report_error(ds3231_log_get_stats(&event_log, &stats), "Reading the event log counters"))
+            ESP_LOGI(MAIN_TAG, "Event log: %u events, %.2f bytes/event, %u page writes, %u erases, %u dropped, "
+                               "%u bytes buffered, next page %u",
+                     stats.events, stats.events > 0 ? (float)stats.record_bytes / stats.events : 0.0f,
+                     stats.page_writes, stats.erases, stats.dropped, stats.buffered, stats.next_seq);
+    }
+    else if (strncmp(buf, "LOG ", 4) == 0)
+    {
+        log_event(MAIN_EVENT_NOTE, buf + 4, strlen(buf + 4));
+    }
+#endif
+#if DS3231_USE_WARM_BOOT
+    else if (strncmp(buf, "SLEEP ", 6) == 0)
+    {
+        uint32_t seconds = strtoul(buf + 6, NULL, 10);
+#if DS3231_USE_LOG
+        report_error(ds3231_log_flush(&event_log), "Writing the event log");
+#endif
+        if (seconds > 0 && report_error(ds3231_warm_save(), "Saving the time"))
+        {
+            ESP_LOGI(MAIN_TAG, "Deep sleep for %u s", seconds);
+            esp_sleep_enable_timer_wakeup((uint64_t)seconds * 1000000);
+            esp_deep_sleep_start();
+        }
+    }
+    else if (strcmp(buf, "BOOT") == 0)
+    {
+        report_boot();
+    }
+#endif
+    else if (strcmp(buf, "HEAP") == 0)
+    {
+        report_heap("now");
+    }
+    else if (strcmp(buf, "STATS CSV") == 0)
+    {
+        ds3231_stats_write_csv(stdout);
+    }
+    else if (strcmp(buf, "STATS RESET") == 0)
+    {
+        ds3231_stats_reset();
+        ESP_LOGI(MAIN_TAG, "Statistics cleared");
+    }
+    else if (strcmp(buf, "STATS") == 0)
+    {
+        ds3231_stats_print();
+    }
+    else if (strncmp(buf, "BENCH", 5) == 0)
+    {
+        // Optional argument: clock of the simulated bus, 0 - no bus latency
+        ds3231_bench_config_t config = {
+            .iterations = DS3231_BENCH_ITERATIONS,
+            .bus_freq_hz = buf[5] == ' ' ? strtoul(buf + 6, NULL, 10) : I2C_MASTER_FREQ_HZ,
+#if DS3231_USE_SIMULATOR && !DS3231_USE_SQW
+            // The alarm scheduler switches INT/SQW to the interrupt output, the SQW timekeeping needs the square wave
+            .alarm_sim = &ds3231_sim,
+#endif
+        };
+        esp_err_t result = ds3231_bench_run(&config, stdout);
+        if (result != ESP_OK)
+            ESP_LOGE(MAIN_TAG, "Benchmark failed: %s", esp_err_to_name(result));
+    }
+    else if (buf[0] == 'S' && buf[1] == 'T' && buf[2] == 'H')
+    {
+        ds3231_temp_history_t history;
+        ds3231_temp_stats_t stats;
+        ds3231_temp_get_history(&history);
+        ds3231_temp_get_stats(&stats);
+        ESP_LOGI(MAIN_TAG, "Temperature history: %u samples, last %.2f, min %.2f, max %.2f, mean %.2f, EWMA %.2f",
+                 history.count, history.last, history.min, history.max, history.mean, history.ewma);
+        ESP_LOGI(MAIN_TAG, "Cache hits: %u, reads: %u, conversions: %u, errors: %u",
+                 stats.hits, stats.reads, stats.conversions, stats.errors);
+    }
+    else if (buf[0] == 'S' && buf[1] == 'T' && buf[2] == 'F')
+    {
+        float temp = 0.0;
+        if (report_error(ds3231_temp_convert(&temp), "Temperature conversion"))
+            ESP_LOGI(MAIN_TAG, "Converted temperature: %f degrees Celsius", temp);
+    }
+    else if (buf[0] == 'S' && buf[1] == 'T')
+    {
+        float temp = 0.0;
+        if (report_error(ds3231_temp_get(&temp), "Reading temperature"))
+            ESP_LOGI(MAIN_TAG, "Current temperature: %f degrees Celsius", temp);
+    }
+    else if (buf[0] == 'O' && buf[1] == 'K')
+    {
+        if(osf_bit_value)
+        {
+            // Only OSF is cleared, the alarm flags are left as they are on the chip
+            esp_err_t result = ds3231_regmap_update_bits(DS3231_STATUS_REGISTER_ADDRESS, DS3231_STATUS_OSF, 0);
+            if (result == ESP_OK)
+                result = ds3231_regmap_flush();
+            if (!report_error(result, "Clearing OSF"))
+                return;
+            osf_bit_value = 0;
+            status_reg_value = 0;
+            ESP_LOGW(MAIN_TAG, "Date and time have been confirmed!");
+#if DS3231_USE_WARM_BOOT
+            ds3231_warm_set_status(0, 0);
+#endif
+#if DS3231_USE_LOG
+            log_event(MAIN_EVENT_OSF_CLEARED, NULL, 0);
+#endif
+        }
+        else
+        {
+            ESP_LOGI(MAIN_TAG, "Status Register: 0x%02X, OSF bit: %d", status_reg_value, osf_bit_value);
+        }
+    }
+    else
+    {
+        if (!report_error(ds3231_set_date_time(buf), "Setting date and time"))
+            return;
+        ds3231_ts_invalidate();
+        if (report_error(ds3231_get_date_time_r(date_time, sizeof(date_time), DATE_AND_TIME_24), "Reading date and time"))
+            ESP_LOGI(MAIN_TAG, "New date and time: %s", date_time);
+#if DS3231_USE_LOG
+        // Stamped with the new time, the snapshot may still publish the old one
+        int64_t epoch;
+        if (report_error(ds3231_get_epoch(&epoch), "Reading the epoch"))
+            report_error(ds3231_log_append_at(&event_log, epoch, MAIN_EVENT_TIME_SET, NULL, 0), "Logging the event");
+#endif
+    }
+}
 
 void serial_input_task(void *pvParameters)
 {
@@ -33,114 +349,222 @@ void serial_input_task(void *pvParameters)
                        "Inputs:\n"
                        "DT - Show current date and time\n"
                        "ST - Show temperature\n"
+                       "STH - Show temperature history statistics\n"
+                       "STF - Force a temperature conversion and show the result\n"
+                       "STATS - Show bus transaction statistics, STATS CSV - as CSV, STATS RESET - clear them\n"
+                       "BENCH [bus Hz] - Run the benchmarks against the simulated DS3231, results as JSON\n"
+                       "BUS - Show bus retries, recoveries, coalesced reads and the current timeout\n"
+                       "HEAP - Show current and peak heap use\n"
+#if DS3231_USE_LOG
+                       "LOG <text> - Add a note to the event log, LOG - show its counters, LOG FLUSH - write the buffered page\n"
+#endif
+#if DS3231_USE_WARM_BOOT
+                       "SLEEP <s> - Deep sleep for s seconds and boot warm, BOOT - show the boot timing\n"
+#endif
+#if DS3231_USE_CAL
+                       "CAL - Show the drift estimate and the aging offset, CAL TRIM - trim the aging offset now\n"
+#endif
                        "To set the new date and time enter:\n"
                        "\"sec(0-59),min(0-59),hour(0-23),dow(1-Sun),date(1-31),month(1-12),year(00-99)\" No spaces. No leading 0.\n"
+                       "or ISO 8601 \"YYYY-MM-DDTHH:MM:SS\" (2000-2199)\n"
+                       "Binary frames (ds3231_proto.h, tools/ds3231_client.py) are recognised on the same port.\n"
                        "********************************************************************************************************\n";
 
     printf("%s", base_text);
 
+    static ds3231_proto_parser_t parser;
+    static uint8_t reply[DS3231_PROTO_MAX_FRAME];
+    QueueHandle_t uart_queue;
+    uart_event_t event;
+    uint8_t chunk[64];
     uint8_t buf_len = 21;
     char buf[buf_len];
-    uint8_t idx = 0;
-    uint8_t my_char;
-    STATUS s;
-    char *date_time = NULL;
+    int len = 0;
+
+    // RX ring buffer filled by the UART ISR, the driver queues an event when data arrives and
+    // records where every '\n' is, so a text line is read in one go once it is complete
+    ESP_ERROR_CHECK(uart_driver_install(CONSOLE_UART_NUM, CONSOLE_RX_BUF_SIZE, 0, CONSOLE_EVENT_QUEUE_SIZE, &uart_queue, 0));
+    ESP_ERROR_CHECK(uart_enable_pattern_det_baud_intr(CONSOLE_UART_NUM, '\n', 1, 9, 0, 0));
+    ESP_ERROR_CHECK(uart_pattern_queue_reset(CONSOLE_UART_NUM, CONSOLE_EVENT_QUEUE_SIZE));
 
-    // Clear whole buffer
-    memset(buf, 0, buf_len);
     while (1)
     {
-        // Read cahracters from serial
-        s = uart_rx_one_char(&my_char);
+        // Sleep until the driver reports something, no polling. A frame which stops half way is dropped.
+        TickType_t wait = parser.pos != 0 ? pdMS_TO_TICKS(CONSOLE_FRAME_TIMEOUT_MS) : portMAX_DELAY;
+        if (xQueueReceive(uart_queue, &event, wait) != pdTRUE)
+        {
+            ds3231_proto_reset(&parser);
+            continue;
+        }
+
+        if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL)
+        {
+            ESP_LOGW(MAIN_TAG, "Console input overflow, input dropped");
+            uart_flush_input(CONSOLE_UART_NUM);
+            uart_pattern_queue_reset(CONSOLE_UART_NUM, CONSOLE_EVENT_QUEUE_SIZE);
+            xQueueReset(uart_queue);
+            ds3231_proto_reset(&parser);
+            len = 0;
+            continue;
+        }
 
-        if (s == OK)
+        if (event.type != UART_DATA && event.type != UART_PATTERN_DET)
+            continue;
+
+        size_t buffered = 0;
+        while (uart_get_buffered_data_len(CONSOLE_UART_NUM, &buffered) == ESP_OK && buffered > 0)
         {
-            // check new line character
-            if (my_char == 10)
+            if (len == 0)
             {
-                if (buf[0] == 'D' && buf[1] == 'T')
-                {
-                    date_time = NULL;
-                    ESP_ERROR_CHECK(ds3231_get_date_time(&date_time, DATE_AND_TIME_24));
-                    ESP_LOGI(MAIN_TAG, "Current date and time: %s", date_time);
-                    free(date_time);
-                    memset(buf, 0, buf_len);
-                    idx = 0;
-                }
-                else if (buf[0] == 'S' && buf[1] == 'T')
-                {
-                    float temp = 0.0;
-                    ESP_ERROR_CHECK(ds3231_get_temperature(&temp));
-                    ESP_LOGI(MAIN_TAG, "Current temperature: %f degrees Celsius", temp);
-                    memset(buf, 0, buf_len);
-                    idx = 0;
-                }
-                else if (buf[0] == 'O' && buf[1] == 'K')
+                // The first byte tells a binary frame from a text line, a frame is read up to its end and no further.
+                // Bytes read here move the driver's '\n' positions along, a '\n' inside a frame drops out.
+                size_t want = parser.pos != 0 ? ds3231_proto_missing(&parser) : 1;
+                int n = uart_read_bytes(CONSOLE_UART_NUM, chunk, want < sizeof(chunk) ? want : sizeof(chunk), 0);
+                if (n <= 0)
+                    break;
+
+                for (int i = 0; i < n; i++)
                 {
-                    if(osf_bit_value)
+                    ds3231_proto_feed_t fed = ds3231_proto_feed(&parser, chunk[i]);
+                    if (fed == DS3231_PROTO_FRAME)
                     {
-                        status_reg_value = status_reg_value & ~(1 << 7);
-                        ESP_ERROR_CHECK(ds3231_write_data(DS3231_STATUS_REGISTER_ADDRESS, 1, &status_reg_value, 1));
-                        status_reg_value = 0;
-                        ESP_LOGW(MAIN_TAG, "Date and time have been confirmed!");
+                        size_t reply_len = ds3231_proto_handle(&parser, reply, sizeof(reply));
+                        if (reply_len > 0)
+                            uart_write_bytes(CONSOLE_UART_NUM, reply, reply_len);
                     }
-                    else
+                    else if (fed == DS3231_PROTO_NOT_FRAME && chunk[i] != '\n' && chunk[i] != '\r')
                     {
-                        ESP_LOGI(MAIN_TAG, "Status Register: 0x%02X, OSF bit: %d", status_reg_value, osf_bit_value);
+                        buf[len++] = chunk[i];
                     }
-                    memset(buf, 0, buf_len);
-                    idx = 0;
-                }
-                else
-                {
-                    ESP_ERROR_CHECK(ds3231_set_date_time(buf));
-                    date_time = NULL;
-                    ESP_ERROR_CHECK(ds3231_get_date_time(&date_time, DATE_AND_TIME_24));
-                    ESP_LOGI(MAIN_TAG, "New date and time: %s", date_time);
-                    free(date_time);
-                    memset(buf, 0, buf_len);
-                    idx = 0;
                 }
+                continue;
             }
-            else
+
+            // Rest of the text line, once its '\n' has arrived
+            int pos = uart_pattern_pop_pos(CONSOLE_UART_NUM);
+            if (pos < 0)
+                break;
+
+            // Read the line including its '\n', whatever does not fit into buf is dropped
+            int line_len = pos + 1;
+            int n = uart_read_bytes(CONSOLE_UART_NUM, buf + len, line_len < buf_len - 1 - len ? line_len : buf_len - 1 - len, 0);
+            if (n > 0)
+                len += n;
+            for (int rest = line_len - (n > 0 ? n : 0); rest > 0;)
             {
-                if (idx < buf_len - 1)
-                {
-                    buf[idx] = (char)my_char;
-                    idx++;
-                }
+                int m = uart_read_bytes(CONSOLE_UART_NUM, chunk, rest < (int)sizeof(chunk) ? rest : (int)sizeof(chunk), 0);
+                if (m <= 0)
+                    break;
+                rest -= m;
             }
-        }
 
-        vTaskDelay(pdMS_TO_TICKS(10));
+            // Strip the line ending
+            while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+                len--;
+            buf[len] = 0;
+            len = 0;
+            handle_command(buf);
+        }
     }
 }
 
 void app_main()
 {
+#if !DS3231_STATIC_ALLOCATION
     TaskHandle_t serialInputTaskHandle = NULL;
+#endif
+#if DS3231_USE_SIMULATOR
+    // Run the driver against the simulated DS3231, no I2C traffic.
+    ESP_LOGI(MAIN_TAG, "Initialize the simulated DS3231 (%d Hz bus)", I2C_MASTER_FREQ_HZ);
+    ds3231_sim_init(&ds3231_sim, I2C_MASTER_FREQ_HZ);
+    ds3231_sim_get_backend(&ds3231_sim, &ds3231_sim_backend);
+    report_error(i2c_ds3231_init_backend(&ds3231_sim_backend), "Driver initialisation");
+#else
     // Configure the I2C environment and install driver.
     ESP_LOGI(MAIN_TAG, "Configure the I2C environment and install driver");
-    ESP_ERROR_CHECK(i2c_ds3231_init());
+    report_error(i2c_ds3231_init(), "Driver initialisation");
+#endif
+    report_error(ds3231_ts_init(NULL), "Time service initialisation");
+    report_error(ds3231_regmap_init(), "Register map initialisation");
+    report_error(ds3231_temp_init(NULL), "Temperature service initialisation");
+#if DS3231_USE_WARM_BOOT
+    // After deep sleep the time comes from RTC memory, the RTC is checked later off the critical path
+    bool warm = ds3231_warm_restore();
+#endif
+#if DS3231_USE_CAL
+#if DS3231_USE_SIMULATOR
+    // A perfect model would leave the calibration nothing to find
+    ds3231_sim_set_drift(&ds3231_sim, SIM_DRIFT_PPM, SIM_TEMP_COEFF_PPM);
+#endif
+    // esp_timer is only a fair reference with the simulator, a real board wants an NTP or GPS disciplined one
+    report_error(ds3231_cal_start(NULL, 1), "Drift calibration");
+#endif
+    // Tasks which need the time read it lock free from the snapshot
+    report_error(ds3231_snapshot_start(DS3231_SNAPSHOT_PERIOD_MS, 2), "Snapshot updater");
+#if DS3231_USE_LOG
+    ds3231_log_storage_t log_storage;
+    if (report_error(ds3231_log_partition_storage(&log_storage, NULL), "Finding the event log partition") &&
+        report_error(ds3231_log_init(&event_log, &log_storage), "Event log initialisation"))
+    {
+        uint8_t reason = (uint8_t)esp_reset_reason();
+        log_event(MAIN_EVENT_BOOT, &reason, sizeof(reason));
+    }
+#endif
+
+#if DS3231_USE_SQW
+#if DS3231_USE_SIMULATOR
+    ds3231_sim.sqw_edge = ds3231_sqw_inject_edge;
+#if DS3231_STATIC_ALLOCATION
+    xTaskCreateStatic(sim_clock_task, "Sim Clock Task", SIM_CLOCK_STACK_SIZE, NULL, 5, sim_clock_stack, &sim_clock_tcb);
+#else
+    xTaskCreate(sim_clock_task, "Sim Clock Task", SIM_CLOCK_STACK_SIZE, NULL, 5, NULL);
+#endif
+    report_error(ds3231_sqw_start(GPIO_NUM_NC, DS3231_SQW_VERIFY_S), "SQW timekeeping");
+#else
+    report_error(ds3231_sqw_start(DS3231_SQW_IO, DS3231_SQW_VERIFY_S), "SQW timekeeping");
+#endif
+#endif
 
     // Create Serial Input Task
-    xTaskCreate(serial_input_task, "Serial Input Task", 3072, NULL, 1, &serialInputTaskHandle);
+#if DS3231_STATIC_ALLOCATION
+    xTaskCreateStatic(serial_input_task, "Serial Input Task", CONSOLE_TASK_STACK_SIZE, NULL, 1, console_stack,
+                      &console_tcb);
+#else
+    xTaskCreate(serial_input_task, "Serial Input Task", CONSOLE_TASK_STACK_SIZE, NULL, 1, &serialInputTaskHandle);
+#endif
 
     osf_bit_value = 0;
     status_reg_value = 0;
-    ESP_ERROR_CHECK(ds3231_power_lost(&osf_bit_value, &status_reg_value));
+#if DS3231_USE_WARM_BOOT
+    if (warm)
+    {
+        ds3231_warm_stats_t stats;
+        ds3231_warm_get_stats(&stats);
+        osf_bit_value = stats.osf;
+        status_reg_value = stats.status;
+        report_error(ds3231_warm_verify_start(1), "Starting the RTC check");
+    }
+    else
+    {
+        report_error(ds3231_warm_cold_boot(&osf_bit_value, &status_reg_value), "Reading the RTC");
+    }
+    report_boot();
+#else
+    report_error(ds3231_power_lost(&osf_bit_value, &status_reg_value), "Reading the OSF bit");
+#endif
 
     if (osf_bit_value)
     {
         ESP_LOGW(MAIN_TAG, "Oscillator either is stopped or was stopped for some period. ");
         ESP_LOGW(MAIN_TAG, "Status Register: 0x%02X, OSF bit: %d", status_reg_value, osf_bit_value);
-        char *date_time = NULL;
-        ESP_ERROR_CHECK(ds3231_get_date_time(&date_time, DATE_AND_TIME_24));
-        ESP_LOGW(MAIN_TAG, "Current date and time: %s", date_time);
-        free(date_time);
+        char date_time[DS3231_DATE_TIME_STR_SIZE];
+        if (report_error(ds3231_get_date_time_r(date_time, sizeof(date_time), DATE_AND_TIME_24), "Reading date and time"))
+            ESP_LOGW(MAIN_TAG, "Current date and time: %s", date_time);
         ESP_LOGW(MAIN_TAG, "If the time is correct please enter OK otherwise please enter the new time.");
     }
 
+    report_heap("after start-up");
+
     // Delete "setup and loop" task
     vTaskDelete(NULL);
 
@@ -0,0 +1,257 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The console of main.c against a pseudo-terminal, with the simulated DS3231 behind it. Each command is sent
+// PTY_CALLS times, one at a time, then DT lines are streamed with PTY_WINDOW of them in flight. The latency to
+// the reply and the lines per second are written to stdout as JSON.
+
+#define _GNU_SOURCE
+
+#include "host_test.h"
+#include "ds3231_proto.h"
+
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PTY_CALLS 200          // Round trips per command
+#define PTY_LINES 5000         // Lines of the throughput run
+#define PTY_WINDOW 4           // Lines in flight, never more than the 256 byte RX buffer of the console holds
+#define PTY_TIMEOUT_MS 2000    // Longest wait for a reply
+
+typedef struct
+{
+    const char *name;
+    const char *line;          // Text command, NULL - frame
+    uint8_t cmd;               // Command id of the frame
+    uint8_t payload[4];
+    size_t payload_size;
+    const char *reply;         // Last reply line of a text command starts with this after the log prefix
+} pty_command_t;
+
+static const pty_command_t commands[] = {
+    {"DT", "DT\n", .reply = "Current date and time: "},
+    {"ST", "ST\n", .reply = "Current temperature: "},
+    {"STF", "STF\n", .reply = "Converted temperature: "},
+    {"STH", "STH\n", .reply = "Cache hits: "},
+    {"BUS", "BUS\n", .reply = "Bus: retries "},
+    {"HEAP", "HEAP\n", .reply = "Heap now: "},
+    {"CAL", "CAL\n", .reply = "Aging offset "},
+    {"OK", "OK\n", .reply = "Status Register: "},
+    {"set ISO 8601", "2024-02-29T12:00:00\n", .reply = "New date and time: "},
+    {"set comma", "0,0,12,5,29,2,24\n", .reply = "New date and time: "},
+    {"PING frame", NULL, DS3231_PROTO_CMD_PING},
+    {"BATCH TIME TEMP STATUS frame", NULL, DS3231_PROTO_CMD_BATCH,
+     {DS3231_PROTO_OP_TIME, DS3231_PROTO_OP_TEMP, DS3231_PROTO_OP_STATUS}, 3},
+};
+
+#define PTY_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+void app_main(void);
+
+static SemaphoreHandle_t started;
+static int pty;
+static uint8_t input[4096];
+static size_t input_len;
+static size_t input_pos;
+static ds3231_proto_parser_t parser;
+static char line[512];
+static size_t line_len;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void started_cleanup(void *arg)
+{
+    xSemaphoreGive(started);
+}
+
+// app_main() ends with vTaskDelete(NULL), which exits the thread, the cleanup handler tells when it got there
+static void app_main_task(void *arg)
+{
+    pthread_cleanup_push(started_cleanup, NULL);
+    app_main();
+    pthread_cleanup_pop(1);
+}
+
+static void send_bytes(const void *data, size_t size)
+{
+    for (size_t sent = 0; sent < size;)
+    {
+        ssize_t n = write(pty, (const uint8_t *)data + sent, size - sent);
+        CHECK(n > 0 || errno == EINTR);
+        if (n > 0)
+            sent += n;
+    }
+}
+
+// Next byte from the console, false - nothing before deadline_us
+static bool receive_byte(int64_t deadline_us, uint8_t *byte)
+{
+    while (input_pos == input_len)
+    {
+        int64_t left_us = deadline_us - now_us();
+        struct pollfd fd = {.fd = pty, .events = POLLIN};
+        if (left_us <= 0 || poll(&fd, 1, (int)((left_us + 999) / 1000)) <= 0)
+            return false;
+        ssize_t n = read(pty, input, sizeof(input));
+        if (n > 0)
+        {
+            input_len = n;
+            input_pos = 0;
+        }
+    }
+    *byte = input[input_pos++];
+    return true;
+}
+
+// Reads until a reply frame to cmd or a text line starting with text after the log prefix, false - timeout
+static bool wait_reply(uint8_t cmd, const char *text)
+{
+    int64_t deadline_us = now_us() + PTY_TIMEOUT_MS * 1000LL;
+    uint8_t byte;
+
+    while (receive_byte(deadline_us, &byte))
+    {
+        ds3231_proto_feed_t fed = ds3231_proto_feed(&parser, byte);
+        if (fed == DS3231_PROTO_FRAME)
+        {
+            bool match = text == NULL && parser.frame[2] == (cmd | DS3231_PROTO_REPLY);
+            ds3231_proto_reset(&parser);
+            if (match)
+                return true;
+        }
+        else if (fed == DS3231_PROTO_NOT_FRAME && byte == '\n')
+        {
+            line[line_len] = 0;
+            line_len = 0;
+            const char *message = strstr(line, ": ");
+            if (text != NULL && message != NULL && strncmp(message + 2, text, strlen(text)) == 0)
+                return true;
+        }
+        else if (fed == DS3231_PROTO_NOT_FRAME && byte != '\r' && line_len < sizeof(line) - 1)
+        {
+            line[line_len++] = byte;
+        }
+    }
+
+    return false;
+}
+
+static void send_command(const pty_command_t *command, uint8_t seq)
+{
+    if (command->line != NULL)
+    {
+        send_bytes(command->line, strlen(command->line));
+        return;
+    }
+
+    uint8_t frame[DS3231_PROTO_MAX_FRAME];
+    size_t size = ds3231_proto_encode(command->cmd, seq, command->payload, command->payload_size, frame, sizeof(frame));
+    CHECK(size > 0);
+    send_bytes(frame, size);
+}
+
+static int compare_us(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(void)
+{
+    // stdout becomes the console UART, the results go to where it pointed before
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    CHECK(report != NULL);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    setenv("HOST_LOG_VERBOSE", "1", 1);
+
+    started = xSemaphoreCreateBinary();
+    CHECK(xTaskCreate(app_main_task, "main", 4096, NULL, 1, NULL) == pdPASS);
+    CHECK(xSemaphoreTake(started, pdMS_TO_TICKS(PTY_TIMEOUT_MS)) == pdTRUE);
+    int64_t deadline_us = now_us() + PTY_TIMEOUT_MS * 1000LL;
+    while ((pty = host_uart_pty(UART_NUM_0)) < 0 && now_us() < deadline_us)
+        usleep(1000);
+    CHECK(pty >= 0);
+
+    // The simulated DS3231 powers up with OSF set, confirming the time makes OK answer with the status register
+    send_bytes("OK\n", 3);
+    CHECK(wait_reply(0, "Date and time have been confirmed"));
+
+    static int64_t latency_us[PTY_CALLS];
+    fprintf(report, "{\n  \"calls\": %d,\n  \"commands\": [\n", PTY_CALLS);
+    for (size_t c = 0; c < PTY_COMMANDS; c++)
+    {
+        for (int i = 0; i < PTY_CALLS; i++)
+        {
+            int64_t start_us = now_us();
+            send_command(&commands[c], (uint8_t)i);
+            if (!wait_reply(commands[c].cmd, commands[c].reply))
+            {
+                fprintf(stderr, "No reply to %s\n", commands[c].name);
+                return 1;
+            }
+            latency_us[i] = now_us() - start_us;
+        }
+        qsort(latency_us, PTY_CALLS, sizeof(latency_us[0]), compare_us);
+        fprintf(report, "    {\"command\": \"%s\", \"p50_us\": %lld, \"p99_us\": %lld, \"max_us\": %lld}%s\n",
+                commands[c].name, (long long)latency_us[PTY_CALLS / 2], (long long)latency_us[PTY_CALLS * 99 / 100],
+                (long long)latency_us[PTY_CALLS - 1], c + 1 < PTY_COMMANDS ? "," : "");
+    }
+
+    // Streamed lines, the next one goes out as soon as a reply makes room in the window
+    int sent = 0;
+    int64_t start_us = now_us();
+    for (int answered = 0; answered < PTY_LINES; answered++)
+    {
+        for (; sent < PTY_LINES && sent - answered < PTY_WINDOW; sent++)
+            send_command(&commands[0], 0);
+        if (!wait_reply(0, commands[0].reply))
+        {
+            fprintf(stderr, "No reply to line %d of %d\n", answered, PTY_LINES);
+            return 1;
+        }
+    }
+    int64_t elapsed_us = now_us() - start_us;
+    fprintf(report, "  ],\n  \"lines\": {\"command\": \"%s\", \"lines\": %d, \"window\": %d, \"lines_per_s\": %.0f}\n}\n",
+            commands[0].name, PTY_LINES, PTY_WINDOW, PTY_LINES * 1e6 / elapsed_us);
+    fclose(report);
+
+    // The console task never returns
+    exit(0);
+}
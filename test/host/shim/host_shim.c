@@ -0,0 +1,834 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// FreeRTOS, esp_timer and driver stand-ins for the host build. Tasks are POSIX threads, semaphores
+// and queues a mutex with a condition variable. Good enough to run the driver logic, not its timing.
+
+#define _GNU_SOURCE
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_rom_sys.h>
+#include <esp_partition.h>
+#include <esp_heap_caps.h>
+#include <driver/i2c.h>
+#include <driver/gpio.h>
+#include <hal/cpu_hal.h>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct host_sem
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+struct host_queue
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    size_t item_size;
+    size_t length;
+    size_t head;
+    size_t waiting;
+    uint8_t *items;
+};
+
+struct host_task
+{
+    pthread_t thread;
+    TaskFunction_t function;
+    void *parameters;
+    UBaseType_t priority;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t value;
+    bool pending;
+};
+
+static pthread_mutex_t critical_lock;
+static pthread_once_t critical_once = PTHREAD_ONCE_INIT;
+static _Atomic int64_t timer_offset_us;
+static __thread struct host_task *current_task;
+
+static void critical_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void host_critical_enter(void)
+{
+    pthread_once(&critical_once, critical_init);
+    pthread_mutex_lock(&critical_lock);
+}
+
+void host_critical_exit(void)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+/*
+ * Time
+ */
+
+static int64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return monotonic_ns() / 1000 + atomic_load(&timer_offset_us);
+}
+
+void host_timer_advance(int64_t us)
+{
+    atomic_fetch_add(&timer_offset_us, us);
+}
+
+uint32_t cpu_hal_get_cycle_count(void)
+{
+    return (uint32_t)(monotonic_ns() * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ / 1000);
+}
+
+static void sleep_us(int64_t us)
+{
+    struct timespec delay = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    while (nanosleep(&delay, &delay) != 0)
+        ;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    if (getenv("HOST_REAL_DELAY") != NULL)
+        sleep_us(us);
+}
+
+// Deadline of a wait of ticks on the CLOCK_REALTIME the condition variables use
+static struct timespec deadline(TickType_t ticks)
+{
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    uint64_t ns = (uint64_t)ticks * (1000000000 / configTICK_RATE_HZ);
+    until.tv_sec += ns / 1000000000;
+    until.tv_nsec += ns % 1000000000;
+    if (until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+    return until;
+}
+
+// Wait on cond until woken or the deadline passed, false - timed out
+static bool wait(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t ticks, const struct timespec *until)
+{
+    if (ticks == 0)
+        return false;
+    if (ticks == portMAX_DELAY)
+        return pthread_cond_wait(cond, mutex) == 0;
+    return pthread_cond_timedwait(cond, mutex, until) == 0;
+}
+
+/*
+ * Semaphores, a mutex is a binary semaphore given once
+ */
+
+static SemaphoreHandle_t semaphore_create(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    struct host_sem *semaphore = calloc(1, sizeof(*semaphore));
+    if (semaphore == NULL)
+        return NULL;
+    pthread_mutex_init(&semaphore->mutex, NULL);
+    pthread_cond_init(&semaphore->cond, NULL);
+    semaphore->count = initial_count;
+    semaphore->max_count = max_count;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return semaphore_create(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    (void)buffer;
+    return semaphore_create(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return semaphore_create(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    (void)buffer;
+    return semaphore_create(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    return semaphore_create(max_count, initial_count);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial_count,
+                                                 StaticSemaphore_t *buffer)
+{
+    (void)buffer;
+    return semaphore_create(max_count, initial_count);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    if (semaphore == NULL)
+        return;
+    pthread_cond_destroy(&semaphore->cond);
+    pthread_mutex_destroy(&semaphore->mutex);
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    struct timespec until = deadline(ticks);
+    pthread_mutex_lock(&semaphore->mutex);
+    while (semaphore->count == 0)
+    {
+        if (!wait(&semaphore->cond, &semaphore->mutex, ticks, &until))
+        {
+            pthread_mutex_unlock(&semaphore->mutex);
+            return pdFALSE;
+        }
+    }
+    semaphore->count--;
+    pthread_mutex_unlock(&semaphore->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    BaseType_t result = pdFALSE;
+    pthread_mutex_lock(&semaphore->mutex);
+    if (semaphore->count < semaphore->max_count)
+    {
+        semaphore->count++;
+        pthread_cond_broadcast(&semaphore->cond);
+        result = pdTRUE;
+    }
+    pthread_mutex_unlock(&semaphore->mutex);
+    return result;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+        *higher_priority_task_woken = pdFALSE;
+    return xSemaphoreGive(semaphore);
+}
+
+/*
+ * Queues
+ */
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    if (queue == NULL)
+        return NULL;
+    queue->items = calloc(length, item_size);
+    if (queue->items == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+    queue->item_size = item_size;
+    queue->length = length;
+    return queue;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buffer)
+{
+    (void)storage;
+    (void)buffer;
+    return xQueueCreate(length, item_size);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue == NULL)
+        return;
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->items);
+    free(queue);
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks, bool front)
+{
+    struct timespec until = deadline(ticks);
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->waiting == queue->length)
+    {
+        if (!wait(&queue->cond, &queue->mutex, ticks, &until))
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return pdFALSE;
+        }
+    }
+    size_t index;
+    if (front)
+    {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        index = queue->head;
+    }
+    else
+        index = (queue->head + queue->waiting) % queue->length;
+    memcpy(queue->items + index * queue->item_size, item, queue->item_size);
+    queue->waiting++;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+        *higher_priority_task_woken = pdFALSE;
+    return queue_send(queue, item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    struct timespec until = deadline(ticks);
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->waiting == 0)
+    {
+        if (!wait(&queue->cond, &queue->mutex, ticks, &until))
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return pdFALSE;
+        }
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->waiting--;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->head = 0;
+    queue->waiting = 0;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t waiting = queue->waiting;
+    pthread_mutex_unlock(&queue->mutex);
+    return waiting;
+}
+
+/*
+ * Tasks, threads which are never joined. The thread which was not created by xTaskCreate() gets
+ * its task, e.g. for notifications, on the first use.
+ */
+
+static struct host_task *task_new(UBaseType_t priority)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (task == NULL)
+        return NULL;
+    pthread_mutex_init(&task->mutex, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    task->priority = priority;
+    return task;
+}
+
+static void *task_entry(void *parameters)
+{
+    current_task = parameters;
+    current_task->function(current_task->parameters);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *created_task)
+{
+    (void)name;
+    (void)stack_depth;
+    struct host_task *task = task_new(priority);
+    if (task == NULL)
+        return pdFAIL;
+    task->function = function;
+    task->parameters = parameters;
+    if (created_task != NULL)
+        *created_task = task;
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0)
+    {
+        if (created_task != NULL)
+            *created_task = NULL;
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id)
+{
+    (void)core_id;
+    return xTaskCreate(function, name, stack_depth, parameters, priority, created_task);
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameters,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *task_buffer)
+{
+    (void)stack;
+    (void)task_buffer;
+    TaskHandle_t task = NULL;
+    xTaskCreate(function, name, stack_depth, parameters, priority, &task);
+    return task;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                                           void *parameters, UBaseType_t priority, StackType_t *stack,
+                                           StaticTask_t *task_buffer, BaseType_t core_id)
+{
+    (void)core_id;
+    return xTaskCreateStatic(function, name, stack_depth, parameters, priority, stack, task_buffer);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == current_task)
+        pthread_exit(NULL);
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sleep_us((int64_t)ticks * 1000000 / configTICK_RATE_HZ);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / (1000000 / configTICK_RATE_HZ));
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment)
+{
+    *previous_wake_time += increment;
+    int32_t remaining = (int32_t)(*previous_wake_time - xTaskGetTickCount());
+    if (remaining > 0)
+        vTaskDelay(remaining);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (current_task == NULL)
+        current_task = task_new(1);
+    return current_task;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return (task != NULL ? task : xTaskGetCurrentTaskHandle())->priority;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority)
+{
+    (task != NULL ? task : xTaskGetCurrentTaskHandle())->priority = priority;
+}
+
+void taskYIELD(void)
+{
+    sched_yield();
+}
+
+/*
+ * Task notifications
+ */
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    BaseType_t result = pdPASS;
+    pthread_mutex_lock(&task->mutex);
+    switch (action)
+    {
+    case eSetBits:
+        task->value |= value;
+        break;
+    case eIncrement:
+        task->value++;
+        break;
+    case eSetValueWithOverwrite:
+        task->value = value;
+        break;
+    case eSetValueWithoutOverwrite:
+        if (task->pending)
+            result = pdFAIL;
+        else
+            task->value = value;
+        break;
+    default:
+        break;
+    }
+    task->pending = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->mutex);
+    return result;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+        *higher_priority_task_woken = pdFALSE;
+    xTaskNotify(task, 0, eIncrement);
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+        *higher_priority_task_woken = pdFALSE;
+    return xTaskNotify(task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec until = deadline(ticks);
+    pthread_mutex_lock(&task->mutex);
+    if (!task->pending)
+        task->value &= ~clear_on_entry;
+    while (!task->pending)
+    {
+        if (!wait(&task->cond, &task->mutex, ticks, &until))
+        {
+            if (value != NULL)
+                *value = task->value;
+            pthread_mutex_unlock(&task->mutex);
+            return pdFALSE;
+        }
+    }
+    if (value != NULL)
+        *value = task->value;
+    task->value &= ~clear_on_exit;
+    task->pending = false;
+    pthread_mutex_unlock(&task->mutex);
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec until = deadline(ticks);
+    pthread_mutex_lock(&task->mutex);
+    while (task->value == 0)
+    {
+        if (!wait(&task->cond, &task->mutex, ticks, &until))
+        {
+            pthread_mutex_unlock(&task->mutex);
+            return 0;
+        }
+    }
+    uint32_t value = task->value;
+    task->value = clear_on_exit ? 0 : value - 1;
+    task->pending = false;
+    pthread_mutex_unlock(&task->mutex);
+    return value;
+}
+
+/*
+ * ESP-IDF
+ */
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:
+        return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+void host_log(char level, const char *tag, const char *format, ...)
+{
+    if (level == 'I' && getenv("HOST_LOG_VERBOSE") == NULL)
+        return;
+    va_list args;
+    va_start(args, format);
+    flockfile(stdout);
+    printf("%c (%lld) %s: ", level, (long long)(esp_timer_get_time() / 1000), tag);
+    vprintf(format, args);
+    putchar('\n');
+    funlockfile(stdout);
+    va_end(args);
+}
+
+/*
+ * Heap statistics, the arena of malloc() stands for the heap
+ */
+
+static size_t heap_minimum_free = SIZE_MAX;
+
+size_t heap_caps_get_total_size(uint32_t caps)
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.arena + info.hblkhd;
+}
+
+// The lowest free size is only sampled when it is asked for, there is no allocation hook
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    size_t free_size = mallinfo2().fordblks;
+    host_critical_enter();
+    if (free_size < heap_minimum_free)
+        heap_minimum_free = free_size;
+    host_critical_exit();
+    return free_size;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    heap_caps_get_free_size(caps);
+    return heap_minimum_free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return mallinfo2().fordblks;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    (void)type;
+    (void)subtype;
+    (void)label;
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+/*
+ * I2C master and GPIO, no hardware
+ */
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *config)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len,
+                             int intr_alloc_flags)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t port)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_master_write_read_device(i2c_port_t port, uint8_t device_address, const uint8_t *write_buffer,
+                                       size_t write_size, uint8_t *read_buffer, size_t read_size,
+                                       TickType_t ticks_to_wait)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return NULL;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size)
+{
+    return buffer;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd)
+{
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd)
+{
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t data_len, bool ack_en)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks_to_wait)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return 1;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void)
+{
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    return ESP_OK;
+}
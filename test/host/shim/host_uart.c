@@ -0,0 +1,326 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// UART driver of the shim on a pseudo-terminal, see driver/uart.h
+
+#define _GNU_SOURCE
+
+#include "driver/uart.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+typedef struct
+{
+    bool installed;
+    int master;                  // The test's end
+    int slave;                   // The driver's end, RX and TX
+    pthread_t rx_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t received;
+    uint8_t *rx;                 // RX ring buffer
+    size_t rx_size;
+    size_t rx_head;
+    size_t rx_count;
+    QueueHandle_t queue;
+    bool pattern_enabled;
+    char pattern;
+    int *positions;              // Offsets of the pattern characters from rx_head, oldest first
+    int positions_size;
+    int positions_count;
+} host_uart_t;
+
+static host_uart_t uarts[UART_NUM_MAX];
+
+static bool valid(uart_port_t uart_num)
+{
+    return uart_num >= 0 && uart_num < UART_NUM_MAX && uarts[uart_num].installed;
+}
+
+static void post(host_uart_t *uart, uart_event_type_t type, size_t size)
+{
+    if (uart->queue == NULL)
+        return;
+
+    // Like the ISR the reader never blocks, a full queue loses the event but not the data
+    uart_event_t event = {.type = type, .size = size};
+    xQueueSendFromISR(uart->queue, &event, NULL);
+}
+
+// Stands in for the RX interrupt: moves what arrives on the line into the ring buffer
+static void *rx_thread(void *arg)
+{
+    host_uart_t *uart = arg;
+    uint8_t data[120];  // The size of the hardware FIFO
+
+    while (1)
+    {
+        ssize_t n = read(uart->slave, data, sizeof(data));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        bool overflow = false;
+        bool pattern = false;
+        pthread_mutex_lock(&uart->mutex);
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (uart->rx_count == uart->rx_size)
+            {
+                overflow = true;
+                break;
+            }
+            uart->rx[(uart->rx_head + uart->rx_count++) % uart->rx_size] = data[i];
+            if (uart->pattern_enabled && data[i] == (uint8_t)uart->pattern)
+            {
+                pattern = true;
+                if (uart->positions_count < uart->positions_size)
+                    uart->positions[uart->positions_count++] = (int)uart->rx_count - 1;
+            }
+        }
+        pthread_cond_broadcast(&uart->received);
+        pthread_mutex_unlock(&uart->mutex);
+
+        if (overflow)
+            post(uart, UART_BUFFER_FULL, 0);
+        else
+            post(uart, pattern ? UART_PATTERN_DET : UART_DATA, (size_t)n);
+    }
+
+    return NULL;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    if (uart_num < 0 || uart_num >= UART_NUM_MAX || rx_buffer_size <= 0)
+        return ESP_ERR_INVALID_ARG;
+
+    host_uart_t *uart = &uarts[uart_num];
+    if (uart->installed)
+        return ESP_FAIL;
+
+    memset(uart, 0, sizeof(*uart));
+    uart->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (uart->master < 0 || grantpt(uart->master) != 0 || unlockpt(uart->master) != 0)
+        return ESP_FAIL;
+    uart->slave = open(ptsname(uart->master), O_RDWR | O_NOCTTY);
+    if (uart->slave < 0)
+    {
+        close(uart->master);
+        return ESP_FAIL;
+    }
+
+    // A UART has no line discipline, bytes go through as they are on both ends
+    struct termios tio;
+    tcgetattr(uart->slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(uart->slave, TCSANOW, &tio);
+    tcgetattr(uart->master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(uart->master, TCSANOW, &tio);
+
+    uart->rx = malloc(rx_buffer_size);
+    uart->rx_size = rx_buffer_size;
+    if (queue_size > 0)
+    {
+        uart->queue = xQueueCreate(queue_size, sizeof(uart_event_t));
+        *uart_queue = uart->queue;
+    }
+    pthread_mutex_init(&uart->mutex, NULL);
+    pthread_cond_init(&uart->received, NULL);
+
+    // printf() and the log go out on the console UART
+    if (uart_num == UART_NUM_0)
+    {
+        fflush(stdout);
+        dup2(uart->slave, STDOUT_FILENO);
+    }
+
+    uart->installed = true;
+    pthread_create(&uart->rx_thread, NULL, rx_thread, uart);
+    pthread_detach(uart->rx_thread);
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    if (!valid(uart_num))
+        return ESP_FAIL;
+
+    // The reader stops on the hang-up, the buffers stay with it
+    host_uart_t *uart = &uarts[uart_num];
+    uart->installed = false;
+    close(uart->master);
+    return ESP_OK;
+}
+
+esp_err_t uart_enable_pattern_det_baud_intr(uart_port_t uart_num, char pattern_chr, uint8_t chr_num, int chr_tout,
+                                            int post_idle, int pre_idle)
+{
+    if (!valid(uart_num) || chr_num != 1)
+        return ESP_ERR_INVALID_ARG;
+
+    host_uart_t *uart = &uarts[uart_num];
+    pthread_mutex_lock(&uart->mutex);
+    uart->pattern = pattern_chr;
+    uart->pattern_enabled = true;
+    pthread_mutex_unlock(&uart->mutex);
+    return ESP_OK;
+}
+
+esp_err_t uart_pattern_queue_reset(uart_port_t uart_num, int queue_length)
+{
+    if (!valid(uart_num) || queue_length <= 0)
+        return ESP_ERR_INVALID_ARG;
+
+    host_uart_t *uart = &uarts[uart_num];
+    int *positions = malloc(queue_length * sizeof(int));
+    if (positions == NULL)
+        return ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&uart->mutex);
+    free(uart->positions);
+    uart->positions = positions;
+    uart->positions_size = queue_length;
+    uart->positions_count = 0;
+    pthread_mutex_unlock(&uart->mutex);
+    return ESP_OK;
+}
+
+int uart_pattern_pop_pos(uart_port_t uart_num)
+{
+    if (!valid(uart_num))
+        return -1;
+
+    host_uart_t *uart = &uarts[uart_num];
+    int pos = -1;
+    pthread_mutex_lock(&uart->mutex);
+    if (uart->positions_count > 0)
+    {
+        pos = uart->positions[0];
+        memmove(uart->positions, uart->positions + 1, --uart->positions_count * sizeof(int));
+    }
+    pthread_mutex_unlock(&uart->mutex);
+    return pos;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size)
+{
+    if (!valid(uart_num))
+        return ESP_FAIL;
+
+    host_uart_t *uart = &uarts[uart_num];
+    pthread_mutex_lock(&uart->mutex);
+    *size = uart->rx_count;
+    pthread_mutex_unlock(&uart->mutex);
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    if (!valid(uart_num) || buf == NULL)
+        return -1;
+
+    host_uart_t *uart = &uarts[uart_num];
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    int64_t ns = deadline.tv_nsec + (int64_t)ticks_to_wait * (1000000000 / configTICK_RATE_HZ);
+    deadline.tv_sec += ns / 1000000000;
+    deadline.tv_nsec = ns % 1000000000;
+
+    pthread_mutex_lock(&uart->mutex);
+    while (uart->rx_count < length && ticks_to_wait > 0)
+    {
+        if (ticks_to_wait == portMAX_DELAY)
+            pthread_cond_wait(&uart->received, &uart->mutex);
+        else if (pthread_cond_timedwait(&uart->received, &uart->mutex, &deadline) != 0)
+            break;
+    }
+
+    uint32_t n = uart->rx_count < length ? uart->rx_count : length;
+    for (uint32_t i = 0; i < n; i++)
+        ((uint8_t *)buf)[i] = uart->rx[(uart->rx_head + i) % uart->rx_size];
+    uart->rx_head = (uart->rx_head + n) % uart->rx_size;
+    uart->rx_count -= n;
+
+    // The recorded positions follow the read head, characters read past drop out
+    int kept = 0;
+    for (int i = 0; i < uart->positions_count; i++)
+        if (uart->positions[i] >= (int)n)
+            uart->positions[kept++] = uart->positions[i] - (int)n;
+    uart->positions_count = kept;
+    pthread_mutex_unlock(&uart->mutex);
+    return (int)n;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+    if (!valid(uart_num) || src == NULL)
+        return -1;
+
+    // Whatever stdout has buffered was sent before
+    if (uart_num == UART_NUM_0)
+        fflush(stdout);
+
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t n = write(uarts[uart_num].slave, (const uint8_t *)src + written, size - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        written += n;
+    }
+    return (int)written;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    if (!valid(uart_num))
+        return ESP_FAIL;
+
+    host_uart_t *uart = &uarts[uart_num];
+    pthread_mutex_lock(&uart->mutex);
+    uart->rx_head = 0;
+    uart->rx_count = 0;
+    uart->positions_count = 0;
+    pthread_mutex_unlock(&uart->mutex);
+    return ESP_OK;
+}
+
+int host_uart_pty(uart_port_t uart_num)
+{
+    return valid(uart_num) ? uarts[uart_num].master : -1;
+}
@@ -0,0 +1,100 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The drift calibration against the drift model of the simulator: a +5 ppm crystal with a temperature
+// coefficient, sampled at its seconds edges while the temperature swings around 25 degrees, ends up
+// trimmed to aging offset 50 with no drift left
+
+#include "host_test.h"
+#include "ds3231_cal.h"
+#include "ds3231_epoch.h"
+#include "ds3231_regmap.h"
+#include "ds3231_sim.h"
+#include "ds3231_temp.h"
+
+#include <esp_timer.h>
+#include <math.h>
+
+#define TEST_DRIFT_PPM 5.0f
+#define TEST_TEMP_COEFF_PPM 0.04f
+#define TEST_SAMPLE_S 60
+#define TEST_SAMPLES 240
+
+static ds3231_sim_t sim;
+static ds3231_bus_backend_t backend;
+
+// Let the model run to its next seconds edge and take the edge as a sample: the reference (esp_timer)
+// time of the edge and the RTC time, which is the new second exactly
+static void feed_edge(float temp)
+{
+    int64_t edge_us = sim.next_tick_us;
+    int64_t epoch;
+
+    host_timer_advance(edge_us - esp_timer_get_time());
+    ds3231_sim_tick(&sim);
+    CHECK_OK(ds3231_get_epoch(&epoch));
+    CHECK_OK(ds3231_cal_feed(edge_us, epoch * 1000000, temp));
+}
+
+int main(void)
+{
+    ds3231_sim_init(&sim, 0);
+    ds3231_sim_get_backend(&sim, &backend);
+    ds3231_sim_set_drift(&sim, TEST_DRIFT_PPM, TEST_TEMP_COEFF_PPM);
+    CHECK_OK(i2c_ds3231_init_backend(&backend));
+    CHECK_OK(ds3231_regmap_init());
+    CHECK_OK(ds3231_temp_init(NULL));
+    CHECK_OK(ds3231_set_epoch(1700000000));
+
+    ds3231_cal_config_t config = DS3231_CAL_CONFIG_DEFAULT();
+    CHECK_OK(ds3231_cal_init(&config));
+
+    ds3231_cal_status_t status;
+    for (int i = 0; i < TEST_SAMPLES; i++)
+    {
+        // +-3 degrees over 32 minutes, a whole number of periods in the window. The model runs each second
+        // at the temperature it starts with, the calibration gets it in the 0.25 degree steps of the chip.
+        float temp = floorf((25.0f + 3.0f * sinf(2.0f * (float)M_PI * i / 32.0f)) * 4.0f) / 4.0f;
+        ds3231_sim_set_temperature(&sim, temp);
+        host_timer_advance(TEST_SAMPLE_S * 1000000LL - 500000);
+        ds3231_sim_tick(&sim);
+        feed_edge(temp);
+    }
+
+    CHECK_OK(ds3231_cal_get_status(&status));
+    printf("initial drift %.3f ppm, aging offset %d after %u trims, residual drift %.4f +- %.4f ppm, "
+           "%.4f ppm/degree over %u samples\n",
+           status.initial_drift_ppm, status.aging_offset, status.trims, status.drift_ppm, status.drift_stderr_ppm,
+           status.temp_coeff_ppm, status.samples);
+
+    CHECK(fabsf(status.initial_drift_ppm - TEST_DRIFT_PPM) < 0.1f);
+    CHECK(status.aging_offset == lround(TEST_DRIFT_PPM / DS3231_AGING_PPM_PER_LSB));
+    CHECK(sim.registers[DS3231_AGING_OFFSET_ADDRESS] == (uint8_t)status.aging_offset);
+    CHECK(status.samples >= 3);
+    CHECK(fabsf(status.drift_ppm) < DS3231_CAL_TRIM_STDERR_PPM);
+    CHECK(status.restarts == 0);
+    return 0;
+}
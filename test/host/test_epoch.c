@@ -0,0 +1,114 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Every day from 2000-01-01 to 2199-12-31, every hour, in 24 and 12 hour mode: the registers convert to the
+// epoch timegm() gives, back to the same registers, and the weekday matches gmtime()
+
+#define _GNU_SOURCE
+
+#include "host_test.h"
+#include "ds3231_epoch.h"
+
+#include <time.h>
+
+static uint8_t hour_12(uint32_t hour)
+{
+    uint32_t h12 = hour % 12 == 0 ? 12 : hour % 12;
+    return DS3231_12HOUR_FLAG | (hour >= 12 ? DS3231_PM_FLAG : 0) | dec2bcd(h12);
+}
+
+int main(void)
+{
+    static const uint8_t month_days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int64_t expected_epoch = DS3231_EPOCH_MIN;
+    uint32_t days = 0;
+
+    for (uint32_t year = 2000; year <= 2199; year++)
+    {
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+        for (uint32_t month = 1; month <= 12; month++)
+        {
+            uint32_t last = month_days[month - 1] + (month == 2 && leap);
+
+            for (uint32_t day = 1; day <= last; day++, days++, expected_epoch += 86400)
+            {
+                struct tm civil = {.tm_year = year - 1900, .tm_mon = month - 1, .tm_mday = day};
+                time_t midnight = timegm(&civil);
+                CHECK(midnight == expected_epoch);
+
+                struct tm broken;
+                CHECK(gmtime_r(&midnight, &broken) != NULL);
+
+                for (uint32_t hour = 0; hour < 24; hour++)
+                {
+                    // Minutes and seconds walk through their range over the days
+                    uint32_t minute = (days + hour) % 60;
+                    uint32_t second = (days * 7 + hour) % 60;
+                    int64_t epoch = midnight + hour * 3600 + minute * 60 + second;
+                    uint8_t regs[7] = {
+                        dec2bcd(second),
+                        dec2bcd(minute),
+                        dec2bcd(hour),
+                        broken.tm_wday + 1,
+                        dec2bcd(day),
+                        dec2bcd(month) | (year >= 2100 ? DS3231_CENTURY_FLAG : 0),
+                        dec2bcd(year % 100)};
+                    uint8_t regs12[7];
+                    uint8_t back[7];
+
+                    memcpy(regs12, regs, sizeof(regs));
+                    regs12[2] = hour_12(hour);
+
+                    CHECK(ds3231_regs_to_epoch(regs) == epoch);
+                    CHECK(ds3231_regs_to_epoch(regs12) == epoch);
+
+                    // ds3231_epoch_to_regs() writes 24 hour mode, so both modes come back as regs
+                    CHECK_OK(ds3231_epoch_to_regs(ds3231_regs_to_epoch(regs), back));
+                    CHECK(memcmp(back, regs, sizeof(regs)) == 0);
+                    CHECK_OK(ds3231_epoch_to_regs(ds3231_regs_to_epoch(regs12), back));
+                    CHECK(memcmp(back, regs, sizeof(regs)) == 0);
+
+                    struct tm time24;
+                    struct tm time12;
+                    ds3231_regs_to_tm(regs, &time24);
+                    ds3231_regs_to_tm(regs12, &time12);
+                    CHECK(time24.tm_wday == broken.tm_wday && time12.tm_wday == broken.tm_wday);
+                    CHECK(time24.tm_hour == (int)hour && time12.tm_hour == (int)hour);
+                    CHECK(timegm(&time24) == epoch && timegm(&time12) == epoch);
+                }
+            }
+        }
+    }
+
+    CHECK(days == 73049);
+    CHECK(expected_epoch == DS3231_EPOCH_MAX + 1);
+
+    uint8_t regs[7];
+    CHECK(ds3231_epoch_to_regs(DS3231_EPOCH_MIN - 1, regs) == ESP_ERR_INVALID_ARG);
+    CHECK(ds3231_epoch_to_regs(DS3231_EPOCH_MAX + 1, regs) == ESP_ERR_INVALID_ARG);
+    return 0;
+}
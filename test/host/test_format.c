@@ -0,0 +1,67 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The precompiled built-in formats against their specs, and custom format registration
+
+#include "host_test.h"
+#include "ds3231_format.h"
+
+#include <string.h>
+
+static const char *const specs[UNIX_TIMESTAMPS] = {
+    [DATE_AND_TIME_24] = "%Y-%m-%d %H:%M:%S",
+    [DATE_AND_TIME_AM_PM] = "%Y-%m-%d %I:%M:%S %p",
+    [ONLY_DATE] = "%Y-%m-%d",
+    [ONLY_TIME_24] = "%H:%M:%S",
+    [ONLY_TIME_AM_PM] = "%I:%M:%S %p"};
+
+int main(void)
+{
+    ds3231_format_t compiled;
+    for (int i = 0; i < UNIX_TIMESTAMPS; i++)
+    {
+        CHECK_OK(ds3231_format_compile(specs[i], &compiled));
+        CHECK(memcmp(ds3231_format_get((date_time_format)i), &compiled, sizeof(compiled)) == 0);
+    }
+    CHECK(ds3231_format_get(UNIX_TIMESTAMPS) == NULL);
+
+    // 2024-02-29 13:05:09, Thursday, 24 hour mode
+    const uint8_t regs[7] = {0x09, 0x05, 0x13, 0x05, 0x29, 0x02, 0x24};
+    char str[32];
+    CHECK(ds3231_format_render(ds3231_format_get(DATE_AND_TIME_AM_PM), regs, str, sizeof(str)) == 22);
+    CHECK(strcmp(str, "2024-02-29 01:05:09 PM") == 0);
+
+    date_time_format custom;
+    CHECK(ds3231_format_get(DATE_TIME_CUSTOM) == NULL);
+    CHECK_OK(ds3231_format_register("%d.%m.%y %u", &custom));
+    CHECK(custom == DATE_TIME_CUSTOM);
+    CHECK(ds3231_format_render(ds3231_format_get(custom), regs, str, sizeof(str)) == 10);
+    CHECK(strcmp(str, "29.02.24 4") == 0);
+    for (int i = 1; i < DS3231_FORMAT_MAX_CUSTOM; i++)
+        CHECK_OK(ds3231_format_register("%H", &custom));
+    CHECK(ds3231_format_register("%H", &custom) == ESP_ERR_NO_MEM);
+    return 0;
+}
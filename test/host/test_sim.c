@@ -0,0 +1,90 @@
+/*
+ * This code demonstrates how to use the I2C with DS3231RTC module
+ * connected to the NodeMCU-32s.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Zoltan Uglar
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The driver API end to end against the simulated DS3231
+
+#include "host_test.h"
+#include "i2c_ds3231.h"
+#include "ds3231_epoch.h"
+#include "ds3231_sim.h"
+#include "ds3231_regmap.h"
+#include "ds3231_temp.h"
+
+#include <esp_timer.h>
+
+static ds3231_sim_t sim;
+static ds3231_bus_backend_t backend;
+
+int main(void)
+{
+    ds3231_sim_init(&sim, 0);
+    ds3231_sim_get_backend(&sim, &backend);
+    CHECK_OK(i2c_ds3231_init_backend(&backend));
+
+    CHECK_OK(ds3231_set_date_time("2024-02-29 23:59:58"));
+    char str[DS3231_DATE_TIME_STR_SIZE];
+    CHECK_OK(ds3231_get_date_time_r(str, sizeof(str), DATE_AND_TIME_24));
+    CHECK(strncmp(str, "2024-02-29 23:59:5", 18) == 0);
+
+    // Two seconds later the date rolls over into March
+    host_timer_advance(2000000);
+    ds3231_sim_tick(&sim);
+    int64_t epoch;
+    CHECK_OK(ds3231_get_epoch(&epoch));
+    CHECK(epoch >= 1709251200 && epoch <= 1709251201);
+
+    char *allocated = NULL;
+#if DS3231_STATIC_ALLOCATION
+    CHECK(ds3231_get_date_time(&allocated, ONLY_DATE) == ESP_ERR_NOT_SUPPORTED);
+    CHECK(allocated == NULL);
+#else
+    CHECK_OK(ds3231_get_date_time(&allocated, ONLY_DATE));
+    CHECK(strcmp(allocated, "2024-03-01") == 0);
+    free(allocated);
+#endif
+
+    float temp;
+    CHECK_OK(ds3231_get_temperature(&temp));
+    CHECK(temp > -40 && temp < 85);
+
+    // The temperature service serves its sample for DS3231_TEMP_MAX_AGE_MS after the read
+    CHECK_OK(ds3231_regmap_init());
+    CHECK_OK(ds3231_temp_init(NULL));
+    ds3231_sim_set_temperature(&sim, 21.5f);
+    CHECK_OK(ds3231_temp_get(&temp));
+    CHECK(temp == 21.5f);
+    ds3231_sim_set_temperature(&sim, 30.0f);
+    host_timer_advance((DS3231_TEMP_MAX_AGE_MS - 1) * 1000LL);
+    CHECK_OK(ds3231_temp_get(&temp));
+    CHECK(temp == 21.5f);
+    host_timer_advance(1000);
+    CHECK_OK(ds3231_temp_get(&temp));
+    CHECK(temp == 30.0f);
+
+    uint8_t lost, status;
+    CHECK_OK(ds3231_power_lost(&lost, &status));
+    return 0;
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Compare two BENCH results and fail on regressions.
+
+The inputs are the JSON documents printed by the BENCH console command, a captured
+serial log works too: everything outside the outermost braces is ignored.
+
+usage: bench_compare.py baseline.json current.json [--threshold 10] [--metric p50_ns]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path, encoding="utf-8", errors="replace") as f:
+        text = f.read()
+    start = text.find("{")
+    end = text.rfind("}")
+    if start < 0 or end < start:
+        sys.exit(f"{path}: no benchmark JSON found")
+    doc = json.loads(text[start:end + 1])
+    return doc, {r["name"]: r for r in doc["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed slowdown in percent")
+    parser.add_argument("--metric", default="p50_ns", help="result field to compare")
+    args = parser.parse_args()
+
+    base_doc, base = load(args.baseline)
+    cur_doc, cur = load(args.current)
+
+    for key in ("cpu_mhz", "bus_freq_hz"):
+        if base_doc.get(key) != cur_doc.get(key):
+            print(f"warning: {key} differs: {base_doc.get(key)} vs {cur_doc.get(key)}")
+
+    regressions = 0
+    print(f"{'case':<40} {'baseline':>12} {'current':>12} {'change':>8}")
+    for name, b in base.items():
+        c = cur.get(name)
+        if c is None:
+            print(f"{name:<40} {'missing in current':>34}")
+            regressions += 1
+            continue
+
+        old, new = b[args.metric], c[args.metric]
+        change = (new - old) * 100.0 / old if old else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        if b.get("allocs_per_op") is not None and c.get("allocs_per_op") is not None \
+                and c["allocs_per_op"] > b["allocs_per_op"]:
+            flag += f"  allocs {b['allocs_per_op']} -> {c['allocs_per_op']}"
+            regressions += 1
+        print(f"{name:<40} {old:>12} {new:>12} {change:>7.1f}%{flag}")
+
+    for name in cur.keys() - base.keys():
+        print(f"{name:<40} {'new case':>34}")
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
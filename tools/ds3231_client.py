@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""Host client of the binary console protocol (include/ds3231_proto.h).
+
+Frames are SYNC LEN CMD SEQ PAYLOAD CRC16 on the console UART, next to the text commands and the log
+output, which never contain the SYNC byte. One BATCH frame carries several operations and is answered
+with one fixed-width result per operation.
+
+usage: ds3231_client.py PORT [--baud 115200] read
+       ds3231_client.py PORT set EPOCH
+       ds3231_client.py PORT clear-osf
+       ds3231_client.py PORT bench [--rounds 200]
+
+bench reads time, temperature and status once per round, as one binary batch and as the text commands
+DT, ST and OK, and prints round trips per second and bytes on the wire for both.
+"""
+
+import argparse
+import re
+import struct
+import sys
+import time
+
+import serial
+
+SYNC = 0xA5
+REPLY = 0x80
+CMD_PING = 0x01
+CMD_BATCH = 0x02
+CMD_NAK = 0x7F
+
+OP_TIME = 0x01
+OP_TIME_REGS = 0x02
+OP_TIME_US = 0x03
+OP_TEMP = 0x04
+OP_STATUS = 0x05
+OP_SET_TIME = 0x10
+OP_CLEAR_OSF = 0x11
+
+# Operation: (argument format, result format), little endian
+OPS = {
+    OP_TIME: ("", "<q"),
+    OP_TIME_REGS: ("", "7s"),
+    OP_TIME_US: ("", "<q"),
+    OP_TEMP: ("", "<h"),
+    OP_STATUS: ("", "B"),
+    OP_SET_TIME: ("<q", ""),
+    OP_CLEAR_OSF: ("", ""),
+}
+
+STATUS = {0: "ok", 1: "fail", 2: "timeout", 3: "invalid state", 4: "invalid argument", 5: "unknown operation"}
+NAK = {1: "bad CRC", 2: "unknown command", 3: "malformed batch"}
+
+
+class ProtocolError(Exception):
+    pass
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def encode(cmd, seq, payload=b""):
+    body = bytes([len(payload), cmd, seq]) + payload
+    return bytes([SYNC]) + body + struct.pack("<H", crc16(body))
+
+
+class Client:
+    def __init__(self, port, baud=115200, timeout=1.0):
+        self.serial = serial.Serial(port, baud, timeout=timeout)
+        self.seq = 0
+        self.rx_bytes = 0
+        self.tx_bytes = 0
+
+    def _send(self, data):
+        self.serial.write(data)
+        self.tx_bytes += len(data)
+
+    def _read(self, size):
+        data = self.serial.read(size)
+        self.rx_bytes += len(data)
+        if len(data) != size:
+            raise ProtocolError("timeout")
+        return data
+
+    def request(self, cmd, payload=b""):
+        self.seq = (self.seq + 1) & 0xFF
+        self._send(encode(cmd, self.seq, payload))
+
+        # Skip log output and replies to earlier requests until a valid reply to this one
+        while True:
+            if self._read(1)[0] != SYNC:
+                continue
+            header = self._read(3)
+            length, reply_cmd, seq = header
+            rest = self._read(length + 2)
+            payload, crc = rest[:length], struct.unpack("<H", rest[length:])[0]
+            if crc16(header + payload) != crc or seq != self.seq:
+                continue
+            if reply_cmd == CMD_NAK | REPLY:
+                raise ProtocolError(NAK.get(payload[0], f"NAK {payload[0]}"))
+            if reply_cmd != cmd | REPLY:
+                raise ProtocolError(f"unexpected reply 0x{reply_cmd:02x}")
+            return payload
+
+    def ping(self):
+        return self.request(CMD_PING)[0]
+
+    def batch(self, ops):
+        """ops: list of operation ids or (operation id, argument). Returns [(op, status, value)]."""
+        payload = b""
+        for op in ops:
+            op, arg = op if isinstance(op, tuple) else (op, None)
+            arg_format = OPS[op][0]
+            payload += bytes([op]) + (struct.pack(arg_format, arg) if arg_format else b"")
+
+        reply = self.request(CMD_BATCH, payload)
+        results = []
+        pos = 0
+        for op in ops:
+            op = op[0] if isinstance(op, tuple) else op
+            result_format = OPS[op][1]
+            size = struct.calcsize(result_format) if result_format else 0
+            rop, status = reply[pos], reply[pos + 1]
+            if rop != op:
+                raise ProtocolError(f"result of 0x{rop:02x} instead of 0x{op:02x}")
+            value = struct.unpack(result_format, reply[pos + 2:pos + 2 + size])[0] if size else None
+            results.append((op, status, value))
+            pos += 2 + size
+        return results
+
+    def text(self, command, expect):
+        """Send a text command, return the first log line matching expect."""
+        self._send(command.encode() + b"\n")
+        deadline = time.monotonic() + self.serial.timeout
+        while time.monotonic() < deadline:
+            line = self.serial.readline()
+            self.rx_bytes += len(line)
+            match = re.search(expect, line.decode(errors="replace"))
+            if match:
+                return match
+        raise ProtocolError(f"no reply to {command}")
+
+
+def read(client):
+    for op, status, value in client.batch([OP_TIME, OP_TIME_US, OP_TEMP, OP_STATUS]):
+        if status != 0:
+            print(f"op 0x{op:02x}: {STATUS.get(status, status)}")
+        elif op == OP_TIME:
+            print(f"time: {time.strftime('%Y-%m-%d %H:%M:%S', time.gmtime(value))} ({value})")
+        elif op == OP_TIME_US:
+            print(f"snapshot time: {value / 1e6:.6f}")
+        elif op == OP_TEMP:
+            print(f"temperature: {value / 4:.2f} C")
+        elif op == OP_STATUS:
+            print(f"status: 0x{value:02x}, OSF: {value >> 7}")
+
+
+def bench(client, rounds):
+    client.serial.reset_input_buffer()
+    for name, round_trip in (
+        ("binary batch", lambda: client.batch([OP_TIME, OP_TEMP, OP_STATUS])),
+        ("text DT/ST/OK", lambda: (client.text("DT", r"date and time: (.*)"),
+                                   client.text("ST", r"temperature: ([-0-9.]+)"),
+                                   client.text("OK", r"(Status Register: 0x[0-9A-F]+|confirmed)"))),
+    ):
+        client.rx_bytes = client.tx_bytes = 0
+        start = time.perf_counter()
+        for _ in range(rounds):
+            round_trip()
+        elapsed = time.perf_counter() - start
+        print(f"{name:14s}: {rounds / elapsed:8.1f} rounds/s, {elapsed / rounds * 1e3:7.2f} ms/round, "
+              f"{client.tx_bytes / rounds:5.1f} B out, {client.rx_bytes / rounds:6.1f} B in per round")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port")
+    parser.add_argument("--baud", type=int, default=115200)
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("read")
+    set_parser = sub.add_parser("set")
+    set_parser.add_argument("epoch", type=int)
+    sub.add_parser("clear-osf")
+    bench_parser = sub.add_parser("bench")
+    bench_parser.add_argument("--rounds", type=int, default=200)
+    args = parser.parse_args()
+
+    client = Client(args.port, args.baud)
+    try:
+        if client.ping() != 1:
+            print("warning: unknown protocol version")
+        if args.command == "read":
+            read(client)
+        elif args.command == "set":
+            status = client.batch([(OP_SET_TIME, args.epoch)])[0][1]
+            print(STATUS.get(status, status))
+        elif args.command == "clear-osf":
+            status = client.batch([OP_CLEAR_OSF])[0][1]
+            print(STATUS.get(status, status))
+        elif args.command == "bench":
+            bench(client, args.rounds)
+    except ProtocolError as e:
+        sys.exit(f"error: {e}")
+
+
+if __name__ == "__main__":
+    main()
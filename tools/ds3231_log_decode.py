@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Decode the event log (include/ds3231_log.h) into readable timestamps.
+
+The input is the log file of a host build or a dump of the flash partition, e.g.
+    parttool.py --port PORT read_partition --partition-name rtclog --output rtclog.bin
+
+Pages: magic u16, record bytes u16, sequence number u32, base epoch s64, records, CRC-16/CCITT-FALSE
+over everything in front of it. Record: zigzag varint seconds since the previous record (the first
+one of a page since the base epoch), event id u8, payload size u8, payload.
+
+usage: ds3231_log_decode.py FILE [--local] [--stats]
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+PAGE_SIZE = 256
+HEADER_SIZE = 16
+CRC_SIZE = 2
+MAGIC = 0x4C44
+
+# Event ids of the console application (src/main.c)
+EVENTS = {1: "boot", 2: "time set", 3: "OSF cleared", 4: "note"}
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return (value >> 1) ^ -(value & 1), pos
+
+
+def pages(image):
+    """Valid pages as (seq, base epoch, records), oldest first."""
+    found = []
+    for offset in range(0, len(image) - PAGE_SIZE + 1, PAGE_SIZE):
+        page = image[offset:offset + PAGE_SIZE]
+        magic, used, seq, base = struct.unpack_from("<HHIq", page)
+        if magic != MAGIC or used > PAGE_SIZE - HEADER_SIZE - CRC_SIZE:
+            continue
+        end = HEADER_SIZE + used
+        if crc16(page[:end]) != struct.unpack_from("<H", page, end)[0]:
+            print(f"warning: bad CRC in page {seq} at 0x{offset:x}", file=sys.stderr)
+            continue
+        found.append((seq, base, page[HEADER_SIZE:end]))
+    if not found:
+        return []
+
+    # Sequence numbers count modulo 2^32, the newest page sorts last
+    newest = max(found, key=lambda p: p[0])[0]
+    found.sort(key=lambda p: (p[0] - newest - 1) % (1 << 32))
+    return found
+
+
+def records(page_list):
+    """Records as (seq, epoch, event, payload)."""
+    for seq, base, data in page_list:
+        epoch, pos = base, 0
+        while pos < len(data):
+            delta, pos = varint(data, pos)
+            epoch += delta
+            event, size = data[pos], data[pos + 1]
+            yield seq, epoch, event, data[pos + 2:pos + 2 + size]
+            pos += 2 + size
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("file")
+    parser.add_argument("--local", action="store_true", help="local time instead of UTC")
+    parser.add_argument("--stats", action="store_true", help="print the size per event at the end")
+    args = parser.parse_args()
+
+    with open(args.file, "rb") as f:
+        image = f.read()
+
+    page_list = pages(image)
+    convert = time.localtime if args.local else time.gmtime
+    previous = None
+    count = size = 0
+    for seq, epoch, event, payload in records(page_list):
+        if previous is not None and (seq - previous) % (1 << 32) > 1:
+            print(f"-- pages {previous + 1}..{seq - 1} missing --")
+        previous = seq
+        name = EVENTS.get(event, f"event {event}")
+        text = payload.decode("ascii") if payload and all(32 <= b < 127 for b in payload) else payload.hex(" ")
+        print(f"{time.strftime('%Y-%m-%d %H:%M:%S', convert(epoch))}  {name:<12} {text}")
+        count += 1
+
+    if args.stats:
+        size = sum(HEADER_SIZE + len(data) + CRC_SIZE for _, _, data in page_list)
+        flash = len(page_list) * PAGE_SIZE
+        if count:
+            print(f"{count} events in {len(page_list)} pages: {size / count:.2f} bytes/event used, "
+                  f"{flash / count:.2f} bytes/event of flash")
+        else:
+            print("no events")
+
+
+if __name__ == "__main__":
+    main()